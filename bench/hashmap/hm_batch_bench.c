@@ -0,0 +1,88 @@
+#include "../hashmap/myhashmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Random lookups in batches: a loop of hm_get_value() against one hm_get_many() per batch */
+#define NUM_KEYS 1000000
+#define BATCH 128
+#define NUM_BATCHES 20000
+
+static uint64_t u32_hash(const void *key) {
+	return *(const uint32_t *)key * 2654435761u;
+}
+
+static bool u32_equal(const void *key_a, const void *key_b) {
+	return *(const uint32_t *)key_a == *(const uint32_t *)key_b;
+}
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(hm_backend_e backend, const char *name) {
+	hm_config_s config = {
+		.hash = u32_hash,
+		.equal = u32_equal,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint64_t),
+		.capacity = NUM_KEYS,
+		.backend = backend,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	uint32_t *keys = malloc(sizeof(uint32_t) * BATCH * NUM_BATCHES);
+	if (map == NULL || keys == NULL) {
+		hm_free(map);
+		free(keys);
+		return;
+	}
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		uint64_t value = key;
+		hm_set(map, &key, &value);
+	}
+
+	uint32_t seed = 1;
+	for (size_t i = 0; i < (size_t)BATCH * NUM_BATCHES; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		keys[i] = (seed >> 4) % NUM_KEYS;
+	}
+
+	uint64_t values[BATCH];
+	uint64_t sum = 0;
+
+	double start = now();
+	for (size_t b = 0; b < NUM_BATCHES; ++b) {
+		for (size_t i = 0; i < BATCH; ++i) {
+			hm_get_value(map, &keys[b * BATCH + i], &values[i]);
+		}
+		sum += values[0];
+	}
+	double single = now() - start;
+
+	start = now();
+	for (size_t b = 0; b < NUM_BATCHES; ++b) {
+		hm_get_many(map, &keys[b * BATCH], BATCH, values, NULL);
+		sum += values[0];
+	}
+	double batched = now() - start;
+
+	double lookups = (double)BATCH * NUM_BATCHES / 1e6;
+	printf("%-8s %10.2f %10.2f %8.2fx (%llu)\n", name, lookups / single, lookups / batched,
+		   single / batched, (unsigned long long)sum);
+
+	free(keys);
+	hm_free(map);
+}
+
+int main(void) {
+	printf("%d keys, batches of %d (Mlookups/s)\n", NUM_KEYS, BATCH);
+	printf("backend      single    batched  speedup\n");
+	run(HM_BACKEND_CHAINED, "chained");
+	run(HM_BACKEND_FLAT, "flat");
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include "../hashmap/myhashmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Cold start: build a map from packed arrays, one hm_set() at a time vs hm_bulk_load() */
+#define NUM_KEYS 2000000
+#define MAX_THREADS 8
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static hashmap_s *new_map(void) {
+	return hm_new(hm_hash_u32, hm_equal_u32, NULL, NULL, sizeof(uint32_t), sizeof(uint64_t), 0);
+}
+
+int main(void) {
+	uint32_t *keys = malloc(NUM_KEYS * sizeof(uint32_t));
+	uint64_t *values = malloc(NUM_KEYS * sizeof(uint64_t));
+	if (keys == NULL || values == NULL) {
+		return 1;
+	}
+	for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = i * 2654435761u;
+		values[i] = i;
+	}
+
+	printf("%d pairs (Mpairs/s)\n", NUM_KEYS);
+
+	hashmap_s *map = new_map();
+	double start = now();
+	for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+		hm_set(map, &keys[i], &values[i]);
+	}
+	printf("hm_set          %10.2f\n", NUM_KEYS / (now() - start) / 1e6);
+	hm_free(map);
+
+	for (size_t threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		map = new_map();
+		start = now();
+		hm_bulk_load(map, keys, values, NUM_KEYS, threads);
+		printf("bulk %zu threads %10.2f\n", threads, NUM_KEYS / (now() - start) / 1e6);
+		hm_free(map);
+	}
+
+	free(keys);
+	free(values);
+
+	return 0;
+}
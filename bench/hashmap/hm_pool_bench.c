@@ -0,0 +1,82 @@
+#include "../hashmap/myhashmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+#include <time.h>
+
+/* Insert/remove churn: every op allocates or frees an entry */
+#define KEYS_PER_THREAD 50000
+#define ROUNDS 10
+#define MAX_THREADS 8
+
+struct worker_arg {
+	hashmap_s *map;
+	uint32_t first;
+};
+
+static int worker(void *arg) {
+	struct worker_arg *wa = (struct worker_arg *)arg;
+	uint64_t value = 0;
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (uint32_t key = wa->first; key < wa->first + KEYS_PER_THREAD; ++key) {
+			hm_set(wa->map, &key, &value);
+		}
+		for (uint32_t key = wa->first; key < wa->first + KEYS_PER_THREAD; ++key) {
+			hm_remove(wa->map, &key);
+		}
+	}
+
+	return 0;
+}
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double run(hm_alloc_e alloc, int num_threads) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint64_t),
+		.capacity = (size_t)KEYS_PER_THREAD * MAX_THREADS,
+		.alloc = alloc,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	if (map == NULL) {
+		return 0.0;
+	}
+
+	thrd_t threads[MAX_THREADS];
+	struct worker_arg args[MAX_THREADS];
+
+	double start = now();
+	for (int t = 0; t < num_threads; ++t) {
+		args[t] = (struct worker_arg){.map = map, .first = (uint32_t)t * KEYS_PER_THREAD};
+		thrd_create(&threads[t], worker, &args[t]);
+	}
+	for (int t = 0; t < num_threads; ++t) {
+		thrd_join(threads[t], NULL);
+	}
+	double elapsed = now() - start;
+
+	hm_free(map);
+
+	return 2.0 * KEYS_PER_THREAD * ROUNDS * num_threads / elapsed / 1e6;
+}
+
+int main(void) {
+	printf("insert/remove churn (Mops/s)\n");
+	printf("threads     malloc       pool\n");
+
+	for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		double malloc_ops = run(HM_ALLOC_MALLOC, threads);
+		double pool_ops = run(HM_ALLOC_POOL, threads);
+		printf("%7d %10.2f %10.2f\n", threads, malloc_ops, pool_ops);
+	}
+
+	return 0;
+}
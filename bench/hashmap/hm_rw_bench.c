@@ -0,0 +1,104 @@
+#include "../hashmap/myhashmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+#include <time.h>
+
+/* Read-mostly workload: 95% hm_get_value(), 5% hm_set() */
+#define OPS_PER_THREAD 500000
+#define WRITE_PERCENT 5
+#define MAX_THREADS 8
+
+static uint64_t u32_hash(const void *key) {
+	return *(const uint32_t *)key * 2654435761u;
+}
+
+static bool u32_equal(const void *key_a, const void *key_b) {
+	return *(const uint32_t *)key_a == *(const uint32_t *)key_b;
+}
+
+struct worker_arg {
+	hashmap_s *map;
+	uint32_t num_keys;
+	uint32_t seed;
+};
+
+static int worker(void *arg) {
+	struct worker_arg *wa = (struct worker_arg *)arg;
+	uint32_t seed = wa->seed;
+	uint64_t value = 0;
+
+	for (int i = 0; i < OPS_PER_THREAD; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		uint32_t key = (seed >> 8) % wa->num_keys;
+
+		if ((seed >> 24) % 100 < WRITE_PERCENT) {
+			value++;
+			hm_set(wa->map, &key, &value);
+		} else {
+			hm_get_value(wa->map, &key, &value);
+		}
+	}
+
+	return 0;
+}
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double run(hm_lock_e lock_mode, int num_threads, uint32_t num_keys) {
+	hm_config_s config = {
+		.hash = u32_hash,
+		.equal = u32_equal,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint64_t),
+		.lock_mode = lock_mode,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	if (map == NULL) {
+		return 0.0;
+	}
+
+	uint64_t value = 0;
+	for (uint32_t key = 0; key < num_keys; ++key) {
+		hm_set(map, &key, &value);
+	}
+
+	thrd_t threads[MAX_THREADS];
+	struct worker_arg args[MAX_THREADS];
+
+	double start = now();
+	for (int t = 0; t < num_threads; ++t) {
+		args[t] = (struct worker_arg){.map = map, .num_keys = num_keys, .seed = (uint32_t)t + 1};
+		thrd_create(&threads[t], worker, &args[t]);
+	}
+	for (int t = 0; t < num_threads; ++t) {
+		thrd_join(threads[t], NULL);
+	}
+	double elapsed = now() - start;
+
+	hm_free(map);
+
+	return (double)OPS_PER_THREAD * num_threads / elapsed / 1e6;
+}
+
+int main(void) {
+	/* Few hot keys: every thread hammers the same stripes */
+	uint32_t key_sets[] = {16, 100000};
+
+	for (size_t k = 0; k < sizeof(key_sets) / sizeof(key_sets[0]); ++k) {
+		printf("%u keys, %d%% writes (Mops/s)\n", key_sets[k], WRITE_PERCENT);
+		printf("threads      mutex     rwlock\n");
+
+		for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+			double mutex = run(HM_LOCK_MUTEX, threads, key_sets[k]);
+			double rwlock = run(HM_LOCK_RWLOCK, threads, key_sets[k]);
+			printf("%7d %10.2f %10.2f\n", threads, mutex, rwlock);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "../hashmap/myhashmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* String keys of 8 to 71 bytes: padded to a fixed 256-byte buffer or stored at their length */
+#define NUM_KEYS 200000
+#define PADDED_KEY 256
+
+static char keys[NUM_KEYS][PADDED_KEY];
+static size_t key_lens[NUM_KEYS];
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double run_padded(size_t *node_size) {
+	hm_config_s config = {
+		.key_type = HM_KEY_STRING,
+		.key_size = PADDED_KEY,
+		.value_size = sizeof(uint64_t),
+		.alloc = HM_ALLOC_POOL,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	if (map == NULL) {
+		return 0.0;
+	}
+	*node_size = map->slot_size;
+
+	double start = now();
+	for (uint64_t i = 0; i < NUM_KEYS; ++i) {
+		hm_set(map, keys[i], &i);
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		uint64_t value;
+		hm_get_value(map, keys[i], &value);
+	}
+	double elapsed = now() - start;
+
+	hm_free(map);
+
+	return 2.0 * NUM_KEYS / elapsed / 1e6;
+}
+
+static double run_variable(size_t inline_size, size_t *node_size) {
+	hm_config_s config = {
+		.variable = true,
+		.key_size = inline_size,
+		.value_size = sizeof(uint64_t),
+	};
+	hashmap_s *map = hm_new_config(&config);
+	if (map == NULL) {
+		return 0.0;
+	}
+	*node_size = map->slot_size;
+
+	double start = now();
+	for (uint64_t i = 0; i < NUM_KEYS; ++i) {
+		hm_set_var(map, keys[i], key_lens[i], &i, sizeof(i));
+	}
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		uint64_t value;
+		size_t value_len = sizeof(value);
+		hm_get_var(map, keys[i], key_lens[i], &value, &value_len);
+	}
+	double elapsed = now() - start;
+
+	hm_free(map);
+
+	return 2.0 * NUM_KEYS / elapsed / 1e6;
+}
+
+int main(void) {
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		int len = snprintf(keys[i], PADDED_KEY, "user:%zu:", i);
+		while ((size_t)len < 8 + i % 64) {
+			keys[i][len++] = (char)('a' + i % 26);
+		}
+		key_lens[i] = (size_t)len;
+	}
+
+	printf("string keys, set + get (Mops/s) and node size (bytes)\n");
+	printf("layout                 Mops/s   node\n");
+
+	size_t node_size = 0;
+	double ops = run_padded(&node_size);
+	printf("padded to %-8d %11.2f %6zu\n", PADDED_KEY, ops, node_size);
+	size_t inline_sizes[] = {0, 24, 72};
+	for (size_t i = 0; i < sizeof(inline_sizes) / sizeof(inline_sizes[0]); ++i) {
+		ops = run_variable(inline_sizes[i], &node_size);
+		printf("variable, %2zu inline %11.2f %6zu\n", inline_sizes[i], ops, node_size);
+	}
+
+	return 0;
+}
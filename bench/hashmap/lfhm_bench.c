@@ -0,0 +1,139 @@
+#include "../hashmap/myhashmap.h"
+#include "../hashmap/mylfhashmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+#include <time.h>
+
+/* Read-mostly workload: 95% lookups, 5% updates, against every concurrent map flavour */
+#define OPS_PER_THREAD 500000
+#define WRITE_PERCENT 5
+#define MAX_THREADS 8
+
+static uint64_t u32_hash(const void *key) {
+	return *(const uint32_t *)key * 2654435761u;
+}
+
+static bool u32_equal(const void *key_a, const void *key_b) {
+	return *(const uint32_t *)key_a == *(const uint32_t *)key_b;
+}
+
+struct worker_arg {
+	hashmap_s *map;
+	lfhashmap_s *lfmap;
+	uint32_t num_keys;
+	uint32_t seed;
+};
+
+static int worker(void *arg) {
+	struct worker_arg *wa = (struct worker_arg *)arg;
+	lfhm_thread_s *thread = wa->lfmap != NULL ? lfhm_thread_register(wa->lfmap) : NULL;
+	uint32_t seed = wa->seed;
+	uint64_t value = 0;
+
+	for (int i = 0; i < OPS_PER_THREAD; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		uint32_t key = (seed >> 8) % wa->num_keys;
+		bool write = (seed >> 24) % 100 < WRITE_PERCENT;
+
+		if (thread != NULL) {
+			if (write) {
+				value++;
+				lfhm_set(thread, &key, &value);
+			} else {
+				lfhm_get(thread, &key, &value);
+			}
+		} else if (write) {
+			value++;
+			hm_set(wa->map, &key, &value);
+		} else {
+			hm_get_value(wa->map, &key, &value);
+		}
+	}
+
+	lfhm_thread_unregister(thread);
+
+	return 0;
+}
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* lock_mode < 0 selects the lock-free-reader map */
+static double run(int lock_mode, int num_threads, uint32_t num_keys) {
+	hashmap_s *map = NULL;
+	lfhashmap_s *lfmap = NULL;
+	lfhm_thread_s *thread = NULL;
+
+	if (lock_mode < 0) {
+		lfmap = lfhm_new(u32_hash, u32_equal, sizeof(uint32_t), sizeof(uint64_t), 0);
+		thread = lfhm_thread_register(lfmap);
+		if (thread == NULL) {
+			lfhm_free(lfmap);
+			return 0.0;
+		}
+	} else {
+		hm_config_s config = {
+			.hash = u32_hash,
+			.equal = u32_equal,
+			.key_size = sizeof(uint32_t),
+			.value_size = sizeof(uint64_t),
+			.lock_mode = (hm_lock_e)lock_mode,
+		};
+		map = hm_new_config(&config);
+		if (map == NULL) {
+			return 0.0;
+		}
+	}
+
+	uint64_t value = 0;
+	for (uint32_t key = 0; key < num_keys; ++key) {
+		if (thread != NULL) {
+			lfhm_set(thread, &key, &value);
+		} else {
+			hm_set(map, &key, &value);
+		}
+	}
+	lfhm_thread_unregister(thread);
+
+	thrd_t threads[MAX_THREADS];
+	struct worker_arg args[MAX_THREADS];
+
+	double start = now();
+	for (int t = 0; t < num_threads; ++t) {
+		args[t] = (struct worker_arg){
+			.map = map, .lfmap = lfmap, .num_keys = num_keys, .seed = (uint32_t)t + 1};
+		thrd_create(&threads[t], worker, &args[t]);
+	}
+	for (int t = 0; t < num_threads; ++t) {
+		thrd_join(threads[t], NULL);
+	}
+	double elapsed = now() - start;
+
+	hm_free(map);
+	lfhm_free(lfmap);
+
+	return (double)OPS_PER_THREAD * num_threads / elapsed / 1e6;
+}
+
+int main(void) {
+	/* Few hot keys: every thread hammers the same stripes */
+	uint32_t key_sets[] = {16, 100000};
+
+	for (size_t k = 0; k < sizeof(key_sets) / sizeof(key_sets[0]); ++k) {
+		printf("%u keys, %d%% writes (Mops/s)\n", key_sets[k], WRITE_PERCENT);
+		printf("threads      mutex     rwlock  lock-free\n");
+
+		for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+			double mutex = run(HM_LOCK_MUTEX, threads, key_sets[k]);
+			double rwlock = run(HM_LOCK_RWLOCK, threads, key_sets[k]);
+			double lockfree = run(-1, threads, key_sets[k]);
+			printf("%7d %10.2f %10.2f %10.2f\n", threads, mutex, rwlock, lockfree);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,101 @@
+#include "../hashmap/myhashmap.h"
+#include "../hashmap/myshardmap.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+#include <time.h>
+
+/* Write-only churn from a small initial table: every insert and remove updates a size counter */
+#define KEYS_PER_THREAD 100000
+#define ROUNDS 5
+#define MAX_THREADS 8
+
+struct worker_arg {
+	hashmap_s *map;
+	shardmap_s *smap;
+	uint32_t first;
+};
+
+static int worker(void *arg) {
+	struct worker_arg *wa = (struct worker_arg *)arg;
+	uint64_t value = 0;
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (uint32_t key = wa->first; key < wa->first + KEYS_PER_THREAD; ++key) {
+			if (wa->smap != NULL) {
+				smap_set(wa->smap, &key, &value);
+			} else {
+				hm_set(wa->map, &key, &value);
+			}
+		}
+		for (uint32_t key = wa->first; key < wa->first + KEYS_PER_THREAD; ++key) {
+			if (wa->smap != NULL) {
+				smap_remove(wa->smap, &key);
+			} else {
+				hm_remove(wa->map, &key);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* num_shards == 0 runs a single hashmap */
+static double run(size_t num_shards, int num_threads) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint64_t),
+		.alloc = HM_ALLOC_POOL,
+	};
+	hashmap_s *map = NULL;
+	shardmap_s *smap = NULL;
+	if (num_shards == 0) {
+		map = hm_new_config(&config);
+	} else {
+		smap = smap_new(&config, num_shards);
+	}
+	if (map == NULL && smap == NULL) {
+		return 0.0;
+	}
+
+	thrd_t threads[MAX_THREADS];
+	struct worker_arg args[MAX_THREADS];
+
+	double start = now();
+	for (int t = 0; t < num_threads; ++t) {
+		args[t] = (struct worker_arg){
+			.map = map, .smap = smap, .first = (uint32_t)t * KEYS_PER_THREAD};
+		thrd_create(&threads[t], worker, &args[t]);
+	}
+	for (int t = 0; t < num_threads; ++t) {
+		thrd_join(threads[t], NULL);
+	}
+	double elapsed = now() - start;
+
+	hm_free(map);
+	smap_free(smap);
+
+	return 2.0 * KEYS_PER_THREAD * ROUNDS * num_threads / elapsed / 1e6;
+}
+
+int main(void) {
+	printf("insert/remove churn (Mops/s)\n");
+	printf("threads    hashmap   4 shards  16 shards\n");
+
+	for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		double single = run(0, threads);
+		double four = run(4, threads);
+		double sixteen = run(16, threads);
+		printf("%7d %10.2f %10.2f %10.2f\n", threads, single, four, sixteen);
+	}
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include "../vector/myvector.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Small-element push and scan loops, where the per-call lock dominates */
+#define NUM_ELEMS 10000000
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(const char *name, vec_s *v) {
+	if (v == NULL) {
+		return;
+	}
+
+	double start = now();
+	for (uint32_t i = 0; i < NUM_ELEMS; ++i) {
+		vec_push(v, &i);
+	}
+	double push = now() - start;
+
+	uint64_t sum = 0;
+	start = now();
+	for (size_t i = 0; i < NUM_ELEMS; ++i) {
+		uint32_t value;
+		vec_get_into(v, i, &value);
+		sum += value;
+	}
+	double get = now() - start;
+
+	printf("%-8s %10.2f %10.2f   (sum %llu)\n", name, NUM_ELEMS / push / 1e6, NUM_ELEMS / get / 1e6,
+		   (unsigned long long)sum);
+
+	vec_free(v);
+}
+
+int main(void) {
+	printf("uint32_t elements (Mops/s)\n");
+	printf("vector         push        get\n");
+
+	run("locked", vec_new(0, sizeof(uint32_t)));
+	run("unsync", vec_new_unsync(0, sizeof(uint32_t)));
+
+	return 0;
+}
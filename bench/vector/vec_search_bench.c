@@ -0,0 +1,75 @@
+#include "../vector/myvector.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Full scans of a large vector, against a vec_foreach() callback per element */
+#define NUM_ELEMS 10000000
+#define ROUNDS 10
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t needle;
+static size_t matches;
+
+static void count_callback(size_t index, void *elem) {
+	(void)index;
+	matches += *(uint32_t *)elem == needle;
+}
+
+int main(void) {
+	vec_s *v = vec_new(NUM_ELEMS, sizeof(uint32_t));
+	if (v == NULL) {
+		return 1;
+	}
+	uint32_t seed = 1;
+	for (size_t i = 0; i < NUM_ELEMS; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		uint32_t value = seed >> 8;
+		vec_push(v, &value);
+	}
+	needle = 12345;
+
+	printf("%d uint32_t, %d rounds (GB/s)\n", NUM_ELEMS, ROUNDS);
+	double bytes = (double)NUM_ELEMS * sizeof(uint32_t) * ROUNDS / 1e9;
+
+	double start = now();
+	for (int r = 0; r < ROUNDS; ++r) {
+		vec_foreach(v, count_callback);
+	}
+	printf("vec_foreach count %8.2f   (%zu)\n", bytes / (now() - start), matches);
+
+	size_t count = 0;
+	start = now();
+	for (int r = 0; r < ROUNDS; ++r) {
+		count += vec_count(v, &needle);
+	}
+	printf("vec_count         %8.2f   (%zu)\n", bytes / (now() - start), count);
+
+	size_t index = 0;
+	uint32_t absent = UINT32_MAX;
+	start = now();
+	for (int r = 0; r < ROUNDS; ++r) {
+		index += vec_find(v, &absent, NULL) == 0;
+	}
+	printf("vec_find (absent) %8.2f   (%zu)\n", bytes / (now() - start), index);
+
+	uint32_t extreme = 0;
+	uint64_t sum = 0;
+	start = now();
+	for (int r = 0; r < ROUNDS; ++r) {
+		vec_max(v, VEC_KEY_U32, &extreme);
+		sum += extreme;
+	}
+	printf("vec_max           %8.2f   (%llu)\n", bytes / (now() - start),
+		   (unsigned long long)sum);
+
+	vec_free(v);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include "../vector/myvector.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Random 64-bit keys, every engine against the same input */
+#define NUM_ELEMS 10000000
+
+static int u64_cmp(const void *a, const void *b) {
+	uint64_t ka = *(const uint64_t *)a;
+	uint64_t kb = *(const uint64_t *)b;
+	return (ka > kb) - (ka < kb);
+}
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* engine: 0 qsort, 1 vec_sort, 2 vec_sort_radix, otherwise vec_sort_parallel with that many */
+static double run(const uint64_t *input, int engine) {
+	vec_s *v = vec_new(NUM_ELEMS, sizeof(uint64_t));
+	if (v == NULL || vec_push_n(v, input, NUM_ELEMS) != 0) {
+		vec_free(v);
+		return 0.0;
+	}
+
+	double start = now();
+	switch (engine) {
+	case 0:
+		qsort(v->data, NUM_ELEMS, sizeof(uint64_t), u64_cmp);
+		break;
+	case 1:
+		vec_sort(v, u64_cmp);
+		break;
+	case 2:
+		vec_sort_radix(v, VEC_KEY_U64, 0);
+		break;
+	default:
+		vec_sort_parallel(v, u64_cmp, (size_t)engine);
+		break;
+	}
+	double elapsed = now() - start;
+
+	vec_free(v);
+
+	return elapsed * 1e3;
+}
+
+int main(void) {
+	uint64_t *input = malloc(NUM_ELEMS * sizeof(uint64_t));
+	if (input == NULL) {
+		return 1;
+	}
+	uint64_t seed = 42;
+	for (size_t i = 0; i < NUM_ELEMS; ++i) {
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		input[i] = seed;
+	}
+
+	printf("%d uint64_t (ms)\n", NUM_ELEMS);
+	printf("qsort             %10.1f\n", run(input, 0));
+	printf("vec_sort          %10.1f\n", run(input, 1));
+	printf("vec_sort_radix    %10.1f\n", run(input, 2));
+	printf("parallel, 4 thr   %10.1f\n", run(input, 4));
+	printf("parallel, 8 thr   %10.1f\n", run(input, 8));
+
+	free(input);
+
+	return 0;
+}
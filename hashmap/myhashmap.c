@@ -1,22 +1,72 @@
 #include "myhashmap.h"
+#include "myhashmap_internal.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /*
- * @brief Returns the mutex ID based on hash value.
+ * @brief Returns the next power of two of a number.
  */
-static inline size_t get_mutex(hashmap_s *hashmap, size_t hash) {
-	return hash % hashmap->num_locks;
+static size_t next_power_two(size_t len) {
+	size_t p = 1;
+	while (p < len) {
+		if (p > SIZE_MAX / 2) {
+			return 0;
+		}
+		p <<= 1;
+	}
+
+	return p;
+}
+
+/*
+ * @brief Returns log2 of a power of two.
+ */
+static unsigned int log2_pow2(size_t n) {
+	unsigned int bits = 0;
+	while (n > 1) {
+		n >>= 1;
+		bits++;
+	}
+
+	return bits;
+}
+
+/*
+ * @brief Returns the chain head a hash currently lives in.
+ *
+ * While a resize is in progress, buckets of the old table that the stripe has not migrated yet
+ * are still authoritative. Must be called with the stripe lock held.
+ */
+static bucket_s **get_chain(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash) {
+	if (hashmap->old_map != NULL) {
+		/* Old and new buckets of a hash belong to the same stripe range */
+		size_t old_index = hash_index(hash, hashmap->old_capacity_bits);
+		if (old_index >= stripe->rehash_pos) {
+			return &hashmap->old_map[old_index];
+		}
+	}
+
+	return &hashmap->map[hash_index(hash, hashmap->capacity_bits)];
 }
 
 /*
- * @brief Returns the bucket index for a given key.
+ * @brief Find a key in the chain of its hash.
+ * @return The link pointing to the matching bucket, or to the NULL terminating the chain.
  */
-static inline size_t get_bucket_index(hashmap_s *hashmap, void *key) {
-	unsigned int hash = hashmap->hash(key);
-	return (size_t)(hash % MYCLIB_HASHMAP_SIZE);
+static bucket_s **find_link(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash,
+							const void *key) {
+	bucket_s **link = get_chain(hashmap, stripe, hash);
+
+	/* Most mismatches are rejected on the cached hash without calling equal */
+	while (*link != NULL && ((*link)->hash != hash || !key_equal(hashmap, (*link)->key, key))) {
+		link = &(*link)->next;
+	}
+
+	return link;
 }
 
 /*
@@ -47,529 +97,2143 @@ static void free_bucket_content(hashmap_s *hashmap, bucket_s *bucket) {
 }
 
 /*
- * @brief Find a bucket by key in the chain.
- * @param[out] prev Set to the previous bucket in the chain (or NULL if first).
+ * @brief Free every bucket of a chain.
  */
-static bucket_s *find_bucket(hashmap_s *hashmap, void *key, bucket_s **prev) {
-	size_t index = get_bucket_index(hashmap, key);
-	bucket_s *bucket = &hashmap->map[index];
-	*prev = NULL;
-
-	if (bucket->key == NULL) {
-		return NULL;
+static void free_chain(hashmap_s *hashmap, bucket_s *bucket) {
+	while (bucket != NULL) {
+		bucket_s *next = bucket->next;
+		free_bucket_content(hashmap, bucket);
+		free(bucket);
+		bucket = next;
 	}
+}
 
-	while (bucket != NULL) {
-		if (hashmap->equal(bucket->key, key)) {
-			return bucket;
+/*
+ * @brief Allocate a bucket with room for its key and value, left uninitialized.
+ *
+ * Must be called with the stripe lock held.
+ */
+static bucket_s *alloc_bucket(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->alloc == HM_ALLOC_POOL) {
+		unsigned char *node = hm_pool_alloc(&stripe->pool, hashmap->slot_size);
+		if (node == NULL) {
+			return NULL;
 		}
-		*prev = bucket;
-		bucket = bucket->next;
+
+		bucket_s *bucket = (bucket_s *)node;
+		bucket->key = node + pool_key_offset(hashmap);
+		bucket->value = node + hashmap->value_offset;
+		HM_STAT_INC(stripe->allocs);
+		return bucket;
 	}
 
-	return NULL;
-}
+	bucket_s *bucket = malloc(bucket_header_size(hashmap));
+	if (bucket == NULL) {
+		return NULL;
+	}
 
-hashmap_s *hm_new(hash_f *hash_fn, equal_f *equal_fn, free_key_f *free_key_fn,
-				  free_value_f *free_value_fn, size_t key_size, size_t value_size) {
-	if (hash_fn == NULL || equal_fn == NULL || key_size == 0 || value_size == 0) {
+	bucket->key = malloc(hashmap->key_size);
+	if (bucket->key == NULL) {
+		free(bucket);
 		return NULL;
 	}
 
-	hashmap_s *hashmap = malloc(sizeof(hashmap_s));
-	if (hashmap == NULL) {
+	bucket->value = malloc(hashmap->value_size);
+	if (bucket->value == NULL) {
+		free(bucket->key);
+		free(bucket);
 		return NULL;
 	}
+	HM_STAT_INC(stripe->allocs);
 
-	hashmap->hash = hash_fn;
-	hashmap->equal = equal_fn;
-	hashmap->free_key = free_key_fn;
-	hashmap->free_value = free_value_fn;
-	hashmap->key_size = key_size;
-	hashmap->value_size = value_size;
+	return bucket;
+}
 
-	atomic_init(&hashmap->size, 0);
+/*
+ * @brief Node bytes kept for the key of a variable-mode entry, right after room for its length.
+ */
+static unsigned char *var_key_slot(hashmap_s *hashmap, bucket_s *bucket) {
+	return (unsigned char *)bucket + pool_key_offset(hashmap) + HM_VAR_PREFIX;
+}
 
-	hashmap->num_locks = 64;
-	hashmap->locks = malloc(sizeof(mtx_t) * hashmap->num_locks);
-	if (hashmap->locks == NULL) {
-		free(hashmap);
-		return NULL;
-	}
+/*
+ * @brief Node bytes kept for the value of a variable-mode entry, right after room for its length.
+ */
+static unsigned char *var_value_slot(hashmap_s *hashmap, bucket_s *bucket) {
+	return (unsigned char *)bucket + hashmap->value_offset;
+}
 
-	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		if (mtx_init(&(hashmap->locks[i]), mtx_plain) != thrd_success) {
-			for (size_t j = 0; j < i; ++j) {
-				mtx_destroy(&(hashmap->locks[j]));
-			}
-			free(hashmap->locks);
-			free(hashmap);
+/*
+ * @brief Store a variable-length key or value with its length in front: in its node slot if it
+ * fits in the slot_size bytes there, in the stripe arena otherwise.
+ * @return The stored bytes, or NULL on allocation failure.
+ */
+static unsigned char *var_store(hm_stripe_s *stripe, unsigned char *slot, size_t slot_size,
+								const hm_blob_s *blob) {
+	unsigned char *data = slot;
+	if (blob->len > slot_size) {
+		unsigned char *stored = hm_arena_alloc(&stripe->arena, HM_VAR_PREFIX + blob->len);
+		if (stored == NULL) {
 			return NULL;
 		}
+		data = stored + HM_VAR_PREFIX;
 	}
 
-	memset(hashmap->map, 0, sizeof(hashmap->map));
+	uint32_t len = (uint32_t)blob->len;
+	memcpy(data - HM_VAR_PREFIX, &len, sizeof(len));
+	if (blob->len != 0) {
+		memcpy(data, blob->data, blob->len);
+	}
 
-	return hashmap;
+	return data;
 }
 
-void hm_free(hashmap_s *hashmap) {
-	if (hashmap == NULL) {
-		return;
+/*
+ * @brief Give a stored key or value back to the arena unless it sits in its node slot.
+ */
+static void var_release(hm_stripe_s *stripe, const unsigned char *slot, unsigned char *data) {
+	if (data != slot) {
+		hm_arena_free(&stripe->arena, data - HM_VAR_PREFIX, HM_VAR_PREFIX + var_len(data));
 	}
+}
 
-	for (size_t i = 0; i < MYCLIB_HASHMAP_SIZE; ++i) {
-		bucket_s *bucket = &hashmap->map[i];
-
-		if (bucket->key != NULL || bucket->value != NULL) {
-			free_bucket_content(hashmap, bucket);
-		}
-
-		bucket = bucket->next;
-		while (bucket != NULL) {
-			bucket_s *next = bucket->next;
-			free_bucket_content(hashmap, bucket);
-			free(bucket);
-			bucket = next;
-		}
+/*
+ * @brief Store the key and value of a new variable-mode entry.
+ * @return false on allocation failure, leaving nothing allocated but the node.
+ */
+static bool var_init(hashmap_s *hashmap, hm_stripe_s *stripe, bucket_s *bucket,
+					 const hm_blob_s *key, const hm_blob_s *value) {
+	unsigned char *key_slot = var_key_slot(hashmap, bucket);
+	bucket->key = var_store(stripe, key_slot, hashmap->key_size, key);
+	if (bucket->key == NULL) {
+		return false;
 	}
 
-	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_destroy(&(hashmap->locks[i]));
+	bucket->value = var_store(stripe, var_value_slot(hashmap, bucket), hashmap->value_size, value);
+	if (bucket->value == NULL) {
+		var_release(stripe, key_slot, bucket->key);
+		return false;
 	}
-	free(hashmap->locks);
 
-	free(hashmap);
+	return true;
 }
 
-void hm_free_bucket(bucket_s *bucket) {
-	if (bucket == NULL) {
+/*
+ * @brief Free a bucket unlinked from its chain. Must be called with the stripe lock held.
+ */
+static void free_bucket(hashmap_s *hashmap, hm_stripe_s *stripe, bucket_s *bucket) {
+	if (hashmap->alloc == HM_ALLOC_POOL) {
+		if (hashmap->variable) {
+			var_release(stripe, var_key_slot(hashmap, bucket), bucket->key);
+			var_release(stripe, var_value_slot(hashmap, bucket), bucket->value);
+		}
+		hm_pool_free(&stripe->pool, bucket);
 		return;
 	}
 
-	free(bucket->key);
-	free(bucket->value);
+	free_bucket_content(hashmap, bucket);
 	free(bucket);
 }
 
-bool hm_set(hashmap_s *hashmap, void *key, void *value) {
-	if (hashmap == NULL || key == NULL || value == NULL) {
-		return false;
+/*
+ * @brief Free every chain of a table, or just every pool slab when the pools own the buckets.
+ */
+static void free_all_buckets(hashmap_s *hashmap) {
+	if (hashmap->alloc == HM_ALLOC_POOL) {
+		for (size_t i = 0; i < hashmap->num_locks; ++i) {
+			hm_pool_release(&hashmap->locks[i].pool);
+			hm_arena_release(&hashmap->locks[i].arena);
+		}
+		return;
 	}
 
-	unsigned int hash = hashmap->hash(key);
-	size_t mutex_id = get_mutex(hashmap, hash);
-	mtx_t *mutex = &(hashmap->locks[mutex_id]);
-
-	if (mtx_lock(mutex) != thrd_success) {
-		return false;
+	for (size_t i = 0; i < hashmap->capacity; ++i) {
+		free_chain(hashmap, hashmap->map[i]);
 	}
+	for (size_t i = 0; i < hashmap->old_capacity && hashmap->old_map != NULL; ++i) {
+		free_chain(hashmap, hashmap->old_map[i]);
+	}
+}
 
-	bucket_s *prev = NULL;
-	bucket_s *existing = find_bucket(hashmap, key, &prev);
-
-	if (existing != NULL) {
-		/* Key exists - update value */
-		void *new_value = malloc(hashmap->value_size);
-		if (new_value == NULL) {
-			mtx_unlock(mutex);
-			return false;
-		}
-		memcpy(new_value, value, hashmap->value_size);
+/*
+ * @brief Milliseconds of a monotonic clock, used for entry expiry.
+ */
+static uint64_t now_ms(void) {
+	struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+	timespec_get(&ts, TIME_UTC);
+#endif
+
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
 
-		/* Free old value and assign new one */
-		if (hashmap->free_value != NULL && existing->value != NULL) {
-			hashmap->free_value(existing->value);
-		} else if (existing->value != NULL) {
-			free(existing->value);
-		}
-		existing->value = new_value;
+/*
+ * @brief Returns the expiry time of an entry written now with a lifetime of ttl_ms.
+ */
+static uint64_t expiry_time(uint64_t ttl_ms) {
+	return ttl_ms != 0 ? now_ms() + ttl_ms : 0;
+}
 
-		mtx_unlock(mutex);
-		return true;
+/*
+ * @brief Whether an entry has expired. The clock is only read once, and only if needed.
+ *
+ * @param[in,out] now Current time, 0 until read.
+ */
+static bool expired(const hm_cache_node_s *node, uint64_t *now) {
+	if (node->expires == 0) {
+		return false;
 	}
 
-	/* Key doesn't exist - insert new bucket */
-	size_t index = get_bucket_index(hashmap, key);
-	bucket_s *bucket = &hashmap->map[index];
-
-	if (bucket->key == NULL) {
-		/* Primary bucket is empty */
-		bucket->key = malloc(hashmap->key_size);
-		if (bucket->key == NULL) {
-			mtx_unlock(mutex);
-			return false;
-		}
+	if (*now == 0) {
+		*now = now_ms();
+	}
 
-		bucket->value = malloc(hashmap->value_size);
-		if (bucket->value == NULL) {
-			free(bucket->key);
-			bucket->key = NULL;
-			mtx_unlock(mutex);
-			return false;
-		}
+	return node->expires <= *now;
+}
 
-		memcpy(bucket->key, key, hashmap->key_size);
-		memcpy(bucket->value, value, hashmap->value_size);
-		bucket->next = NULL;
+/*
+ * @brief Whether an entry is visible: always, unless the map is a cache and it expired.
+ */
+static inline bool entry_live(hashmap_s *hashmap, bucket_s *bucket, uint64_t *now) {
+	return !hashmap->cache || !expired((hm_cache_node_s *)bucket, now);
+}
 
-		atomic_fetch_add(&hashmap->size, 1);
-		mtx_unlock(mutex);
-		return true;
+/*
+ * @brief Link a node at the most recently used end of its stripe's list.
+ */
+static void cache_push(hm_stripe_s *stripe, hm_cache_node_s *node) {
+	node->newer = NULL;
+	node->older = stripe->newest;
+	if (stripe->newest != NULL) {
+		stripe->newest->newer = node;
+	} else {
+		stripe->oldest = node;
 	}
+	stripe->newest = node;
+}
 
-	/* Collision - create new bucket and chain it */
-	bucket_s *new_bucket = malloc(sizeof(bucket_s));
-	if (new_bucket == NULL) {
-		mtx_unlock(mutex);
-		return false;
+static void cache_unlink(hm_stripe_s *stripe, hm_cache_node_s *node) {
+	if (node->newer != NULL) {
+		node->newer->older = node->older;
+	} else {
+		stripe->newest = node->older;
 	}
 
-	new_bucket->key = malloc(hashmap->key_size);
-	if (new_bucket->key == NULL) {
-		free(new_bucket);
-		mtx_unlock(mutex);
-		return false;
+	if (node->older != NULL) {
+		node->older->newer = node->newer;
+	} else {
+		stripe->oldest = node->newer;
 	}
+}
 
-	new_bucket->value = malloc(hashmap->value_size);
-	if (new_bucket->value == NULL) {
-		free(new_bucket->key);
-		free(new_bucket);
-		mtx_unlock(mutex);
-		return false;
+/*
+ * @brief Record a use of an entry.
+ *
+ * LRU moves it to the recent end, which needs the stripe exclusively. CLOCK only raises a flag,
+ * which readers sharing the stripe can do.
+ */
+static void cache_touch(hashmap_s *hashmap, hm_stripe_s *stripe, hm_cache_node_s *node) {
+	if (hashmap->eviction == HM_EVICT_CLOCK) {
+		if (!atomic_load_explicit(&node->referenced, memory_order_relaxed)) {
+			atomic_store_explicit(&node->referenced, true, memory_order_relaxed);
+		}
+		return;
 	}
 
-	memcpy(new_bucket->key, key, hashmap->key_size);
-	memcpy(new_bucket->value, value, hashmap->value_size);
+	if (stripe->newest != node) {
+		cache_unlink(stripe, node);
+		cache_push(stripe, node);
+	}
+}
 
-	/* Insert at head of chain */
-	new_bucket->next = bucket->next;
-	bucket->next = new_bucket;
+/*
+ * @brief Unlink a node from its chain and its list and free it.
+ *
+ * Must be called with the stripe lock held exclusively.
+ */
+static void cache_remove(hashmap_s *hashmap, hm_stripe_s *stripe, hm_cache_node_s *node) {
+	bucket_s **link = get_chain(hashmap, stripe, node->bucket.hash);
+	while (*link != &node->bucket) {
+		link = &(*link)->next;
+	}
+	*link = node->bucket.next;
 
-	atomic_fetch_add(&hashmap->size, 1);
-	mtx_unlock(mutex);
-	return true;
+	cache_unlink(stripe, node);
+	stripe->count--;
+	free_bucket(hashmap, stripe, &node->bucket);
+	atomic_fetch_sub(&hashmap->size, 1);
 }
 
 /*
- * @brief Create a copy of a bucket.
+ * @brief Make room for one more entry in a stripe.
+ *
+ * Drops expired entries from the old end, then evicts until an insert stays within the bound.
+ * Must be called with the stripe lock held exclusively.
  */
-static bucket_s *get_bucket_copy(bucket_s *from, size_t key_size, size_t value_size) {
-	if (from == NULL) {
-		return NULL;
+static void cache_make_room(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	uint64_t now = 0;
+	while (stripe->oldest != NULL && expired(stripe->oldest, &now)) {
+		cache_remove(hashmap, stripe, stripe->oldest);
 	}
 
-	bucket_s *copy = malloc(sizeof(bucket_s));
-	if (copy == NULL) {
-		return NULL;
+	if (hashmap->stripe_max == 0) {
+		return;
 	}
-	copy->key = NULL;
-	copy->value = NULL;
-	copy->next = NULL;
 
-	if (from->key != NULL) {
-		copy->key = malloc(key_size);
-		if (copy->key == NULL) {
-			free(copy);
-			return NULL;
-		}
-		memcpy(copy->key, from->key, key_size);
-	}
+	while (stripe->count >= hashmap->stripe_max) {
+		hm_cache_node_s *victim = stripe->oldest;
 
-	if (from->value != NULL) {
-		copy->value = malloc(value_size);
-		if (copy->value == NULL) {
-			free(copy->key);
-			free(copy);
-			return NULL;
+		/* Second chance: a flagged entry goes back to the recent end with its flag cleared */
+		if (hashmap->eviction == HM_EVICT_CLOCK &&
+			atomic_exchange_explicit(&victim->referenced, false, memory_order_relaxed)) {
+			cache_unlink(stripe, victim);
+			cache_push(stripe, victim);
+			continue;
 		}
-		memcpy(copy->value, from->value, value_size);
-	}
 
-	return copy;
+		cache_remove(hashmap, stripe, victim);
+	}
 }
 
-bucket_s *hm_get(hashmap_s *hashmap, void *key) {
-	if (hashmap == NULL || key == NULL) {
-		return NULL;
-	}
+/*
+ * @brief Move one bucket chain of the old table into the new one.
+ */
+static void migrate_bucket(hashmap_s *hashmap, size_t old_index) {
+	bucket_s *bucket = hashmap->old_map[old_index];
+	hashmap->old_map[old_index] = NULL;
 
-	unsigned int hash = hashmap->hash(key);
-	size_t mutex_id = get_mutex(hashmap, hash);
-	mtx_t *mutex = &(hashmap->locks[mutex_id]);
+	while (bucket != NULL) {
+		bucket_s *next = bucket->next;
+		size_t index = hash_index(bucket->hash, hashmap->capacity_bits);
 
-	if (mtx_lock(mutex) != thrd_success) {
-		return NULL;
+		bucket->next = hashmap->map[index];
+		hashmap->map[index] = bucket;
+		bucket = next;
 	}
+}
 
-	bucket_s *prev = NULL;
-	bucket_s *found = find_bucket(hashmap, key, &prev);
-
-	bucket_s *copy = NULL;
-	if (found != NULL) {
-		copy = get_bucket_copy(found, hashmap->key_size, hashmap->value_size);
-	}
+/*
+ * @brief Returns the first bucket of a stripe range in a table of 1 << bits buckets.
+ */
+static inline size_t stripe_first_bucket(hashmap_s *hashmap, size_t stripe_id, unsigned int bits) {
+	return stripe_id << (bits - hashmap->lock_bits);
+}
 
-	mtx_unlock(mutex);
-	return copy;
+/*
+ * @brief Returns the end of the old bucket range owned by a stripe.
+ */
+static inline size_t stripe_old_end(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	size_t stripe_id = (size_t)(stripe - hashmap->locks);
+	return stripe_first_bucket(hashmap, stripe_id + 1, hashmap->old_capacity_bits);
 }
 
-bool hm_remove(hashmap_s *hashmap, void *key) {
-	if (hashmap == NULL || key == NULL) {
+/*
+ * @brief Migrate up to MYCLIB_HASHMAP_REHASH_STEP old buckets owned by a stripe.
+ *
+ * Must be called with the stripe lock held.
+ * @return true if this call completed the last pending stripe and the old table can be freed.
+ */
+static bool rehash_step(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->old_map == NULL) {
 		return false;
 	}
 
-	unsigned int hash = hashmap->hash(key);
-	size_t mutex_id = get_mutex(hashmap, hash);
-	mtx_t *mutex = &(hashmap->locks[mutex_id]);
-
-	if (mtx_lock(mutex) != thrd_success) {
+	size_t end = stripe_old_end(hashmap, stripe);
+	if (stripe->rehash_pos >= end) {
 		return false;
 	}
 
-	bucket_s *prev = NULL;
-	bucket_s *to_remove = find_bucket(hashmap, key, &prev);
+	for (size_t n = 0; n < MYCLIB_HASHMAP_REHASH_STEP && stripe->rehash_pos < end; ++n) {
+		migrate_bucket(hashmap, stripe->rehash_pos++);
+	}
 
-	if (to_remove == NULL) {
-		mtx_unlock(mutex);
+	if (stripe->rehash_pos < end) {
 		return false;
 	}
 
-	if (prev == NULL) {
-		/* Removing primary bucket */
-		if (to_remove->next != NULL) {
-			/* Move next bucket content to primary */
-			bucket_s *next_bucket = to_remove->next;
-
-			free_bucket_content(hashmap, to_remove);
+	return atomic_fetch_sub(&hashmap->rehash_left, 1) == 1;
+}
 
-			to_remove->key = next_bucket->key;
-			to_remove->value = next_bucket->value;
-			to_remove->next = next_bucket->next;
+/*
+ * @brief Migrate everything left in the old table and release it.
+ *
+ * Must be called with all stripe locks held.
+ */
+static void finish_rehash(hashmap_s *hashmap) {
+	if (hashmap->old_map == NULL) {
+		return;
+	}
 
-			free(next_bucket);
-		} else {
-			/* No chain, just clear */
-			free_bucket_content(hashmap, to_remove);
-			to_remove->next = NULL;
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		hm_stripe_s *stripe = &hashmap->locks[i];
+		size_t end = stripe_old_end(hashmap, stripe);
+		while (stripe->rehash_pos < end) {
+			migrate_bucket(hashmap, stripe->rehash_pos++);
 		}
-	} else {
-		/* Removing from chain */
-		prev->next = to_remove->next;
-		free_bucket_content(hashmap, to_remove);
-		free(to_remove);
 	}
 
-	atomic_fetch_sub(&hashmap->size, 1);
-
-	mtx_unlock(mutex);
-	return true;
+	free(hashmap->old_map);
+	hashmap->old_map = NULL;
+	hashmap->old_capacity = 0;
+	hashmap->old_capacity_bits = 0;
+	atomic_store(&hashmap->rehash_left, 0);
 }
 
-size_t hm_size(hashmap_s *hashmap) {
-	if (hashmap == NULL) {
-		return 0;
-	}
-
-	return atomic_load(&hashmap->size);
-}
+/*
+ * @brief Release the old table once every stripe migrated its part.
+ */
+static void release_old_table(hashmap_s *hashmap) {
+	lock_all(hashmap);
 
-bool hm_contains(hashmap_s *hashmap, void *key) {
-	if (hashmap == NULL || key == NULL) {
-		return false;
+	/* A concurrent grow may already have released it and started a new resize */
+	if (hashmap->old_map != NULL && atomic_load(&hashmap->rehash_left) == 0) {
+		finish_rehash(hashmap);
 	}
 
-	bucket_s *b = hm_get(hashmap, key);
-	if (b != NULL) {
-		hm_free_bucket(b);
-		return true;
-	}
+	unlock_all(hashmap);
+}
 
-	return false;
+static inline bool over_load_factor(hashmap_s *hashmap, size_t size) {
+	return size > hashmap->capacity / MYCLIB_HASHMAP_LOAD_DEN * MYCLIB_HASHMAP_LOAD_NUM;
 }
 
-void hm_foreach(hashmap_s *hashmap, void (*callback)(bucket_s *bucket)) {
-	if (hashmap == NULL || callback == NULL) {
+/*
+ * @brief Start an incremental resize to twice the current capacity.
+ *
+ * Only swaps the tables: buckets are moved later by rehash_step(). If a previous resize is still
+ * pending it is completed first. On allocation failure the map keeps working with its current
+ * table.
+ */
+static void grow(hashmap_s *hashmap) {
+	lock_all(hashmap);
+
+	if (!over_load_factor(hashmap, atomic_load(&hashmap->size)) ||
+		hashmap->capacity > SIZE_MAX / 2 / sizeof(bucket_s *)) {
+		unlock_all(hashmap);
 		return;
 	}
 
-	/* Lock all mutexes */
-	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_lock(&hashmap->locks[i]);
+	bucket_s **map = calloc(hashmap->capacity * 2, sizeof(bucket_s *));
+	if (map == NULL) {
+		unlock_all(hashmap);
+		return;
 	}
 
-	for (size_t i = 0; i < MYCLIB_HASHMAP_SIZE; ++i) {
-		bucket_s *bucket = &hashmap->map[i];
+	finish_rehash(hashmap);
 
-		if (bucket->key != NULL) {
-			bucket_s *copy = get_bucket_copy(bucket, hashmap->key_size, hashmap->value_size);
-			if (copy != NULL) {
-				callback(copy);
-				hm_free_bucket(copy);
-			}
-		}
-
-		bucket = bucket->next;
-		while (bucket != NULL) {
-			bucket_s *copy = get_bucket_copy(bucket, hashmap->key_size, hashmap->value_size);
-			if (copy != NULL) {
-				callback(copy);
-				hm_free_bucket(copy);
-			}
-			bucket = bucket->next;
-		}
-	}
+	hashmap->old_map = hashmap->map;
+	hashmap->old_capacity = hashmap->capacity;
+	hashmap->old_capacity_bits = hashmap->capacity_bits;
+	hashmap->map = map;
+	hashmap->capacity *= 2;
+	hashmap->capacity_bits++;
 
-	/* Unlock all mutexes */
 	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_unlock(&hashmap->locks[i]);
+		hashmap->locks[i].rehash_pos = stripe_first_bucket(hashmap, i, hashmap->old_capacity_bits);
 	}
+	atomic_store(&hashmap->rehash_left, hashmap->num_locks);
+
+	unlock_all(hashmap);
 }
 
-void hm_clear(hashmap_s *hashmap) {
-	if (hashmap == NULL) {
-		return;
-	}
+/*
+ * @brief Resize the chained table in one go so that size entries fit under the load factor.
+ *
+ * Must be called with all stripe locks held. Completes a pending resize first.
+ * @return false on allocation failure, the map keeps its current table.
+ */
+static bool reserve_table(hashmap_s *hashmap, size_t size) {
+	size_t capacity = hashmap->capacity;
+	unsigned int bits = hashmap->capacity_bits;
 
-	/* Lock all mutexes */
-	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_lock(&hashmap->locks[i]);
+	while (size > capacity / MYCLIB_HASHMAP_LOAD_DEN * MYCLIB_HASHMAP_LOAD_NUM) {
+		if (capacity > SIZE_MAX / 2 / sizeof(bucket_s *)) {
+			return false;
+		}
+		capacity *= 2;
+		bits++;
 	}
 
-	for (size_t i = 0; i < MYCLIB_HASHMAP_SIZE; ++i) {
-		bucket_s *bucket = &hashmap->map[i];
+	finish_rehash(hashmap);
+	if (capacity == hashmap->capacity) {
+		return true;
+	}
 
-		if (bucket->key != NULL || bucket->value != NULL) {
-			free_bucket_content(hashmap, bucket);
-		}
+	bucket_s **map = calloc(capacity, sizeof(bucket_s *));
+	if (map == NULL) {
+		return false;
+	}
 
-		bucket = bucket->next;
+	for (size_t i = 0; i < hashmap->capacity; ++i) {
+		bucket_s *bucket = hashmap->map[i];
 		while (bucket != NULL) {
 			bucket_s *next = bucket->next;
-			free_bucket_content(hashmap, bucket);
-			free(bucket);
+			size_t index = hash_index(bucket->hash, bits);
+
+			bucket->next = map[index];
+			map[index] = bucket;
 			bucket = next;
 		}
-
-		hashmap->map[i].key = NULL;
-		hashmap->map[i].value = NULL;
-		hashmap->map[i].next = NULL;
 	}
 
-	atomic_store(&hashmap->size, 0);
+	free(hashmap->map);
+	hashmap->map = map;
+	hashmap->capacity = capacity;
+	hashmap->capacity_bits = bits;
 
-	/* Unlock all mutexes */
-	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_unlock(&hashmap->locks[i]);
-	}
+	return true;
 }
 
-void **hm_get_keys(hashmap_s *hashmap, size_t *count) {
-	if (hashmap == NULL || count == NULL) {
+hashmap_s *hm_new(hash_f *hash_fn, equal_f *equal_fn, free_key_f *free_key_fn,
+				  free_value_f *free_value_fn, size_t key_size, size_t value_size,
+				  size_t capacity) {
+	hm_config_s config = {
+		.hash = hash_fn,
+		.equal = equal_fn,
+		.free_key = free_key_fn,
+		.free_value = free_value_fn,
+		.key_size = key_size,
+		.value_size = value_size,
+		.capacity = capacity,
+		.backend = HM_BACKEND_CHAINED,
+	};
+
+	return hm_new_config(&config);
+}
+
+hashmap_s *hm_new_config(const hm_config_s *config) {
+	if (config == NULL) {
+		return NULL;
+	}
+
+	if (config->variable) {
+		/* Map-owned storage, and inline sizes small enough for the node layout not to overflow */
+		if (config->backend == HM_BACKEND_FLAT || config->free_key != NULL ||
+			config->free_value != NULL || config->key_size > UINT32_MAX ||
+			config->value_size > UINT32_MAX) {
+			return NULL;
+		}
+	} else if (config->key_size == 0 || config->value_size == 0) {
+		return NULL;
+	}
+
+	if (!config->variable && config->key_type == HM_KEY_CUSTOM &&
+		(config->hash == NULL || config->equal == NULL)) {
+		return NULL;
+	}
+
+	if ((config->backend == HM_BACKEND_FLAT || config->alloc == HM_ALLOC_POOL) &&
+		(config->free_key != NULL || config->free_value != NULL)) {
+		/* Flat and pooled entries live inside map-owned storage, there is nothing to free */
+		return NULL;
+	}
+
+	bool cache = config->max_entries != 0 || config->ttl_ms != 0;
+	if (cache && config->backend == HM_BACKEND_FLAT) {
+		/* Flat entries move when the table shifts, they cannot sit in a list */
+		return NULL;
+	}
+
+	size_t capacity = config->capacity;
+	if (capacity == 0) {
+		capacity = MYCLIB_HASHMAP_SIZE;
+	}
+	size_t num_locks = next_power_two(config->num_stripes != 0 ? config->num_stripes
+																: MYCLIB_HASHMAP_LOCKS);
+	if (num_locks == 0 || num_locks > SIZE_MAX / sizeof(hm_stripe_s)) {
+		return NULL;
+	}
+	while (num_locks > 1 && config->max_entries != 0 &&
+		   config->max_entries / num_locks < MYCLIB_HASHMAP_STRIPE_ENTRIES) {
+		/* Tiny per-stripe bounds would evict from a hot stripe while the map is nearly empty */
+		num_locks /= 2;
+	}
+	if (capacity < num_locks) {
+		/* Every stripe must own at least one bucket */
+		capacity = num_locks;
+	}
+	capacity = next_power_two(capacity);
+	if (capacity == 0) {
+		return NULL;
+	}
+
+	hashmap_s *hashmap = cache_aligned_calloc(sizeof(hashmap_s));
+	if (hashmap == NULL) {
+		return NULL;
+	}
+
+	hashmap->backend = config->backend;
+	hashmap->key_type = config->variable ? HM_KEY_BYTES : config->key_type;
+	hashmap->alloc = config->backend == HM_BACKEND_FLAT ? HM_ALLOC_MALLOC : config->alloc;
+	if (config->variable) {
+		hashmap->alloc = HM_ALLOC_POOL;
+	}
+	hashmap->variable = config->variable;
+	hashmap->hash = config->hash;
+	hashmap->equal = config->equal;
+	hashmap->free_key = config->free_key;
+	hashmap->free_value = config->free_value;
+	hashmap->key_size = config->key_size;
+	hashmap->value_size = config->value_size;
+	hashmap->cache = cache;
+	hashmap->eviction = config->eviction;
+	hashmap->ttl_ms = config->ttl_ms;
+
+	atomic_init(&hashmap->size, 0);
+	atomic_init(&hashmap->rehash_left, 0);
+
+	hashmap->num_locks = num_locks;
+	hashmap->lock_bits = log2_pow2(num_locks);
+	/* Rounded down, so that the stripes together never go past max_entries */
+	hashmap->stripe_max = config->max_entries / num_locks;
+	hashmap->locks = cache_aligned_calloc(num_locks * sizeof(hm_stripe_s));
+	if (hashmap->locks == NULL) {
+		cache_aligned_free(hashmap);
+		return NULL;
+	}
+
+	hashmap->lock_mode = config->lock_mode;
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		atomic_init(&hashmap->locks[i].rw, 0);
+#ifdef MYCLIB_HASHMAP_STATS
+		atomic_init(&hashmap->locks[i].acquired, 0);
+		atomic_init(&hashmap->locks[i].contended, 0);
+		atomic_init(&hashmap->locks[i].allocs, 0);
+#endif
+		if (mtx_init(&(hashmap->locks[i].lock), mtx_plain) != thrd_success) {
+			for (size_t j = 0; j < i; ++j) {
+				mtx_destroy(&(hashmap->locks[j].lock));
+			}
+			cache_aligned_free(hashmap->locks);
+			cache_aligned_free(hashmap);
+			return NULL;
+		}
+	}
+
+	bool ok;
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		ok = hm_flat_init(hashmap, capacity);
+	} else {
+		if (hashmap->variable) {
+			/* Variable node: bucket header, key length and inline key, value length and value */
+			hashmap->value_offset =
+				round_up(pool_key_offset(hashmap) + HM_VAR_PREFIX + hashmap->key_size,
+						 HM_VAR_PREFIX) +
+				HM_VAR_PREFIX;
+			hashmap->slot_size =
+				round_up(hashmap->value_offset + hashmap->value_size, _Alignof(max_align_t));
+		} else if (hashmap->alloc == HM_ALLOC_POOL) {
+			/* Pool node: bucket header, then the key, then the value */
+			size_t align = _Alignof(max_align_t);
+			hashmap->value_offset =
+				pool_key_offset(hashmap) + (hashmap->key_size + align - 1) / align * align;
+			hashmap->slot_size =
+				(hashmap->value_offset + hashmap->value_size + align - 1) / align * align;
+		}
+		hashmap->map = calloc(capacity, sizeof(bucket_s *));
+		hashmap->capacity = capacity;
+		hashmap->capacity_bits = log2_pow2(capacity);
+		ok = hashmap->map != NULL;
+	}
+
+	if (!ok) {
+		hm_free(hashmap);
+		return NULL;
+	}
+
+	return hashmap;
+}
+
+hashmap_s *hm_new_bytes(size_t key_size, size_t value_size, size_t capacity) {
+	hm_config_s config = {
+		.key_type = HM_KEY_BYTES,
+		.key_size = key_size,
+		.value_size = value_size,
+		.capacity = capacity,
+	};
+
+	return hm_new_config(&config);
+}
+
+hashmap_s *hm_new_string(size_t key_size, size_t value_size, size_t capacity) {
+	hm_config_s config = {
+		.key_type = HM_KEY_STRING,
+		.key_size = key_size,
+		.value_size = value_size,
+		.capacity = capacity,
+	};
+
+	return hm_new_config(&config);
+}
+
+void hm_free(hashmap_s *hashmap) {
+	if (hashmap == NULL) {
+		return;
+	}
+
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		hm_flat_destroy(hashmap);
+	}
+
+	if (hashmap->map != NULL) {
+		free_all_buckets(hashmap);
+	}
+	free(hashmap->map);
+	free(hashmap->old_map);
+
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		mtx_destroy(&(hashmap->locks[i].lock));
+	}
+	cache_aligned_free(hashmap->locks);
+
+	cache_aligned_free(hashmap);
+}
+
+void hm_free_bucket(bucket_s *bucket) {
+	if (bucket == NULL) {
+		return;
+	}
+
+	free(bucket->key);
+	free(bucket->value);
+	free(bucket);
+}
+
+/*
+ * @brief Account for new entries.
+ *
+ * Must be called with a stripe lock held, the capacity only changes under all of them.
+ * @return true when the chained table went over its load factor.
+ */
+static bool add_size(hashmap_s *hashmap, size_t inserted) {
+	size_t size = atomic_fetch_add(&hashmap->size, inserted) + inserted;
+	return hashmap->backend == HM_BACKEND_CHAINED && over_load_factor(hashmap, size);
+}
+
+/*
+ * @brief Insert a key or update its value in its stripe.
+ *
+ * Must be called with the stripe lock held. The size is left to the caller, see add_size().
+ * @param[in] ttl_ms Lifetime of the entry in cache mode, 0 for forever.
+ * @return 1 if the key was inserted, 0 if its value was updated, -1 on failure.
+ */
+static int set_locked(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash, const void *key,
+					  const void *value, uint64_t ttl_ms) {
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		return hm_flat_set(hashmap, stripe, hash, key, value);
+	}
+
+	bucket_s **link = find_link(hashmap, stripe, hash, key);
+	bucket_s *existing = *link;
+
+	if (existing != NULL) {
+		/* Key exists - update value */
+		if (hashmap->variable) {
+			unsigned char *slot = var_value_slot(hashmap, existing);
+			unsigned char *stored = var_store(stripe, slot, hashmap->value_size, value);
+			if (stored == NULL) {
+				return -1;
+			}
+			if (stored != existing->value) {
+				var_release(stripe, slot, existing->value);
+				existing->value = stored;
+			}
+		} else if (hashmap->alloc == HM_ALLOC_POOL) {
+			memcpy(existing->value, value, hashmap->value_size);
+		} else {
+			void *new_value = malloc(hashmap->value_size);
+			if (new_value == NULL) {
+				return -1;
+			}
+			memcpy(new_value, value, hashmap->value_size);
+
+			/* Free old value and assign new one */
+			if (hashmap->free_value != NULL && existing->value != NULL) {
+				hashmap->free_value(existing->value);
+			} else if (existing->value != NULL) {
+				free(existing->value);
+			}
+			existing->value = new_value;
+		}
+
+		if (hashmap->cache) {
+			hm_cache_node_s *node = (hm_cache_node_s *)existing;
+			node->expires = expiry_time(ttl_ms);
+			cache_touch(hashmap, stripe, node);
+		}
+
+		return 0;
+	}
+
+	if (hashmap->cache) {
+		/* Evicting may unlink buckets of this very chain */
+		cache_make_room(hashmap, stripe);
+		link = find_link(hashmap, stripe, hash, key);
+	}
+
+	/* Key doesn't exist - append a new bucket to the chain */
+	bucket_s *new_bucket = alloc_bucket(hashmap, stripe);
+	if (new_bucket == NULL) {
+		return -1;
+	}
+
+	if (hashmap->variable) {
+		if (!var_init(hashmap, stripe, new_bucket, key, value)) {
+			hm_pool_free(&stripe->pool, new_bucket);
+			return -1;
+		}
+	} else {
+		memcpy(new_bucket->key, key, hashmap->key_size);
+		memcpy(new_bucket->value, value, hashmap->value_size);
+	}
+	new_bucket->next = NULL;
+	new_bucket->hash = hash;
+	*link = new_bucket;
+
+	if (hashmap->cache) {
+		hm_cache_node_s *node = (hm_cache_node_s *)new_bucket;
+		node->expires = expiry_time(ttl_ms);
+		atomic_init(&node->referenced, false);
+		cache_push(stripe, node);
+		stripe->count++;
+	}
+
+	return 1;
+}
+
+/*
+ * @brief Shared body of hm_set(), hm_set_ttl() and hm_set_with_hash().
+ */
+static bool set_entry(hashmap_s *hashmap, uint64_t hash, void *key, void *value,
+					  uint64_t ttl_ms) {
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock(hashmap, stripe)) {
+		return false;
+	}
+
+	bool rehash_done = rehash_step(hashmap, stripe);
+	int stored = set_locked(hashmap, stripe, hash, key, value, ttl_ms);
+	bool need_grow = stored == 1 && add_size(hashmap, 1);
+
+	stripe_unlock(hashmap, stripe);
+
+	if (rehash_done) {
+		release_old_table(hashmap);
+	}
+	if (need_grow) {
+		grow(hashmap);
+	}
+
+	return stored >= 0;
+}
+
+bool hm_set(hashmap_s *hashmap, void *key, void *value) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || value == NULL) {
+		return false;
+	}
+
+	return set_entry(hashmap, hash_key(hashmap, key), key, value, hashmap->ttl_ms);
+}
+
+bool hm_set_ttl(hashmap_s *hashmap, void *key, void *value, uint64_t ttl_ms) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || value == NULL || !hashmap->cache) {
+		return false;
+	}
+
+	return set_entry(hashmap, hash_key(hashmap, key), key, value, ttl_ms);
+}
+
+bool hm_set_with_hash(hashmap_s *hashmap, void *key, void *value, uint64_t hash) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || value == NULL) {
+		return false;
+	}
+
+	return set_entry(hashmap, finish_hash(hashmap->key_type, hash), key, value,
+					 hashmap->ttl_ms);
+}
+
+static bucket_s *get_bucket_copy(bucket_s *from, size_t key_size, size_t value_size) {
+	if (from == NULL) {
+		return NULL;
+	}
+
+	bucket_s *copy = malloc(sizeof(bucket_s));
+	if (copy == NULL) {
+		return NULL;
+	}
+	copy->key = NULL;
+	copy->value = NULL;
+	copy->next = NULL;
+	copy->hash = from->hash;
+
+	if (from->key != NULL) {
+		copy->key = malloc(key_size);
+		if (copy->key == NULL) {
+			free(copy);
+			return NULL;
+		}
+		memcpy(copy->key, from->key, key_size);
+	}
+
+	if (from->value != NULL) {
+		copy->value = malloc(value_size);
+		if (copy->value == NULL) {
+			free(copy->key);
+			free(copy);
+			return NULL;
+		}
+		memcpy(copy->value, from->value, value_size);
+	}
+
+	return copy;
+}
+
+/*
+ * @brief Find a key and expose its stored key/value in place.
+ *
+ * Must be called with the stripe lock taken by stripe_lock_lookup(), since a hit counts as a
+ * use in cache mode. The pointers are valid until the lock is released.
+ * @param[out] entry Filled with borrowed pointers to the stored key and value.
+ * @return true if the key was found.
+ */
+static bool lookup(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash, const void *key,
+				   bucket_s *entry) {
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		unsigned char *slot = hm_flat_find(hashmap, stripe, hash, key);
+		if (slot == NULL) {
+			return false;
+		}
+
+		entry->key = slot;
+		entry->value = slot + hashmap->value_offset;
+		entry->next = NULL;
+		entry->hash = hash;
+		return true;
+	}
+
+	bucket_s *found = *find_link(hashmap, stripe, hash, key);
+	if (found == NULL) {
+		return false;
+	}
+
+	if (hashmap->cache) {
+		uint64_t now = 0;
+		if (expired((hm_cache_node_s *)found, &now)) {
+			return false;
+		}
+
+		/* Unbounded caches never evict, and their readers share the stripe: leave the list */
+		if (hashmap->stripe_max != 0) {
+			cache_touch(hashmap, stripe, (hm_cache_node_s *)found);
+		}
+	}
+
+	*entry = *found;
+	return true;
+}
+
+/*
+ * @brief Shared body of hm_get() and hm_get_with_hash().
+ */
+static bucket_s *get_entry(hashmap_s *hashmap, uint64_t hash, const void *key) {
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock_lookup(hashmap, stripe)) {
+		return NULL;
+	}
+
+	bucket_s entry;
+	bucket_s *copy = NULL;
+	if (lookup(hashmap, stripe, hash, key, &entry)) {
+		copy = get_bucket_copy(&entry, hashmap->key_size, hashmap->value_size);
+	}
+
+	stripe_unlock_lookup(hashmap, stripe);
+	return copy;
+}
+
+bucket_s *hm_get(hashmap_s *hashmap, void *key) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
+		return NULL;
+	}
+
+	return get_entry(hashmap, hash_key(hashmap, key), key);
+}
+
+bucket_s *hm_get_with_hash(hashmap_s *hashmap, void *key, uint64_t hash) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
 		return NULL;
 	}
 
-	/* Lock all mutexes */
+	return get_entry(hashmap, finish_hash(hashmap->key_type, hash), key);
+}
+
+/*
+ * @brief Shared body of hm_get_value() and hm_get_value_with_hash().
+ */
+static bool get_value(hashmap_s *hashmap, uint64_t hash, const void *key, void *value) {
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock_lookup(hashmap, stripe)) {
+		return false;
+	}
+
+	bucket_s entry;
+	bool found = lookup(hashmap, stripe, hash, key, &entry);
+	if (found) {
+		memcpy(value, entry.value, hashmap->value_size);
+	}
+
+	stripe_unlock_lookup(hashmap, stripe);
+	return found;
+}
+
+bool hm_get_value(hashmap_s *hashmap, const void *key, void *value) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || value == NULL) {
+		return false;
+	}
+
+	return get_value(hashmap, hash_key(hashmap, key), key, value);
+}
+
+bool hm_get_value_with_hash(hashmap_s *hashmap, const void *key, void *value, uint64_t hash) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || value == NULL) {
+		return false;
+	}
+
+	return get_value(hashmap, finish_hash(hashmap->key_type, hash), key, value);
+}
+
+bool hm_peek(hashmap_s *hashmap, const void *key, hm_visit_f *callback, void *arg) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
+		return false;
+	}
+
+	uint64_t hash = hash_key(hashmap, key);
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock_lookup(hashmap, stripe)) {
+		return false;
+	}
+
+	bucket_s entry;
+	bool found = lookup(hashmap, stripe, hash, key, &entry);
+	if (found && callback != NULL) {
+		callback(entry.key, entry.value, arg);
+	}
+
+	stripe_unlock_lookup(hashmap, stripe);
+	return found;
+}
+
+/*
+ * @brief Operation of in_place() on the stored value of a key, returns the result of the call.
+ */
+typedef bool in_place_f(hashmap_s *hashmap, const void *key, void *value, bool inserted,
+						void *arg);
+
+/*
+ * @brief Run an operation on the stored value of a key, with its stripe locked exclusively.
+ *
+ * A missing key is first inserted with a copy of init, unless init is NULL.
+ * @return The result of op, false if the key was missing or could not be inserted.
+ */
+static bool in_place(hashmap_s *hashmap, const void *key, const void *init, in_place_f *op,
+					 void *arg) {
+	uint64_t hash = hash_key(hashmap, key);
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock(hashmap, stripe)) {
+		return false;
+	}
+
+	bool rehash_done = rehash_step(hashmap, stripe);
+	bool need_grow = false;
+	bool inserted = false;
+
+	bucket_s entry;
+	bool found = lookup(hashmap, stripe, hash, key, &entry);
+	if (!found && init != NULL) {
+		/* An expired entry of the key is overwritten rather than inserted */
+		int stored = set_locked(hashmap, stripe, hash, key, init, hashmap->ttl_ms);
+		need_grow = stored == 1 && add_size(hashmap, 1);
+		inserted = stored >= 0;
+		found = inserted && lookup(hashmap, stripe, hash, key, &entry);
+	}
+
+	bool result = found && op(hashmap, entry.key, entry.value, inserted, arg);
+
+	stripe_unlock(hashmap, stripe);
+
+	if (rehash_done) {
+		release_old_table(hashmap);
+	}
+	if (need_grow) {
+		grow(hashmap);
+	}
+
+	return result;
+}
+
+struct update_arg {
+	hm_update_f *callback;
+	void *arg;
+};
+
+static bool update_op(hashmap_s *hashmap, const void *key, void *value, bool inserted,
+					  void *arg) {
+	(void)hashmap;
+	struct update_arg *ua = arg;
+	ua->callback(key, value, inserted, ua->arg);
+	return true;
+}
+
+bool hm_compute(hashmap_s *hashmap, const void *key, hm_update_f *callback, void *arg) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || callback == NULL) {
+		return false;
+	}
+
+	struct update_arg ua = {.callback = callback, .arg = arg};
+	return in_place(hashmap, key, NULL, update_op, &ua);
+}
+
+bool hm_upsert(hashmap_s *hashmap, const void *key, const void *init, hm_update_f *callback,
+			   void *arg) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || init == NULL || callback == NULL) {
+		return false;
+	}
+
+	struct update_arg ua = {.callback = callback, .arg = arg};
+	return in_place(hashmap, key, init, update_op, &ua);
+}
+
+struct get_or_insert_arg {
+	void *out;
+	bool *inserted;
+};
+
+static bool get_or_insert_op(hashmap_s *hashmap, const void *key, void *value, bool inserted,
+							 void *arg) {
+	(void)key;
+	struct get_or_insert_arg *ga = arg;
+	if (ga->out != NULL) {
+		memcpy(ga->out, value, hashmap->value_size);
+	}
+	if (ga->inserted != NULL) {
+		*ga->inserted = inserted;
+	}
+	return true;
+}
+
+bool hm_get_or_insert(hashmap_s *hashmap, const void *key, const void *value, void *out,
+					  bool *inserted) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || value == NULL) {
+		return false;
+	}
+
+	struct get_or_insert_arg ga = {.out = out, .inserted = inserted};
+	return in_place(hashmap, key, value, get_or_insert_op, &ga);
+}
+
+struct cas_arg {
+	void *expected;
+	const void *desired;
+};
+
+static bool cas_op(hashmap_s *hashmap, const void *key, void *value, bool inserted, void *arg) {
+	(void)key;
+	(void)inserted;
+	struct cas_arg *ca = arg;
+	if (memcmp(value, ca->expected, hashmap->value_size) != 0) {
+		memcpy(ca->expected, value, hashmap->value_size);
+		return false;
+	}
+
+	memcpy(value, ca->desired, hashmap->value_size);
+	return true;
+}
+
+bool hm_cas(hashmap_s *hashmap, const void *key, void *expected, const void *desired) {
+	if (hashmap == NULL || hashmap->variable || key == NULL || expected == NULL ||
+		desired == NULL) {
+		return false;
+	}
+
+	struct cas_arg ca = {.expected = expected, .desired = desired};
+	return in_place(hashmap, key, NULL, cas_op, &ca);
+}
+
+/**< Batch size handled without allocating */
+#define BATCH_STACK 64
+
+struct batch_entry {
+	uint64_t hash;
+	size_t index; /**< Position of the key in the caller's batch */
+};
+
+/*
+ * @brief A batch of keys grouped by stripe.
+ */
+struct batch {
+	struct batch_entry *entries; /**< Entries grouped by stripe */
+	size_t *ends;				 /**< End of each stripe's run of entries */
+	void *heap;					 /**< Allocation backing both, NULL if on the stack */
+	struct batch_entry stack_entries[2 * BATCH_STACK];
+	size_t stack_ends[MYCLIB_HASHMAP_LOCKS];
+};
+
+/*
+ * @brief Hash a batch of packed keys and group it by stripe.
+ *
+ * Counting sort on the stripe index: linear, and stable so equal keys keep their batch order.
+ * @return false on allocation failure.
+ */
+static bool batch_prepare(hashmap_s *hashmap, const unsigned char *keys, size_t count,
+						  struct batch *batch) {
+	if (count <= BATCH_STACK && hashmap->num_locks <= MYCLIB_HASHMAP_LOCKS) {
+		batch->entries = batch->stack_entries;
+		batch->ends = batch->stack_ends;
+		batch->heap = NULL;
+	} else {
+		if (count > (SIZE_MAX / 2 - hashmap->num_locks * sizeof(size_t)) /
+						sizeof(struct batch_entry)) {
+			return false;
+		}
+		batch->heap = malloc(2 * count * sizeof(struct batch_entry) +
+							 hashmap->num_locks * sizeof(size_t));
+		if (batch->heap == NULL) {
+			return false;
+		}
+		batch->entries = batch->heap;
+		batch->ends = (size_t *)(batch->entries + 2 * count);
+	}
+
+	/* Hash into the second half, then scatter into the first one */
+	struct batch_entry *hashed = batch->entries + count;
+	size_t *ends = batch->ends;
+	memset(ends, 0, hashmap->num_locks * sizeof(size_t));
+
+	for (size_t i = 0; i < count; ++i) {
+		hashed[i].hash = hash_key(hashmap, keys + i * hashmap->key_size);
+		hashed[i].index = i;
+		ends[hash_index(hashed[i].hash, hashmap->lock_bits)]++;
+	}
+
+	size_t start = 0;
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		size_t n = ends[i];
+		ends[i] = start;
+		start += n;
+	}
+
+	/* Each ends[i] moves from the start to the end of its stripe's run */
+	for (size_t i = 0; i < count; ++i) {
+		batch->entries[ends[hash_index(hashed[i].hash, hashmap->lock_bits)]++] = hashed[i];
+	}
+
+	return true;
+}
+
+/*
+ * @brief Prefetch the memory a group of entries is about to probe.
+ *
+ * Every address of the group is requested before the first probe, so the cache misses overlap
+ * instead of being paid one after the other. Must be called with the stripe lock held.
+ */
+static void prefetch_group(hashmap_s *hashmap, hm_stripe_s *stripe,
+						   const struct batch_entry *entries, size_t count) {
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		for (size_t i = 0; i < count; ++i) {
+			hm_flat_prefetch(hashmap, stripe, entries[i].hash);
+		}
+		return;
+	}
+
+	/* Chain heads first, then the first bucket of each chain once its head has arrived */
+	for (size_t i = 0; i < count; ++i) {
+		HM_PREFETCH(get_chain(hashmap, stripe, entries[i].hash));
+	}
+	for (size_t i = 0; i < count; ++i) {
+		bucket_s *head = *get_chain(hashmap, stripe, entries[i].hash);
+		if (head != NULL) {
+			HM_PREFETCH(head);
+		}
+	}
+}
+
+/*
+ * @brief Prefetch the bucket array slots of the entries that follow the current group.
+ *
+ * Unlike prefetch_group() this can look past the current stripe: the bucket array only changes
+ * with every stripe lock held, so holding any one of them is enough to compute the addresses.
+ */
+static void prefetch_ahead(hashmap_s *hashmap, const struct batch_entry *entries, size_t from,
+						   size_t count) {
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		return;
+	}
+
+	size_t to = count - from > MYCLIB_HASHMAP_PREFETCH_GROUP ? from + MYCLIB_HASHMAP_PREFETCH_GROUP
+															  : count;
+	for (size_t i = from; i < to; ++i) {
+		HM_PREFETCH(&hashmap->map[hash_index(entries[i].hash, hashmap->capacity_bits)]);
+	}
+}
+
+size_t hm_get_many(hashmap_s *hashmap, const void *keys, size_t count, void *values,
+				   bool *found) {
+	if (hashmap == NULL || hashmap->variable || count == 0 || keys == NULL || values == NULL) {
+		return 0;
+	}
+
+	struct batch batch;
+	if (!batch_prepare(hashmap, keys, count, &batch)) {
+		return 0;
+	}
+
+	const unsigned char *key_bytes = keys;
+	unsigned char *value_bytes = values;
+	size_t hits = 0;
+
+	struct batch_entry *entries = batch.entries;
+	for (size_t s = 0, start = 0; s < hashmap->num_locks; start = batch.ends[s++]) {
+		size_t end = batch.ends[s];
+		if (start == end) {
+			continue;
+		}
+
+		hm_stripe_s *stripe = &hashmap->locks[s];
+		bool locked = stripe_lock_lookup(hashmap, stripe);
+
+		for (size_t group = start; group < end; group += MYCLIB_HASHMAP_PREFETCH_GROUP) {
+			size_t group_end = end - group > MYCLIB_HASHMAP_PREFETCH_GROUP
+								   ? group + MYCLIB_HASHMAP_PREFETCH_GROUP
+								   : end;
+			if (locked) {
+				prefetch_group(hashmap, stripe, entries + group, group_end - group);
+				prefetch_ahead(hashmap, entries, group_end, count);
+			}
+
+			for (size_t i = group; i < group_end; ++i) {
+				size_t index = entries[i].index;
+				bucket_s entry;
+				bool hit = locked && lookup(hashmap, stripe, entries[i].hash,
+											 key_bytes + index * hashmap->key_size, &entry);
+				if (hit) {
+					memcpy(value_bytes + index * hashmap->value_size, entry.value,
+						   hashmap->value_size);
+					hits++;
+				}
+				if (found != NULL) {
+					found[index] = hit;
+				}
+			}
+		}
+
+		if (locked) {
+			stripe_unlock_lookup(hashmap, stripe);
+		}
+	}
+
+	free(batch.heap);
+
+	return hits;
+}
+
+size_t hm_set_many(hashmap_s *hashmap, const void *keys, const void *values, size_t count) {
+	if (hashmap == NULL || hashmap->variable || count == 0 || keys == NULL || values == NULL) {
+		return 0;
+	}
+
+	struct batch batch;
+	if (!batch_prepare(hashmap, keys, count, &batch)) {
+		return 0;
+	}
+
+	const unsigned char *key_bytes = keys;
+	const unsigned char *value_bytes = values;
+	size_t stored = 0;
+
+	struct batch_entry *entries = batch.entries;
+	for (size_t s = 0, start = 0; s < hashmap->num_locks; start = batch.ends[s++]) {
+		size_t end = batch.ends[s];
+		if (start == end) {
+			continue;
+		}
+
+		hm_stripe_s *stripe = &hashmap->locks[s];
+		if (!stripe_lock(hashmap, stripe)) {
+			continue;
+		}
+
+		bool rehash_done = false;
+		size_t inserted = 0;
+
+		for (size_t group = start; group < end; group += MYCLIB_HASHMAP_PREFETCH_GROUP) {
+			size_t group_end = end - group > MYCLIB_HASHMAP_PREFETCH_GROUP
+								   ? group + MYCLIB_HASHMAP_PREFETCH_GROUP
+								   : end;
+			prefetch_group(hashmap, stripe, entries + group, group_end - group);
+			prefetch_ahead(hashmap, entries, group_end, count);
+
+			for (size_t i = group; i < group_end; ++i) {
+				size_t index = entries[i].index;
+
+				/* Keep migrating at the pace of single writes */
+				if (rehash_step(hashmap, stripe)) {
+					rehash_done = true;
+				}
+				int res = set_locked(hashmap, stripe, entries[i].hash,
+									 key_bytes + index * hashmap->key_size,
+									 value_bytes + index * hashmap->value_size, hashmap->ttl_ms);
+				stored += res >= 0;
+				inserted += res == 1;
+			}
+		}
+
+		bool need_grow = inserted > 0 && add_size(hashmap, inserted);
+		stripe_unlock(hashmap, stripe);
+
+		if (rehash_done) {
+			release_old_table(hashmap);
+		}
+		if (need_grow) {
+			grow(hashmap);
+		}
+	}
+
+	free(batch.heap);
+
+	return stored;
+}
+
+/*
+ * @brief Work of one hm_bulk_load() thread.
+ *
+ * The input is cut into one slice per worker for hashing, and the stripes into one contiguous
+ * range per worker for inserting.
+ */
+struct bulk_worker {
+	hashmap_s *hashmap;
+	const unsigned char *keys;
+	const unsigned char *values;
+	struct batch_entry *hashed; /**< Hashes in input order */
+	struct batch_entry *sorted; /**< Hashes grouped by stripe */
+	size_t *ends;				/**< End of each stripe's run in sorted, once scattered */
+	size_t *offsets;			/**< Per stripe: count, then next position of this slice */
+	size_t first;				/**< First input entry of the slice */
+	size_t last;				/**< End of the slice */
+	size_t first_stripe;		/**< First stripe to insert */
+	size_t last_stripe;			/**< End of the stripe range */
+	size_t stored;				/**< Pairs stored */
+	size_t inserted;			/**< New keys */
+};
+
+static int bulk_hash(void *arg) {
+	struct bulk_worker *w = arg;
+	hashmap_s *hashmap = w->hashmap;
+
+	for (size_t i = w->first; i < w->last; ++i) {
+		uint64_t hash = hash_key(hashmap, w->keys + i * hashmap->key_size);
+		w->hashed[i] = (struct batch_entry){.hash = hash, .index = i};
+		w->offsets[hash_index(hash, hashmap->lock_bits)]++;
+	}
+
+	return 0;
+}
+
+static int bulk_scatter(void *arg) {
+	struct bulk_worker *w = arg;
+
+	for (size_t i = w->first; i < w->last; ++i) {
+		w->sorted[w->offsets[hash_index(w->hashed[i].hash, w->hashmap->lock_bits)]++] =
+			w->hashed[i];
+	}
+
+	return 0;
+}
+
+static int bulk_insert(void *arg) {
+	struct bulk_worker *w = arg;
+	hashmap_s *hashmap = w->hashmap;
+
+	for (size_t s = w->first_stripe; s < w->last_stripe; ++s) {
+		size_t start = s == 0 ? 0 : w->ends[s - 1];
+		size_t end = w->ends[s];
+		hm_stripe_s *stripe = &hashmap->locks[s];
+
+		if (hashmap->backend == HM_BACKEND_FLAT) {
+			hm_flat_reserve(hashmap, stripe, stripe->segment.count + (end - start));
+		}
+
+		for (size_t group = start; group < end; group += MYCLIB_HASHMAP_PREFETCH_GROUP) {
+			size_t group_end = end - group > MYCLIB_HASHMAP_PREFETCH_GROUP
+								   ? group + MYCLIB_HASHMAP_PREFETCH_GROUP
+								   : end;
+			prefetch_group(hashmap, stripe, w->sorted + group, group_end - group);
+
+			for (size_t i = group; i < group_end; ++i) {
+				size_t index = w->sorted[i].index;
+				int res = set_locked(hashmap, stripe, w->sorted[i].hash,
+									 w->keys + index * hashmap->key_size,
+									 w->values + index * hashmap->value_size, hashmap->ttl_ms);
+				w->stored += res >= 0;
+				w->inserted += res == 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * @brief Run fn on every worker, the first one on the calling thread.
+ *
+ * A worker whose thread cannot be started runs on the calling thread as well.
+ */
+static void bulk_run(struct bulk_worker *workers, size_t num_workers, thrd_start_t fn) {
+	thrd_t threads[MYCLIB_HASHMAP_LOCKS];
+	bool started[MYCLIB_HASHMAP_LOCKS];
+
+	for (size_t t = 1; t < num_workers; ++t) {
+		started[t] = thrd_create(&threads[t], fn, &workers[t]) == thrd_success;
+		if (!started[t]) {
+			fn(&workers[t]);
+		}
+	}
+
+	fn(&workers[0]);
+
+	for (size_t t = 1; t < num_workers; ++t) {
+		if (started[t]) {
+			thrd_join(threads[t], NULL);
+		}
+	}
+}
+
+size_t hm_bulk_load(hashmap_s *hashmap, const void *keys, const void *values, size_t count,
+					size_t num_threads) {
+	if (hashmap == NULL || hashmap->variable || count == 0 || keys == NULL || values == NULL) {
+		return 0;
+	}
+
+	if (num_threads == 0) {
+		num_threads = MYCLIB_HASHMAP_BULK_THREADS;
+	}
+	/* Stripes are the unit of work, and tiny loads are not worth a thread */
+	size_t num_workers = num_threads < hashmap->num_locks ? num_threads : hashmap->num_locks;
+	if (num_workers > MYCLIB_HASHMAP_LOCKS) {
+		num_workers = MYCLIB_HASHMAP_LOCKS;
+	}
+	if (num_workers > count / MYCLIB_HASHMAP_BULK_MIN + 1) {
+		num_workers = count / MYCLIB_HASHMAP_BULK_MIN + 1;
+	}
+
+	size_t num_locks = hashmap->num_locks;
+	if (count > SIZE_MAX / 2 / sizeof(struct batch_entry) ||
+		num_workers + 1 > SIZE_MAX / num_locks / sizeof(size_t)) {
+		return 0;
+	}
+
+	struct batch_entry *entries = malloc(2 * count * sizeof(struct batch_entry));
+	size_t *offsets = calloc((num_workers + 1) * num_locks, sizeof(size_t));
+	if (entries == NULL || offsets == NULL) {
+		free(entries);
+		free(offsets);
+		return 0;
+	}
+
+	struct bulk_worker workers[MYCLIB_HASHMAP_LOCKS];
+	for (size_t t = 0; t < num_workers; ++t) {
+		workers[t] = (struct bulk_worker){
+			.hashmap = hashmap,
+			.keys = keys,
+			.values = values,
+			.hashed = entries + count,
+			.sorted = entries,
+			.ends = offsets + num_workers * num_locks,
+			.offsets = offsets + t * num_locks,
+			.first = count / num_workers * t,
+			.last = t + 1 == num_workers ? count : count / num_workers * (t + 1),
+		};
+	}
+
+	/* Hash in parallel, then turn the per-slice counts into scatter positions. Slices keep
+	   their input order within a stripe, so the last pair of a repeated key still wins. */
+	bulk_run(workers, num_workers, bulk_hash);
+
+	size_t *ends = workers[0].ends;
+	size_t position = 0;
+	for (size_t s = 0; s < num_locks; ++s) {
+		for (size_t t = 0; t < num_workers; ++t) {
+			size_t n = workers[t].offsets[s];
+			workers[t].offsets[s] = position;
+			position += n;
+		}
+		ends[s] = position;
+	}
+
+	bulk_run(workers, num_workers, bulk_scatter);
+
+	/* Split the stripes into ranges of about the same number of pairs */
+	size_t stripe = 0;
+	for (size_t t = 0; t < num_workers; ++t) {
+		size_t target = count / num_workers * (t + 1);
+		workers[t].first_stripe = stripe;
+		while (stripe < num_locks && (t + 1 == num_workers || ends[stripe] <= target)) {
+			stripe++;
+		}
+		workers[t].last_stripe = stripe;
+	}
+
+	/* The calling thread owns every stripe, the workers insert without locking */
+	lock_all(hashmap);
+
+	if (hashmap->backend == HM_BACKEND_CHAINED) {
+		reserve_table(hashmap, atomic_load(&hashmap->size) + count);
+	}
+
+	bulk_run(workers, num_workers, bulk_insert);
+
+	size_t stored = 0;
+	size_t inserted = 0;
+	for (size_t t = 0; t < num_workers; ++t) {
+		stored += workers[t].stored;
+		inserted += workers[t].inserted;
+	}
+	bool need_grow = add_size(hashmap, inserted);
+
+	unlock_all(hashmap);
+
+	/* Only if reserving the table failed */
+	if (need_grow) {
+		grow(hashmap);
+	}
+
+	free(entries);
+	free(offsets);
+
+	return stored;
+}
+
+/*
+ * @brief Shared body of hm_remove() and hm_remove_with_hash().
+ */
+static bool remove_entry(hashmap_s *hashmap, uint64_t hash, const void *key) {
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock(hashmap, stripe)) {
+		return false;
+	}
+
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		bool removed = hm_flat_remove(hashmap, stripe, hash, key);
+		if (removed) {
+			atomic_fetch_sub(&hashmap->size, 1);
+		}
+
+		stripe_unlock(hashmap, stripe);
+		return removed;
+	}
+
+	bool rehash_done = rehash_step(hashmap, stripe);
+
+	bucket_s **link = find_link(hashmap, stripe, hash, key);
+	bucket_s *to_remove = *link;
+
+	/* An expired entry is reclaimed all the same, but was already gone for the caller */
+	bool removed = false;
+	if (to_remove != NULL) {
+		*link = to_remove->next;
+		removed = true;
+		if (hashmap->cache) {
+			uint64_t now = 0;
+			removed = !expired((hm_cache_node_s *)to_remove, &now);
+			cache_unlink(stripe, (hm_cache_node_s *)to_remove);
+			stripe->count--;
+		}
+		free_bucket(hashmap, stripe, to_remove);
+
+		atomic_fetch_sub(&hashmap->size, 1);
+	}
+
+	stripe_unlock(hashmap, stripe);
+
+	if (rehash_done) {
+		release_old_table(hashmap);
+	}
+
+	return removed;
+}
+
+bool hm_remove(hashmap_s *hashmap, void *key) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
+		return false;
+	}
+
+	return remove_entry(hashmap, hash_key(hashmap, key), key);
+}
+
+bool hm_remove_with_hash(hashmap_s *hashmap, void *key, uint64_t hash) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
+		return false;
+	}
+
+	return remove_entry(hashmap, finish_hash(hashmap->key_type, hash), key);
+}
+
+bool hm_set_var(hashmap_s *hashmap, const void *key, size_t key_len, const void *value,
+				size_t value_len) {
+	if (hashmap == NULL || !hashmap->variable || key == NULL || (value == NULL && value_len != 0) ||
+		key_len > UINT32_MAX || value_len > UINT32_MAX) {
+		return false;
+	}
+
+	hm_blob_s key_blob = {.data = key, .len = key_len};
+	hm_blob_s value_blob = {.data = value, .len = value_len};
+
+	return set_entry(hashmap, hm_hash_bytes(key, key_len, 0), &key_blob, &value_blob,
+					 hashmap->ttl_ms);
+}
+
+bool hm_get_var(hashmap_s *hashmap, const void *key, size_t key_len, void *value,
+				size_t *value_len) {
+	if (hashmap == NULL || !hashmap->variable || key == NULL ||
+		(value != NULL && value_len == NULL)) {
+		return false;
+	}
+
+	hm_blob_s key_blob = {.data = key, .len = key_len};
+	uint64_t hash = hm_hash_bytes(key, key_len, 0);
+	hm_stripe_s *stripe = get_stripe(hashmap, hash);
+
+	if (!stripe_lock_lookup(hashmap, stripe)) {
+		return false;
+	}
+
+	bucket_s entry;
+	bool found = lookup(hashmap, stripe, hash, &key_blob, &entry);
+	if (found && value_len != NULL) {
+		size_t len = var_len(entry.value);
+		if (value != NULL && len != 0) {
+			memcpy(value, entry.value, len < *value_len ? len : *value_len);
+		}
+		*value_len = len;
+	}
+
+	stripe_unlock_lookup(hashmap, stripe);
+	return found;
+}
+
+bool hm_remove_var(hashmap_s *hashmap, const void *key, size_t key_len) {
+	if (hashmap == NULL || !hashmap->variable || key == NULL) {
+		return false;
+	}
+
+	hm_blob_s key_blob = {.data = key, .len = key_len};
+
+	return remove_entry(hashmap, hm_hash_bytes(key, key_len, 0), &key_blob);
+}
+
+size_t hm_var_len(const void *data) {
+	if (data == NULL) {
+		return 0;
+	}
+
+	return var_len(data);
+}
+
+uint64_t hm_hash(hashmap_s *hashmap, const void *key) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
+		return 0;
+	}
+
+	return user_hash_typed(hashmap->key_type, hashmap->hash, hashmap->key_size, key);
+}
+
+size_t hm_expire(hashmap_s *hashmap) {
+	if (hashmap == NULL || !hashmap->cache) {
+		return 0;
+	}
+
+	size_t removed = 0;
+	uint64_t now = now_ms();
+
 	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_lock(&hashmap->locks[i]);
+		hm_stripe_s *stripe = &hashmap->locks[i];
+		if (!stripe_lock(hashmap, stripe)) {
+			continue;
+		}
+
+		hm_cache_node_s *node = stripe->oldest;
+		while (node != NULL) {
+			hm_cache_node_s *newer = node->newer;
+			if (expired(node, &now)) {
+				cache_remove(hashmap, stripe, node);
+				removed++;
+			}
+			node = newer;
+		}
+
+		stripe_unlock(hashmap, stripe);
 	}
 
-	size_t size = atomic_load(&hashmap->size);
-	*count = 0;
+	return removed;
+}
+
+size_t hm_size(hashmap_s *hashmap) {
+	if (hashmap == NULL) {
+		return 0;
+	}
+
+	return atomic_load(&hashmap->size);
+}
+
+/*
+ * @brief Add the chains of a table to the probe lengths, and its non-empty buckets if asked.
+ */
+static void chain_stats(bucket_s **table, size_t capacity, bool primary, hm_stats_s *stats) {
+	for (size_t i = 0; i < capacity && table != NULL; ++i) {
+		size_t probe = 0;
+		for (bucket_s *bucket = table[i]; bucket != NULL; bucket = bucket->next) {
+			stats_add_probe(stats, ++probe);
+		}
+		stats->used_buckets += primary && probe != 0;
+	}
+}
+
+bool hm_stats(hashmap_s *hashmap, hm_stats_s *stats, hm_stripe_stats_s *stripes) {
+	if (hashmap == NULL || stats == NULL) {
+		return false;
+	}
+
+	*stats = (hm_stats_s){.num_stripes = hashmap->num_locks};
+
+	lock_all(hashmap);
 
-	if (size == 0) {
+	if (hashmap->backend == HM_BACKEND_FLAT) {
 		for (size_t i = 0; i < hashmap->num_locks; ++i) {
-			mtx_unlock(&hashmap->locks[i]);
+			hm_flat_stats(&hashmap->locks[i], stats);
 		}
-		return NULL;
+	} else {
+		stats->capacity = hashmap->capacity;
+		chain_stats(hashmap->map, hashmap->capacity, true, stats);
+		chain_stats(hashmap->old_map, hashmap->old_capacity, false, stats);
+	}
+	stats->size = atomic_load(&hashmap->size);
+
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		hm_stripe_stats_s counters = {0};
+#ifdef MYCLIB_HASHMAP_STATS
+		hm_stripe_s *stripe = &hashmap->locks[i];
+		counters.acquired = atomic_load_explicit(&stripe->acquired, memory_order_relaxed);
+		counters.contended = atomic_load_explicit(&stripe->contended, memory_order_relaxed);
+		counters.allocs = atomic_load_explicit(&stripe->allocs, memory_order_relaxed);
+#endif
+		stats->total.acquired += counters.acquired;
+		stats->total.contended += counters.contended;
+		stats->total.allocs += counters.allocs;
+		if (stripes != NULL) {
+			stripes[i] = counters;
+		}
+	}
+
+	unlock_all(hashmap);
+
+	if (stats->capacity != 0) {
+		stats->load_factor = (double)stats->size / (double)stats->capacity;
+	}
+
+	return true;
+}
+
+bool hm_contains(hashmap_s *hashmap, void *key) {
+	if (hashmap == NULL || hashmap->variable || key == NULL) {
+		return false;
 	}
 
-	/* Allocate array for key pointers */
-	void **keys = malloc(sizeof(void *) * size);
-	if (keys == NULL) {
+	return hm_peek(hashmap, key, NULL, NULL);
+}
+
+void hm_walk_all(hashmap_s *hashmap, hm_walk_f *fn, void *arg) {
+	if (hashmap->backend == HM_BACKEND_FLAT) {
 		for (size_t i = 0; i < hashmap->num_locks; ++i) {
-			mtx_unlock(&hashmap->locks[i]);
+			if (!hm_flat_walk(hashmap, &hashmap->locks[i], fn, arg)) {
+				return;
+			}
 		}
-		return NULL;
+		return;
 	}
 
-	size_t index = 0;
+	bucket_s **tables[] = {hashmap->old_map, hashmap->map};
+	size_t capacities[] = {hashmap->old_capacity, hashmap->capacity};
+	uint64_t now = 0;
 
-	/* Iterate through all buckets */
-	for (size_t i = 0; i < MYCLIB_HASHMAP_SIZE && index < size; ++i) {
-		bucket_s *bucket = &hashmap->map[i];
+	for (size_t t = 0; t < 2; ++t) {
+		if (tables[t] == NULL) {
+			continue;
+		}
 
-		if (bucket->key != NULL) {
-			keys[index] = malloc(hashmap->key_size);
-			if (keys[index] == NULL) {
-				/* Cleanup on failure */
-				for (size_t j = 0; j < index; ++j) {
-					if (hashmap->free_key != NULL) {
-						hashmap->free_key(keys[j]);
-					} else {
-						free(keys[j]);
-					}
+		for (size_t i = 0; i < capacities[t]; ++i) {
+			for (bucket_s *bucket = tables[t][i]; bucket != NULL; bucket = bucket->next) {
+				if (entry_live(hashmap, bucket, &now) && !fn(bucket, arg)) {
+					return;
 				}
-				free(keys);
-				for (size_t j = 0; j < hashmap->num_locks; ++j) {
-					mtx_unlock(&hashmap->locks[j]);
-				}
-				return NULL;
 			}
-			memcpy(keys[index], bucket->key, hashmap->key_size);
-			index++;
-		}
-
-		/* Iterate through chain */
-		bucket = bucket->next;
-		while (bucket != NULL && index < size) {
-			keys[index] = malloc(hashmap->key_size);
-			if (keys[index] == NULL) {
-				/* Cleanup on failure */
-				for (size_t j = 0; j < index; ++j) {
-					if (hashmap->free_key != NULL) {
-						hashmap->free_key(keys[j]);
-					} else {
-						free(keys[j]);
-					}
-				}
-				free(keys);
-				for (size_t j = 0; j < hashmap->num_locks; ++j) {
-					mtx_unlock(&hashmap->locks[j]);
-				}
+		}
+	}
+}
+
+/*
+ * @brief Position a cursor at the start of its stripe. The stripe lock must be held.
+ */
+static void cursor_enter(hm_cursor_s *cursor) {
+	hashmap_s *hashmap = cursor->hashmap;
+
+	cursor->next = NULL;
+	cursor->old_table = hashmap->old_map != NULL;
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		cursor->index = 0;
+	} else if (cursor->old_table) {
+		cursor->index = stripe_first_bucket(hashmap, cursor->stripe, hashmap->old_capacity_bits);
+	} else {
+		cursor->index = stripe_first_bucket(hashmap, cursor->stripe, hashmap->capacity_bits);
+	}
+}
+
+/*
+ * @brief Next entry of the cursor's stripe in both chained tables, NULL once it is exhausted.
+ */
+static bucket_s *cursor_chained_next(hm_cursor_s *cursor) {
+	hashmap_s *hashmap = cursor->hashmap;
+
+	while (cursor->next == NULL) {
+		bucket_s **table = cursor->old_table ? hashmap->old_map : hashmap->map;
+		unsigned int bits = cursor->old_table ? hashmap->old_capacity_bits : hashmap->capacity_bits;
+
+		if (cursor->index == stripe_first_bucket(hashmap, cursor->stripe + 1, bits)) {
+			if (!cursor->old_table) {
 				return NULL;
 			}
-			memcpy(keys[index], bucket->key, hashmap->key_size);
-			index++;
-			bucket = bucket->next;
+			cursor->old_table = false;
+			cursor->index = stripe_first_bucket(hashmap, cursor->stripe, hashmap->capacity_bits);
+			continue;
 		}
+
+		cursor->next = table[cursor->index++];
 	}
 
-	*count = index;
+	bucket_s *bucket = cursor->next;
+	cursor->next = bucket->next;
+	return bucket;
+}
 
-	/* Unlock all mutexes */
-	for (size_t i = 0; i < hashmap->num_locks; ++i) {
-		mtx_unlock(&hashmap->locks[i]);
+/*
+ * @brief Next live entry of the cursor's stripe, skipping expired ones in cache mode.
+ */
+static bucket_s *cursor_live_next(hm_cursor_s *cursor) {
+	uint64_t now = 0;
+	bucket_s *bucket = cursor_chained_next(cursor);
+
+	while (bucket != NULL && !entry_live(cursor->hashmap, bucket, &now)) {
+		bucket = cursor_chained_next(cursor);
 	}
 
-	return keys;
+	return bucket;
 }
 
-void hm_free_keys(hashmap_s *hashmap, void **keys, size_t count) {
-	if (keys == NULL) {
+void hm_cursor_init(hm_cursor_s *cursor, hashmap_s *hashmap) {
+	if (cursor == NULL) {
 		return;
 	}
 
-	for (size_t i = 0; i < count; ++i) {
-		if (keys[i] != NULL) {
-			if (hashmap != NULL && hashmap->free_key != NULL) {
-				hashmap->free_key(keys[i]);
-			} else {
-				free(keys[i]);
+	*cursor = (hm_cursor_s){
+		.hashmap = hashmap,
+		.stripe = 0,
+		.locked = false,
+	};
+}
+
+bucket_s *hm_cursor_next(hm_cursor_s *cursor) {
+	if (cursor == NULL || cursor->hashmap == NULL) {
+		return NULL;
+	}
+
+	hashmap_s *hashmap = cursor->hashmap;
+
+	while (cursor->stripe < hashmap->num_locks) {
+		hm_stripe_s *stripe = &hashmap->locks[cursor->stripe];
+
+		if (!cursor->locked) {
+			if (!stripe_lock_shared(hashmap, stripe)) {
+				cursor->stripe = hashmap->num_locks;
+				return NULL;
 			}
+			cursor->locked = true;
+			cursor_enter(cursor);
+		}
+
+		bucket_s *bucket;
+		if (hashmap->backend == HM_BACKEND_FLAT) {
+			bucket = hm_flat_next(hashmap, stripe, &cursor->index, &cursor->view);
+		} else {
+			bucket = cursor_live_next(cursor);
+		}
+		if (bucket != NULL) {
+			return bucket;
 		}
+
+		/* Stripe exhausted: let its writers go before taking the next one */
+		stripe_unlock_shared(hashmap, stripe);
+		cursor->locked = false;
+		cursor->stripe++;
+	}
+
+	return NULL;
+}
+
+void hm_cursor_close(hm_cursor_s *cursor) {
+	if (cursor == NULL || cursor->hashmap == NULL) {
+		return;
+	}
+
+	if (cursor->locked) {
+		stripe_unlock_shared(cursor->hashmap, &cursor->hashmap->locks[cursor->stripe]);
+		cursor->locked = false;
+	}
+	cursor->stripe = cursor->hashmap->num_locks;
+}
+
+void hm_foreach(hashmap_s *hashmap, void (*callback)(bucket_s *bucket)) {
+	if (hashmap == NULL || callback == NULL) {
+		return;
+	}
+
+	hm_cursor_s cursor;
+	hm_cursor_init(&cursor, hashmap);
+	for (bucket_s *bucket = hm_cursor_next(&cursor); bucket != NULL;
+		 bucket = hm_cursor_next(&cursor)) {
+		callback(bucket);
+	}
+}
+
+void hm_clear(hashmap_s *hashmap) {
+	if (hashmap == NULL) {
+		return;
+	}
+
+	lock_all(hashmap);
+
+	if (hashmap->backend == HM_BACKEND_FLAT) {
+		hm_flat_clear(hashmap);
+	}
+
+	if (hashmap->map != NULL) {
+		free_all_buckets(hashmap);
+		memset(hashmap->map, 0, hashmap->capacity * sizeof(bucket_s *));
+	}
+
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		hashmap->locks[i].newest = NULL;
+		hashmap->locks[i].oldest = NULL;
+		hashmap->locks[i].count = 0;
+	}
+
+	if (hashmap->old_map != NULL) {
+		free(hashmap->old_map);
+		hashmap->old_map = NULL;
+		hashmap->old_capacity = 0;
+		hashmap->old_capacity_bits = 0;
+		atomic_store(&hashmap->rehash_left, 0);
+	}
+
+	atomic_store(&hashmap->size, 0);
+
+	unlock_all(hashmap);
+}
+
+/*
+ * @brief Packed export of keys and/or values.
+ */
+struct export_arg {
+	hashmap_s *hashmap;
+	unsigned char *out; /**< Next record to fill */
+	unsigned char *end; /**< End of the buffer */
+	bool keys;			/**< Copy the key of each entry */
+	bool values;		/**< Copy the value of each entry */
+};
+
+static bool export_entry(bucket_s *bucket, void *arg) {
+	struct export_arg *ea = arg;
+
+	if (ea->out == ea->end) {
+		return false;
+	}
+
+	if (ea->keys) {
+		memcpy(ea->out, bucket->key, ea->hashmap->key_size);
+		ea->out += ea->hashmap->key_size;
+	}
+	if (ea->values) {
+		memcpy(ea->out, bucket->value, ea->hashmap->value_size);
+		ea->out += ea->hashmap->value_size;
+	}
+
+	return true;
+}
+
+/*
+ * @brief Copy every entry into a single buffer of fixed-size records.
+ */
+static void *export_packed(hashmap_s *hashmap, size_t *count, bool keys, bool values) {
+	if (hashmap == NULL || hashmap->variable || count == NULL) {
+		return NULL;
+	}
+
+	size_t record = (keys ? hashmap->key_size : 0) + (values ? hashmap->value_size : 0);
+	*count = 0;
+
+	lock_all(hashmap);
+
+	size_t size = atomic_load(&hashmap->size);
+	if (size == 0 || size > SIZE_MAX / record) {
+		unlock_all(hashmap);
+		return NULL;
 	}
 
-	free(keys);
+	unsigned char *buffer = malloc(size * record);
+	if (buffer == NULL) {
+		unlock_all(hashmap);
+		return NULL;
+	}
+
+	struct export_arg arg = {
+		.hashmap = hashmap,
+		.out = buffer,
+		.end = buffer + size * record,
+		.keys = keys,
+		.values = values,
+	};
+	hm_walk_all(hashmap, export_entry, &arg);
+
+	unlock_all(hashmap);
+
+	*count = (size_t)(arg.out - buffer) / record;
+
+	return buffer;
+}
+
+void *hm_get_keys(hashmap_s *hashmap, size_t *count) {
+	return export_packed(hashmap, count, true, false);
+}
+
+void *hm_get_values(hashmap_s *hashmap, size_t *count) {
+	return export_packed(hashmap, count, false, true);
+}
+
+void *hm_get_entries(hashmap_s *hashmap, size_t *count) {
+	return export_packed(hashmap, count, true, true);
 }
@@ -4,11 +4,60 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <threads.h>
 
-/**< Number of buckets in the hash map */
+/**< Default number of buckets when hm_new() is called with capacity 0 */
 #define MYCLIB_HASHMAP_SIZE 1024
 
+/**< Default number of lock stripes (power of two) */
+#define MYCLIB_HASHMAP_LOCKS 64
+
+/**< Fewest entries a stripe of a bounded cache holds, smaller bounds use fewer stripes */
+#define MYCLIB_HASHMAP_STRIPE_ENTRIES 16
+
+/**< Cache line size used to keep stripes and shared counters apart */
+#define MYCLIB_HASHMAP_CACHE_LINE 64
+
+/**< Maximum load factor (entries per bucket) before the table grows, as NUM / DEN */
+#define MYCLIB_HASHMAP_LOAD_NUM 3
+#define MYCLIB_HASHMAP_LOAD_DEN 4
+
+/**< Number of old buckets a write migrates while a resize is in progress */
+#define MYCLIB_HASHMAP_REHASH_STEP 4
+
+/**< Maximum load factor of a flat segment before it grows, as NUM / DEN */
+#define MYCLIB_HASHMAP_FLAT_LOAD_NUM 7
+#define MYCLIB_HASHMAP_FLAT_LOAD_DEN 8
+
+/**< Nodes in the first and in the largest slab of a stripe pool (HM_ALLOC_POOL) */
+#define MYCLIB_HASHMAP_SLAB_MIN 16
+#define MYCLIB_HASHMAP_SLAB_MAX 4096
+
+/**< Batch entries whose memory is prefetched together before being probed */
+#define MYCLIB_HASHMAP_PREFETCH_GROUP 16
+
+/**< Worker threads of hm_bulk_load() when called with 0 threads */
+#define MYCLIB_HASHMAP_BULK_THREADS 4
+
+/**< Minimum number of pairs per hm_bulk_load() worker */
+#define MYCLIB_HASHMAP_BULK_MIN 4096
+
+/**< Size classes of a blob arena (variable mode): blobs of 16 bytes up to 16 << (CLASSES - 1) */
+#define MYCLIB_HASHMAP_ARENA_CLASSES 12
+
+/**< Bytes of each chunk a blob arena carves its size classes from */
+#define MYCLIB_HASHMAP_ARENA_CHUNK 65536
+
+/**< Bins of the probe length histogram of hm_stats(), the last one also counts longer probes */
+#define MYCLIB_HASHMAP_STATS_BINS 16
+
+/*
+ * Define MYCLIB_HASHMAP_STATS (meson option hashmap_stats) when building the library and its
+ * users to count lock acquisitions, lock contention and entry allocations per stripe. Without
+ * it the counters do not exist and hm_stats() reports them as zero.
+ */
+
 /**
  * @brief A single bucket in the hash map.
  */
@@ -16,15 +65,19 @@ typedef struct bucket {
 	void *key;			 /**< Pointer to the key */
 	void *value;		 /**< Pointer to the value */
 	struct bucket *next; /**< Pointer to the next bucket in case of collision */
+	uint64_t hash;		 /**< Mixed hash of the key, compared before calling equal */
 } bucket_s;
 
 /**
  * @brief Function pointer type for a hash function.
  *
+ * The map mixes the result again before using it, but two keys with the same 64-bit hash always
+ * collide: see hm_hash_bytes() and friends for well-distributed built-in hashes.
+ *
  * @param[in] key Pointer to the key to hash.
- * @return The computed hash as an unsigned integer.
+ * @return The computed 64-bit hash.
  */
-typedef unsigned int hash_f(const void *key);
+typedef uint64_t hash_f(const void *key);
 
 /**
  * @brief Function pointer type for a key comparison function.
@@ -49,23 +102,215 @@ typedef void free_key_f(void *key);
  */
 typedef void free_value_f(void *value);
 
+/**
+ * @brief Storage engine of a hash map.
+ */
+typedef enum hm_backend {
+	HM_BACKEND_CHAINED = 0, /**< Separate chaining, one allocation per entry (default) */
+	HM_BACKEND_FLAT,		/**< Open addressing, keys and values stored inline in slots */
+} hm_backend_e;
+
+/**
+ * @brief Locking discipline of the stripes.
+ */
+typedef enum hm_lock {
+	HM_LOCK_MUTEX = 0, /**< Plain mutex, readers and writers are serialized (default) */
+	HM_LOCK_RWLOCK,	   /**< Reader-writer spinlock, lookups on a stripe run concurrently */
+} hm_lock_e;
+
+/**
+ * @brief How keys are hashed and compared.
+ */
+typedef enum hm_key {
+	HM_KEY_CUSTOM = 0, /**< User hash and equal functions (default) */
+	HM_KEY_BYTES,	   /**< Built-in hash and memcmp() of the key_size bytes of a key */
+	HM_KEY_STRING,	   /**< Built-in hash and strncmp() of NUL-terminated keys */
+} hm_key_e;
+
+/**
+ * @brief Where the chained backend allocates its entries.
+ */
+typedef enum hm_alloc {
+	HM_ALLOC_MALLOC = 0, /**< Separate malloc() for the node, key and value (default) */
+	HM_ALLOC_POOL,		 /**< One node per entry from a per-stripe slab pool */
+} hm_alloc_e;
+
+/**
+ * @brief Open-addressing table owned by one stripe (flat backend).
+ *
+ * Robin Hood hashing: every slot holds key_size bytes of key followed by the value, and the
+ * meta array stores the probe distance of each slot plus one (0 marks an empty slot).
+ */
+typedef struct hm_segment {
+	unsigned char *meta;  /**< Probe distance + 1 of each slot, 0 if empty */
+	uint64_t *hashes;	  /**< Mixed hash of the key in each used slot */
+	unsigned char *slots; /**< capacity * slot_size bytes of inline entries */
+	size_t capacity;	  /**< Number of slots (power of two) */
+	size_t count;		  /**< Number of used slots */
+} hm_segment_s;
+
+/**
+ * @brief Which entry a bounded map drops when a stripe is full.
+ */
+typedef enum hm_evict {
+	HM_EVICT_LRU = 0, /**< Least recently used, lookups take the stripe exclusively (default) */
+	HM_EVICT_CLOCK,	  /**< Second chance: lookups only flag entries and can share the stripe */
+} hm_evict_e;
+
+struct hm_slab;
+struct hm_arena_chunk;
+struct hm_cache_node;
+
+/**
+ * @brief Entry allocator owned by one stripe (HM_ALLOC_POOL).
+ *
+ * Nodes are carved from slabs that double in size up to MYCLIB_HASHMAP_SLAB_MAX nodes. Freed
+ * nodes go to a freelist and are reused first; slabs are only released all at once.
+ */
+typedef struct hm_pool {
+	void *free_list;	   /**< Freed nodes, linked through their first bytes */
+	struct hm_slab *slabs; /**< Slabs, newest first */
+	size_t slab_used;	   /**< Nodes already carved from the newest slab */
+	size_t slab_nodes;	   /**< Node capacity of the newest slab */
+} hm_pool_s;
+
+/**
+ * @brief Allocator of the out-of-line keys and values of one stripe (variable mode).
+ *
+ * Blobs are rounded up to a power-of-two size class and carved from shared chunks; freed blobs
+ * go to the freelist of their class. Blobs beyond the largest class get a chunk of their own,
+ * given back to malloc() as soon as they are freed.
+ */
+typedef struct hm_arena {
+	void *free_lists[MYCLIB_HASHMAP_ARENA_CLASSES];	/**< Freed blobs of each class */
+	struct hm_arena_chunk *chunks;					/**< Chunks shared by the classes */
+	struct hm_arena_chunk *large;					/**< Chunks holding one large blob each */
+	size_t chunk_used;								/**< Bytes carved from the newest chunk */
+} hm_arena_s;
+
+/**
+ * @brief A lock stripe, alone on its cache line(s).
+ *
+ * Stripes and buckets are both indexed by the top bits of the hash, so stripe i protects the
+ * contiguous range [i * capacity / num_locks, (i + 1) * capacity / num_locks) of buckets, in
+ * both the current and the old table. With the flat backend each stripe owns a whole segment.
+ */
+typedef struct hm_stripe {
+	/** Stripe mutex (HM_LOCK_MUTEX), aligned so that no two stripes share a cache line */
+	_Alignas(MYCLIB_HASHMAP_CACHE_LINE) mtx_t lock;
+	atomic_uint rw;				  /**< Reader count and writer flags (HM_LOCK_RWLOCK) */
+	size_t rehash_pos;			  /**< Next old bucket this stripe migrates during a resize */
+	hm_segment_s segment;		  /**< Open-addressing table (flat backend only) */
+	hm_pool_s pool;				  /**< Entry allocator (HM_ALLOC_POOL only) */
+	hm_arena_s arena;			  /**< Keys and values too long for their node (variable mode) */
+	struct hm_cache_node *newest; /**< Most recently used or inserted entry (cache mode) */
+	struct hm_cache_node *oldest; /**< Next entry to evict (cache mode) */
+	size_t count;				  /**< Entries of the stripe (cache mode) */
+#ifdef MYCLIB_HASHMAP_STATS
+	atomic_size_t acquired;	 /**< Lock acquisitions, shared ones included */
+	atomic_size_t contended; /**< Acquisitions that found the stripe taken */
+	atomic_size_t allocs;	 /**< Chained entries allocated */
+#endif
+} hm_stripe_s;
+
+/**
+ * @brief Function pointer type for visiting a stored entry in place.
+ *
+ * @param[in] key Pointer to the stored key.
+ * @param[in] value Pointer to the stored value.
+ * @param[in] arg User argument.
+ */
+typedef void hm_visit_f(const void *key, const void *value, void *arg);
+
+/**
+ * @brief Function pointer type for updating a stored value in place.
+ *
+ * @param[in] key Pointer to the stored key.
+ * @param[in,out] value Pointer to the stored value, modified in place.
+ * @param[in] inserted true if the entry was inserted by this very call.
+ * @param[in] arg User argument.
+ */
+typedef void hm_update_f(const void *key, void *value, bool inserted, void *arg);
+
 /**
  * @brief Main structure representing the hash map.
  * Thread-safe for concurrent operations on different keys.
+ *
+ * The table grows by doubling once the load factor is exceeded. The resize is incremental:
+ * the old table is kept next to the new one and every write migrates a few old buckets of its
+ * own stripe, so no single call pays for a full rehash.
  */
 typedef struct hashmap {
-	hash_f *hash;					   /**< Hash function */
-	equal_f *equal;					   /**< Equality comparison function */
-	free_key_f *free_key;			   /**< Key deallocation function (optional) */
-	free_value_f *free_value;		   /**< Value deallocation function (optional) */
-	size_t key_size;				   /**< Size in bytes of the key */
-	size_t value_size;				   /**< Size in bytes of the value */
-	bucket_s map[MYCLIB_HASHMAP_SIZE]; /**< Array of bucket chains */
-	atomic_size_t size;				   /**< Hashmap size (number of keys) - atomic */
-	mtx_t *locks;					   /**< Mutex array */
-	size_t num_locks;				   /**< Number of mutex */
+	hm_backend_e backend;			/**< Storage engine */
+	hm_key_e key_type;				/**< How keys are hashed and compared */
+	hm_alloc_e alloc;				/**< Entry allocator of the chained backend */
+	bool cache;						/**< Entries carry recency and expiry bookkeeping */
+	bool variable;					/**< Keys and values have their own lengths (hm_set_var()) */
+	hm_evict_e eviction;			/**< Eviction policy of a bounded map */
+	size_t stripe_max;				/**< Entries a stripe holds before evicting, 0 if unbounded */
+	uint64_t ttl_ms;				/**< Lifetime of entries written by hm_set(), 0 for forever */
+	hash_f *hash;					/**< Hash function */
+	equal_f *equal;					/**< Equality comparison function */
+	free_key_f *free_key;			/**< Key deallocation function (optional) */
+	free_value_f *free_value;		/**< Value deallocation function (optional) */
+	size_t key_size;				/**< Size in bytes of the key */
+	size_t value_size;				/**< Size in bytes of the value */
+	size_t value_offset;			/**< Offset of the value inside a flat slot or pool node */
+	size_t slot_size;				/**< Size in bytes of a flat slot or pool node */
+	bucket_s **map;					/**< Array of bucket chains (chained backend only) */
+	size_t capacity;				/**< Number of buckets in map (power of two) */
+	unsigned int capacity_bits;		/**< log2(capacity) */
+	bucket_s **old_map;				/**< Table being migrated during a resize (NULL otherwise) */
+	size_t old_capacity;			/**< Number of buckets in old_map */
+	unsigned int old_capacity_bits;	/**< log2(old_capacity) */
+	hm_lock_e lock_mode;			/**< Locking discipline of the stripes */
+	hm_stripe_s *locks;				/**< Lock stripes */
+	size_t num_locks;				/**< Number of lock stripes (power of two) */
+	unsigned int lock_bits;			/**< log2(num_locks) */
+	/** Number of keys - atomic. Written by every insert/remove, so it starts its own cache line */
+	_Alignas(MYCLIB_HASHMAP_CACHE_LINE) atomic_size_t size;
+	atomic_size_t rehash_left; /**< Stripes that still have old buckets to migrate */
 } hashmap_s;
 
+/**
+ * @brief Hash map creation parameters.
+ *
+ * Zero-initialize it and fill the fields you need: every zero field takes its default.
+ */
+typedef struct hm_config {
+	hm_key_e key_type;		  /**< Built-in key handling, replaces hash and equal when set */
+	hash_f *hash;			  /**< Hash function (required for HM_KEY_CUSTOM) */
+	equal_f *equal;			  /**< Equality comparison function (required for HM_KEY_CUSTOM) */
+	free_key_f *free_key;	  /**< Key deallocation function (chained backend only) */
+	free_value_f *free_value; /**< Value deallocation function (chained backend only) */
+	size_t key_size;		  /**< Size in bytes of the key (required unless variable) */
+	size_t value_size;		  /**< Size in bytes of the value (required unless variable) */
+	bool variable;			  /**< Keys and values of any length, see hm_new_config() */
+	size_t capacity;		  /**< Initial number of buckets/slots (0 for MYCLIB_HASHMAP_SIZE) */
+	hm_backend_e backend;	  /**< Storage engine */
+	hm_alloc_e alloc;		  /**< Entry allocator (chained backend only) */
+	size_t max_entries;		  /**< Bound on the entries, enforced per stripe (0 for unbounded) */
+	hm_evict_e eviction;	  /**< Eviction policy once max_entries is reached */
+	uint64_t ttl_ms;		  /**< Default lifetime of an entry in ms (0 for forever) */
+	hm_lock_e lock_mode;	  /**< Locking discipline, HM_LOCK_RWLOCK for read-mostly maps */
+	size_t num_stripes;		  /**< Lock stripes, rounded to a power of two (0 for default) */
+} hm_config_s;
+
+/**
+ * @brief Position of a walk over a hash map, see hm_cursor_next().
+ *
+ * Lives wherever the caller puts it (usually the stack): iterating allocates nothing.
+ */
+typedef struct hm_cursor {
+	hashmap_s *hashmap; /**< Map being walked */
+	size_t stripe;		/**< Stripe being walked, num_locks once the walk is over */
+	bool locked;		/**< Whether the stripe lock is currently held */
+	bool old_table;		/**< Walking the old table of a resize (chained backend) */
+	size_t index;		/**< Next bucket (chained) or slot (flat) of the stripe */
+	bucket_s *next;		/**< Next entry of the current chain (chained backend) */
+	bucket_s view;		/**< Entry handed out by the flat backend */
+} hm_cursor_s;
+
 /**
  * @brief Initialize a new hash map.
  *
@@ -75,10 +320,74 @@ typedef struct hashmap {
  * @param[in] free_value Function used to free values (optional, can be NULL).
  * @param[in] key_size Size in bytes of each key to be stored.
  * @param[in] value_size Size in bytes of each value to be stored.
+ * @param[in] capacity Initial number of buckets, rounded up to a power of two (0 for
+ * MYCLIB_HASHMAP_SIZE).
  * @return A pointer to the newly initialized hash map, or NULL on failure.
  */
 hashmap_s *hm_new(hash_f *hash, equal_f *equal, free_key_f *free_key, free_value_f *free_value,
-				  size_t key_size, size_t value_size);
+				  size_t key_size, size_t value_size, size_t capacity);
+
+/**
+ * @brief Initialize a new hash map from a configuration.
+ *
+ * The flat backend stores keys and values inside the table itself, so an insert does no
+ * allocation unless its segment has to grow. It owns that storage: free_key and free_value must
+ * be NULL.
+ *
+ * With HM_ALLOC_POOL the chained backend stores each entry (node, key and value) in a single
+ * node from a slab pool private to its stripe, so writers never contend in malloc() and
+ * hm_clear()/hm_free() release whole slabs without walking the chains. The map owns that
+ * storage too: free_key and free_value must be NULL.
+ *
+ * A non-zero max_entries or ttl_ms turns the chained backend into a cache. Each stripe keeps
+ * its entries in a recency list, updated in O(1) under the stripe lock. The bound is enforced
+ * per stripe, so it is approximate: a stripe holds at most max_entries / stripes (rounded down)
+ * entries and evicts by the chosen policy when an insert goes past that, even while other
+ * stripes have room. The map never holds more than max_entries, but may evict before reaching
+ * it. Bounds below MYCLIB_HASHMAP_STRIPE_ENTRIES entries per stripe reduce the number of
+ * stripes to fit. Expired entries are invisible to lookups and walks, and are reclaimed when they
+ * reach the old end of their stripe, when their key is written again or by hm_expire(). The
+ * flat backend does not support cache mode.
+ *
+ * With variable set, every key and value has its own length and is written with hm_set_var().
+ * key_size and value_size become the bytes kept inside the entry node: shorter keys and values
+ * are stored there, longer ones in a size-class arena private to the stripe. Either may be 0 to
+ * store everything out of line. Keys are hashed with hm_hash_bytes() and compared byte by byte,
+ * key_type, hash and equal are ignored. Variable mode is only supported by the chained backend,
+ * which then always uses HM_ALLOC_POOL, so free_key and free_value must be NULL. The fixed-size
+ * functions (hm_set(), hm_get_value(), batches, exports, snapshots...) fail on such a map.
+ *
+ * @param[in] config Creation parameters.
+ * @return A pointer to the newly initialized hash map, or NULL on failure.
+ */
+hashmap_s *hm_new_config(const hm_config_s *config);
+
+/**
+ * @brief Initialize a new hash map with fixed-size keys compared byte by byte.
+ *
+ * Keys are hashed with hm_hash_bytes(). Padding bytes inside struct keys take part in the
+ * comparison, so zero such keys before filling them.
+ *
+ * @param[in] key_size Size in bytes of each key.
+ * @param[in] value_size Size in bytes of each value.
+ * @param[in] capacity Initial number of buckets (0 for MYCLIB_HASHMAP_SIZE).
+ * @return A pointer to the newly initialized hash map, or NULL on failure.
+ */
+hashmap_s *hm_new_bytes(size_t key_size, size_t value_size, size_t capacity);
+
+/**
+ * @brief Initialize a new hash map with NUL-terminated string keys.
+ *
+ * Each key lives in a buffer of key_size bytes, which must cover the longest key and its
+ * terminator. Like every key it is copied as key_size bytes, so pass readable buffers of that
+ * size. Hashing and comparison stop at the terminator.
+ *
+ * @param[in] key_size Size in bytes of each key buffer.
+ * @param[in] value_size Size in bytes of each value.
+ * @param[in] capacity Initial number of buckets (0 for MYCLIB_HASHMAP_SIZE).
+ * @return A pointer to the newly initialized hash map, or NULL on failure.
+ */
+hashmap_s *hm_new_string(size_t key_size, size_t value_size, size_t capacity);
 
 /**
  * @brief Free all resources used by the hash map.
@@ -121,6 +430,167 @@ bool hm_set(hashmap_s *hashmap, void *key, void *value);
  */
 bucket_s *hm_get(hashmap_s *hashmap, void *key);
 
+/**
+ * @brief Copy the value of a key into a caller buffer, without allocating.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key to search for.
+ * @param[out] value Buffer of at least value_size bytes receiving the value.
+ * @return true if the key was found, false otherwise (value is left untouched).
+ */
+bool hm_get_value(hashmap_s *hashmap, const void *key, void *value);
+
+/**
+ * @brief Look up a batch of keys.
+ *
+ * The whole batch is hashed first and grouped by stripe, so each stripe lock is taken once per
+ * call, and bucket memory is prefetched ahead of the probes. Much faster than calling
+ * hm_get_value() in a loop.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] keys Array of count packed keys of key_size bytes each.
+ * @param[in] count Number of keys.
+ * @param[out] values Array of count values of value_size bytes each. The value of a missing
+ * key is left untouched.
+ * @param[out] found Array of count flags telling which keys were found (can be NULL).
+ * @return Number of keys found.
+ */
+size_t hm_get_many(hashmap_s *hashmap, const void *keys, size_t count, void *values,
+				   bool *found);
+
+/**
+ * @brief Insert or update a batch of key-value pairs.
+ *
+ * Grouped by stripe like hm_get_many(). When a key appears several times in the batch, the
+ * last pair wins.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] keys Array of count packed keys of key_size bytes each.
+ * @param[in] values Array of count packed values of value_size bytes each.
+ * @param[in] count Number of pairs.
+ * @return Number of pairs stored, less than count on failure.
+ */
+size_t hm_set_many(hashmap_s *hashmap, const void *keys, const void *values, size_t count);
+
+/**
+ * @brief Load a large batch of key-value pairs using several threads.
+ *
+ * Meant for building or warming up a map: the table is sized for the whole batch up front and
+ * every stripe stays locked by the caller for the duration of the call, so the workers insert
+ * without taking any lock. Pairs are hashed in parallel, grouped by stripe, and each worker
+ * fills its own contiguous range of stripes. When a key appears several times, the last pair
+ * wins. Other threads using the map wait until the load is over.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] keys Array of count packed keys of key_size bytes each.
+ * @param[in] values Array of count packed values of value_size bytes each.
+ * @param[in] count Number of pairs.
+ * @param[in] num_threads Number of threads, the calling one included (0 for
+ * MYCLIB_HASHMAP_BULK_THREADS). At most one per stripe is used.
+ * @return Number of pairs stored, less than count on failure.
+ */
+size_t hm_bulk_load(hashmap_s *hashmap, const void *keys, const void *values, size_t count,
+					size_t num_threads);
+
+/**
+ * @brief Run a callback on the stored entry of a key, without copying it.
+ *
+ * The callback runs with the stripe lock held (shared with other readers in HM_LOCK_RWLOCK
+ * mode): it must be short, must not keep the pointers after returning and must not call back
+ * into the same hash map.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key to search for.
+ * @param[in] callback Function called on the entry if found (can be NULL).
+ * @param[in] arg User argument passed to the callback.
+ * @return true if the key was found, false otherwise.
+ */
+bool hm_peek(hashmap_s *hashmap, const void *key, hm_visit_f *callback, void *arg);
+
+/* Atomic read-modify-write. Each call is one exclusive hold of the key's stripe. */
+
+/**
+ * @brief Update the stored value of an existing key in place.
+ *
+ * The callback runs with the stripe lock held exclusively: it must be short, must not keep the
+ * pointers after returning and must not call back into the same hash map.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @param[in] callback Function modifying the value.
+ * @param[in] arg User argument passed to the callback.
+ * @return true if the key was found and the callback ran, false otherwise.
+ */
+bool hm_compute(hashmap_s *hashmap, const void *key, hm_update_f *callback, void *arg);
+
+/**
+ * @brief Update the stored value of a key in place, inserting it first if it is missing.
+ *
+ * A missing key is inserted with a copy of init, then the callback runs on it with inserted
+ * set. Counting is an upsert with a zero init and a callback adding one. Same callback rules as
+ * hm_compute().
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @param[in] init Value of a newly inserted key, before the callback runs.
+ * @param[in] callback Function modifying the value.
+ * @param[in] arg User argument passed to the callback.
+ * @return true if the callback ran, false on failure.
+ */
+bool hm_upsert(hashmap_s *hashmap, const void *key, const void *init, hm_update_f *callback,
+			   void *arg);
+
+/**
+ * @brief Get the value of a key, inserting the given value if the key is missing.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @param[in] value Value to insert if the key is missing.
+ * @param[out] out Buffer of value_size bytes receiving the stored value (can be NULL).
+ * @param[out] inserted Set to true if value was inserted, false if the key existed (can be NULL).
+ * @return true on success, false on failure.
+ */
+bool hm_get_or_insert(hashmap_s *hashmap, const void *key, const void *value, void *out,
+					  bool *inserted);
+
+/**
+ * @brief Replace the value of a key only if it still equals an expected value.
+ *
+ * Values are compared byte by byte, like atomic_compare_exchange_strong().
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @param[in,out] expected Value the key must hold. Receives the stored value on a mismatch.
+ * @param[in] desired New value.
+ * @return true if the value was replaced, false on a mismatch or if the key is missing.
+ */
+bool hm_cas(hashmap_s *hashmap, const void *key, void *expected, const void *desired);
+
+/**
+ * @brief Insert or update a key-value pair with its own lifetime.
+ *
+ * Like hm_set(), for maps in cache mode. The entry expires ttl_ms milliseconds from now, or
+ * never when ttl_ms is 0, whatever the ttl_ms of the map.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @param[in] value Pointer to the value.
+ * @param[in] ttl_ms Lifetime of the entry in milliseconds.
+ * @return true on success, false on failure or if the map is not in cache mode.
+ */
+bool hm_set_ttl(hashmap_s *hashmap, void *key, void *value, uint64_t ttl_ms);
+
+/**
+ * @brief Remove every expired entry now.
+ *
+ * Locks one stripe at a time. Only needed to give memory back early: expired entries are
+ * already invisible and are otherwise reclaimed as the map is written.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @return Number of entries removed.
+ */
+size_t hm_expire(hashmap_s *hashmap);
+
 /**
  * @brief Remove a key-value pair from the hash map.
  *
@@ -133,6 +603,114 @@ bucket_s *hm_get(hashmap_s *hashmap, void *key);
  */
 bool hm_remove(hashmap_s *hashmap, void *key);
 
+/* Variable-length entries */
+
+/**
+ * @brief Insert or update a key-value pair of a map created with variable set.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key bytes.
+ * @param[in] key_len Length of the key in bytes (less than 4 GiB).
+ * @param[in] value Pointer to the value bytes (may be NULL if value_len is 0).
+ * @param[in] value_len Length of the value in bytes (less than 4 GiB).
+ * @return true on success, false on failure or if the map is not in variable mode.
+ */
+bool hm_set_var(hashmap_s *hashmap, const void *key, size_t key_len, const void *value,
+				size_t value_len);
+
+/**
+ * @brief Copy the value of a key of a variable-mode map into a caller buffer.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key bytes.
+ * @param[in] key_len Length of the key in bytes.
+ * @param[out] value Buffer receiving at most *value_len bytes of the value, or NULL.
+ * @param[in,out] value_len Capacity of value, set to the full length of the value when found.
+ * May be NULL if value is NULL.
+ * @return true if the key was found. The value was truncated if *value_len grew.
+ */
+bool hm_get_var(hashmap_s *hashmap, const void *key, size_t key_len, void *value,
+				size_t *value_len);
+
+/**
+ * @brief Remove a key of a variable-mode map.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key bytes.
+ * @param[in] key_len Length of the key in bytes.
+ * @return true if the key was found and removed, false otherwise.
+ */
+bool hm_remove_var(hashmap_s *hashmap, const void *key, size_t key_len);
+
+/**
+ * @brief Length of a key or value stored in a variable-mode map.
+ *
+ * Works on the key and value pointers of the entries that hm_cursor_next() and hm_foreach()
+ * hand out for a variable-mode map.
+ *
+ * @param[in] data Stored key or value.
+ * @return Its length in bytes.
+ */
+size_t hm_var_len(const void *data);
+
+/* Precomputed hashes */
+
+/**
+ * @brief Hash a key the way the map does.
+ *
+ * This is what the map hash function returns for the key, or hm_hash_bytes() of the key with
+ * seed 0 for HM_KEY_BYTES and of the string up to its terminator for HM_KEY_STRING. A hash
+ * computed once can be reused with the *_with_hash() functions, which skip hashing the key.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @return Hash of the key, 0 if an argument is NULL.
+ */
+uint64_t hm_hash(hashmap_s *hashmap, const void *key);
+
+/**
+ * @brief hm_set() for a key whose hash is already known.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key.
+ * @param[in] value Pointer to the value.
+ * @param[in] hash hm_hash() of the key. Any other value misplaces the entry.
+ * @return true on success, false on failure.
+ */
+bool hm_set_with_hash(hashmap_s *hashmap, void *key, void *value, uint64_t hash);
+
+/**
+ * @brief hm_get() for a key whose hash is already known.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key to search for.
+ * @param[in] hash hm_hash() of the key.
+ * @return Pointer to the copy of the bucket or NULL on failure.
+ * @note Free after use with hm_free_bucket().
+ */
+bucket_s *hm_get_with_hash(hashmap_s *hashmap, void *key, uint64_t hash);
+
+/**
+ * @brief hm_get_value() for a key whose hash is already known.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key to search for.
+ * @param[out] value Buffer of at least value_size bytes receiving the value.
+ * @param[in] hash hm_hash() of the key.
+ * @return true if the key was found, false otherwise (value is left untouched).
+ */
+bool hm_get_value_with_hash(hashmap_s *hashmap, const void *key, void *value, uint64_t hash);
+
+/**
+ * @brief hm_remove() for a key whose hash is already known.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] key Pointer to the key to remove.
+ * @param[in] hash hm_hash() of the key.
+ * @return true if the key was found and removed, false otherwise.
+ */
+bool hm_remove_with_hash(hashmap_s *hashmap, void *key, uint64_t hash);
+
 /**
  * @brief Get the number of entries in the hash map.
  *
@@ -141,6 +719,46 @@ bool hm_remove(hashmap_s *hashmap, void *key);
  */
 size_t hm_size(hashmap_s *hashmap);
 
+/**
+ * @brief Counters of one stripe, zero unless built with MYCLIB_HASHMAP_STATS.
+ */
+typedef struct hm_stripe_stats {
+	size_t acquired;  /**< Lock acquisitions, shared ones included */
+	size_t contended; /**< Acquisitions that had to wait for another thread */
+	size_t allocs;	  /**< Chained entries allocated since creation */
+} hm_stripe_stats_s;
+
+/**
+ * @brief Shape of a hash map at one point in time, filled by hm_stats().
+ *
+ * The probe length of an entry is the number of entries a lookup of its key compares: its
+ * position in its chain plus one, or its Robin Hood probe distance plus one with the flat backend.
+ */
+typedef struct hm_stats {
+	size_t size;							  /**< Number of entries */
+	size_t capacity;						  /**< Buckets of map[], or slots of all segments */
+	double load_factor;						  /**< size / capacity */
+	size_t used_buckets;					  /**< Non-empty buckets of map[], or used slots */
+	size_t max_probe;						  /**< Longest probe length, the longest chain */
+	size_t probes[MYCLIB_HASHMAP_STATS_BINS]; /**< probes[i]: entries of probe length i + 1 */
+	size_t num_stripes;						  /**< Number of lock stripes */
+	hm_stripe_stats_s total;				  /**< Counters summed over every stripe */
+} hm_stats_s;
+
+/**
+ * @brief Collect statistics about a hash map.
+ *
+ * Walks the whole map with every stripe locked, so it costs about as much as hm_foreach(). Its
+ * own lock acquisitions are counted. During a resize the entries still in the old table are
+ * included in the probe lengths but not in used_buckets.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[out] stats Statistics of the whole map.
+ * @param[out] stripes Array of hashmap->num_locks counters, one per stripe, or NULL.
+ * @return true on success, false if an argument is NULL.
+ */
+bool hm_stats(hashmap_s *hashmap, hm_stats_s *stats, hm_stripe_stats_s *stripes);
+
 /**
  * @brief Check if a key exists in the hash map.
  *
@@ -153,11 +771,47 @@ bool hm_contains(hashmap_s *hashmap, void *key);
 /**
  * @brief Iterate over all entries in the hash map.
  *
+ * Built on a cursor: one stripe is locked at a time and the callback receives the stored entry
+ * itself, which it must neither modify nor free and must not call back into the map.
+ *
  * @param[in] hashmap Pointer to the hash map.
  * @param[in] callback Function called for each bucket.
  */
 void hm_foreach(hashmap_s *hashmap, void (*callback)(bucket_s *bucket));
 
+/**
+ * @brief Start a walk over the hash map.
+ *
+ * The walk goes stripe by stripe and holds the lock of the current stripe (shared in
+ * HM_LOCK_RWLOCK mode) between calls to hm_cursor_next(), so writers are only held up on that
+ * one stripe. Entries inserted or removed in stripes not yet reached may or may not be seen.
+ *
+ * @param[out] cursor Cursor to initialize.
+ * @param[in] hashmap Pointer to the hash map.
+ */
+void hm_cursor_init(hm_cursor_s *cursor, hashmap_s *hashmap);
+
+/**
+ * @brief Advance a cursor to the next entry.
+ *
+ * The returned entry is borrowed: it stays valid until the next call on the cursor and must not
+ * be modified or freed. While a stripe is held, the calling thread must not use the map for
+ * anything but this cursor. The last stripe is released once NULL is returned.
+ *
+ * @param[in,out] cursor Cursor started with hm_cursor_init().
+ * @return The next entry, or NULL at the end of the map.
+ */
+bucket_s *hm_cursor_next(hm_cursor_s *cursor);
+
+/**
+ * @brief Stop a walk early and release the stripe it holds.
+ *
+ * Not needed once hm_cursor_next() returned NULL, harmless if called anyway.
+ *
+ * @param[in,out] cursor Cursor started with hm_cursor_init().
+ */
+void hm_cursor_close(hm_cursor_s *cursor);
+
 /**
  * @brief Remove all entries from the hash map.
  *
@@ -166,24 +820,178 @@ void hm_foreach(hashmap_s *hashmap, void (*callback)(bucket_s *bucket));
 void hm_clear(hashmap_s *hashmap);
 
 /**
- * @brief Get all keys from the hash map.
+ * @brief Copy all keys of the hash map into one packed buffer.
  *
- * Returns an array of pointers to copies of all keys in the hashmap.
- * The caller is responsible for freeing the array and each key.
+ * The keys are laid out back to back, key_size bytes each, so the buffer can be handed as is
+ * to qsort() or copied into a vector. The copy is a consistent snapshot: every stripe is locked
+ * while it is taken.
  *
  * @param[in] hashmap Pointer to the hash map.
  * @param[out] count Pointer to store the number of keys returned.
- * @return Array of key pointers, or NULL on failure. Must be freed with hm_free_keys().
+ * @return Buffer of count * key_size bytes to release with free(), or NULL if the map is empty
+ * or on failure.
+ */
+void *hm_get_keys(hashmap_s *hashmap, size_t *count);
+
+/**
+ * @brief Copy all values of the hash map into one packed buffer.
+ *
+ * Same as hm_get_keys() with value_size bytes per value.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[out] count Pointer to store the number of values returned.
+ * @return Buffer of count * value_size bytes to release with free(), or NULL if the map is empty
+ * or on failure.
+ */
+void *hm_get_values(hashmap_s *hashmap, size_t *count);
+
+/**
+ * @brief Copy all entries of the hash map into one packed buffer.
+ *
+ * Each record is key_size bytes of key immediately followed by value_size bytes of value, with
+ * no padding in between: read values with memcpy() unless the key size keeps them aligned.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[out] count Pointer to store the number of entries returned.
+ * @return Buffer of count * (key_size + value_size) bytes to release with free(), or NULL if the
+ * map is empty or on failure.
+ */
+void *hm_get_entries(hashmap_s *hashmap, size_t *count);
+
+/* Snapshots (myhashmap_file.c) */
+
+/**< Version of the snapshot file format written by hm_save() */
+#define MYCLIB_HASHMAP_FILE_VERSION 1
+
+/**
+ * @brief A read-only hash map snapshot, queried in place from a memory-mapped file.
+ *
+ * The file is a header followed by a linear-probing table: a byte per slot marking used slots,
+ * the cached 64-bit hash of each slot, then the inline entries laid out like the flat backend.
+ * Every position is an offset from the start of the file, so the mapping needs no fixup.
+ */
+typedef struct hm_mapped {
+	hm_key_e key_type;			/**< How keys are hashed and compared */
+	hash_f *hash;				/**< Hash function (HM_KEY_CUSTOM) */
+	equal_f *equal;				/**< Equality comparison function (HM_KEY_CUSTOM) */
+	size_t key_size;			/**< Size in bytes of the key */
+	size_t value_size;			/**< Size in bytes of the value */
+	size_t value_offset;		/**< Offset of the value inside a slot */
+	size_t slot_size;			/**< Size in bytes of a slot */
+	size_t count;				/**< Number of entries */
+	size_t capacity;			/**< Number of slots (power of two) */
+	unsigned int capacity_bits;	/**< log2(capacity) */
+	const unsigned char *used;	/**< Non-zero for every used slot */
+	const uint64_t *hashes;		/**< Hash of the key in each used slot */
+	const unsigned char *slots;	/**< capacity * slot_size bytes of inline entries */
+	void *base;					/**< Start of the file image */
+	size_t length;				/**< Size of the file image */
+} hm_mapped_s;
+
+/**
+ * @brief Write a snapshot of the hash map to a file.
+ *
+ * Every stripe is locked while the image is built in memory, then released before the file is
+ * written. The file is first written next to path and renamed over it, so a reader never sees
+ * a partial snapshot. The format uses the native byte order and type sizes.
+ *
+ * @param[in] hashmap Pointer to the hash map.
+ * @param[in] path Destination file.
+ * @return true on success.
+ */
+bool hm_save(hashmap_s *hashmap, const char *path);
+
+/**
+ * @brief Open a snapshot written by hm_save() and map it read-only.
+ *
+ * Nothing is deserialized: lookups probe the mapped file directly. The key_type, key_size and
+ * value_size of config must match the saved map, and HM_KEY_CUSTOM needs the same hash and
+ * equal functions it was saved with. Other config fields are ignored.
+ *
+ * @param[in] path Snapshot file.
+ * @param[in] config Key handling of the saved map.
+ * @return A pointer to the snapshot, or NULL if the file is missing, foreign or corrupted.
  */
-void **hm_get_keys(hashmap_s *hashmap, size_t *count);
+hm_mapped_s *hm_open_mapped(const char *path, const hm_config_s *config);
 
 /**
- * @brief Free the array returned by hm_get_keys.
+ * @brief Look a key up in a snapshot.
  *
- * @param[in] hashmap Pointer to the hash map (needed for free_key function).
- * @param[in] keys Array of keys returned by hm_get_keys.
- * @param[in] count Number of keys in the array.
+ * Safe to call from any number of threads.
+ *
+ * @param[in] mapped Pointer to the snapshot.
+ * @param[in] key Pointer to the key to search for.
+ * @return Pointer to the value inside the mapping, valid until hm_mapped_close(), or NULL if
+ * the key is missing.
+ */
+const void *hm_mapped_get(const hm_mapped_s *mapped, const void *key);
+
+/**
+ * @brief Get the number of entries in a snapshot.
+ *
+ * @param[in] mapped Pointer to the snapshot.
+ * @return Number of key-value pairs.
+ */
+size_t hm_mapped_size(const hm_mapped_s *mapped);
+
+/**
+ * @brief Unmap a snapshot and free it.
+ *
+ * @param[in] mapped Pointer to the snapshot.
+ */
+void hm_mapped_close(hm_mapped_s *mapped);
+
+/* Built-in hash functions (myhashmap_hash.c) */
+
+/**
+ * @brief Hash a byte buffer.
+ *
+ * wyhash-style: 64-bit multiply-mix over 16 or 48 bytes at a time. Fast on short keys and
+ * well-distributed over all 64 bits.
+ *
+ * @param[in] data Bytes to hash.
+ * @param[in] len Number of bytes.
+ * @param[in] seed Seed, 0 unless several independent hashes are needed.
+ * @return The 64-bit hash.
+ */
+uint64_t hm_hash_bytes(const void *data, size_t len, uint64_t seed);
+
+/**
+ * @brief Mix a 64-bit integer so that every output bit depends on every input bit.
+ *
+ * @param[in] x Integer to hash.
+ * @return The 64-bit hash.
+ */
+uint64_t hm_hash_int(uint64_t x);
+
+/**
+ * @brief hash_f for uint32_t keys.
+ */
+uint64_t hm_hash_u32(const void *key);
+
+/**
+ * @brief hash_f for uint64_t keys.
+ */
+uint64_t hm_hash_u64(const void *key);
+
+/**
+ * @brief hash_f for NUL-terminated string keys.
+ */
+uint64_t hm_hash_str(const void *key);
+
+/**
+ * @brief equal_f for uint32_t keys.
+ */
+bool hm_equal_u32(const void *key_a, const void *key_b);
+
+/**
+ * @brief equal_f for uint64_t keys.
+ */
+bool hm_equal_u64(const void *key_a, const void *key_b);
+
+/**
+ * @brief equal_f for NUL-terminated string keys.
  */
-void hm_free_keys(hashmap_s *hashmap, void **keys, size_t count);
+bool hm_equal_str(const void *key_a, const void *key_b);
 
 #endif /* MYCLIB_HASHMAP_H */
@@ -0,0 +1,396 @@
+#include "myhashmap_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**< First bytes of every snapshot */
+#define FILE_MAGIC "MYCLIBHM"
+
+/**< Written in native order, reads back differently on a machine of the other endianness */
+#define FILE_BYTE_ORDER 0x0102030405060708ULL
+
+/**< Smallest table of a snapshot, as log2 */
+#define FILE_MIN_BITS 4
+
+/*
+ * @brief On-disk header, at offset 0 of the file.
+ */
+struct file_header {
+	char magic[8];			/**< FILE_MAGIC, without terminator */
+	uint32_t version;		/**< MYCLIB_HASHMAP_FILE_VERSION */
+	uint32_t key_type;		/**< hm_key_e of the saved map */
+	uint64_t byte_order;	/**< FILE_BYTE_ORDER */
+	uint64_t key_size;		/**< Size in bytes of the key */
+	uint64_t value_size;	/**< Size in bytes of the value */
+	uint64_t count;			/**< Number of entries */
+	uint64_t capacity_bits;	/**< log2 of the number of slots */
+	uint64_t used_offset;	/**< Offset of the used byte array */
+	uint64_t hashes_offset;	/**< Offset of the hash array */
+	uint64_t slots_offset;	/**< Offset of the slot array */
+	uint64_t file_size;		/**< Size of the whole file */
+};
+
+/*
+ * @brief Where everything sits in a snapshot of a given shape.
+ */
+struct file_layout {
+	size_t value_offset; /**< Offset of the value inside a slot */
+	size_t slot_size;	 /**< Size in bytes of a slot */
+	size_t used;		 /**< Offset of the used byte array */
+	size_t hashes;		 /**< Offset of the hash array */
+	size_t slots;		 /**< Offset of the slot array */
+	size_t size;		 /**< Size of the whole file */
+};
+
+/*
+ * @brief Compute the layout of a snapshot. Arrays start on cache lines.
+ * @return false if the snapshot would not fit in memory.
+ */
+static bool file_layout(size_t key_size, size_t value_size, unsigned int capacity_bits,
+						struct file_layout *layout) {
+	if (capacity_bits >= sizeof(size_t) * 8 - 1 || key_size > SIZE_MAX / 4 ||
+		value_size > SIZE_MAX / 4) {
+		return false;
+	}
+
+	slot_layout(key_size, value_size, &layout->value_offset, &layout->slot_size);
+
+	size_t capacity = (size_t)1 << capacity_bits;
+	if (capacity > SIZE_MAX / 2 / (1 + sizeof(uint64_t) + layout->slot_size)) {
+		return false;
+	}
+
+	layout->used = round_up(sizeof(struct file_header), MYCLIB_HASHMAP_CACHE_LINE);
+	layout->hashes = round_up(layout->used + capacity, MYCLIB_HASHMAP_CACHE_LINE);
+	layout->slots =
+		round_up(layout->hashes + capacity * sizeof(uint64_t), MYCLIB_HASHMAP_CACHE_LINE);
+	layout->size = layout->slots + capacity * layout->slot_size;
+
+	return true;
+}
+
+struct save_arg {
+	hashmap_s *hashmap;
+	unsigned char *used;
+	uint64_t *hashes;
+	unsigned char *slots;
+	const struct file_layout *layout;
+	unsigned int capacity_bits;
+	size_t count; /**< Entries written */
+};
+
+static bool save_entry(bucket_s *bucket, void *arg) {
+	struct save_arg *sa = arg;
+	size_t mask = ((size_t)1 << sa->capacity_bits) - 1;
+
+	size_t i = hash_index(bucket->hash, sa->capacity_bits);
+	while (sa->used[i] != 0) {
+		i = (i + 1) & mask;
+	}
+
+	unsigned char *slot = sa->slots + i * sa->layout->slot_size;
+	sa->used[i] = 1;
+	sa->hashes[i] = bucket->hash;
+	memcpy(slot, bucket->key, sa->hashmap->key_size);
+	memcpy(slot + sa->layout->value_offset, bucket->value, sa->hashmap->value_size);
+	sa->count++;
+
+	return true;
+}
+
+/*
+ * @brief Build the snapshot image of a map. All stripe locks must be held.
+ * @return The zero-padded image, NULL on failure.
+ */
+static unsigned char *build_image(hashmap_s *hashmap, size_t *size) {
+	size_t count = atomic_load(&hashmap->size);
+
+	/* At most half full keeps the probes short */
+	unsigned int bits = FILE_MIN_BITS;
+	while (bits < sizeof(size_t) * 8 - 1 && ((size_t)1 << bits) / 2 < count) {
+		bits++;
+	}
+
+	struct file_layout layout;
+	if (!file_layout(hashmap->key_size, hashmap->value_size, bits, &layout)) {
+		return NULL;
+	}
+
+	unsigned char *image = calloc(1, layout.size);
+	if (image == NULL) {
+		return NULL;
+	}
+
+	struct save_arg arg = {
+		.hashmap = hashmap,
+		.used = image + layout.used,
+		.hashes = (uint64_t *)(image + layout.hashes),
+		.slots = image + layout.slots,
+		.layout = &layout,
+		.capacity_bits = bits,
+		.count = 0,
+	};
+	hm_walk_all(hashmap, save_entry, &arg);
+
+	/* Expired cache entries are skipped, so the count comes from the walk */
+	struct file_header header = {
+		.version = MYCLIB_HASHMAP_FILE_VERSION,
+		.key_type = (uint32_t)hashmap->key_type,
+		.byte_order = FILE_BYTE_ORDER,
+		.key_size = hashmap->key_size,
+		.value_size = hashmap->value_size,
+		.count = arg.count,
+		.capacity_bits = bits,
+		.used_offset = layout.used,
+		.hashes_offset = layout.hashes,
+		.slots_offset = layout.slots,
+		.file_size = layout.size,
+	};
+	memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+	memcpy(image, &header, sizeof(header));
+
+	*size = layout.size;
+
+	return image;
+}
+
+bool hm_save(hashmap_s *hashmap, const char *path) {
+	if (hashmap == NULL || hashmap->variable || path == NULL) {
+		return false;
+	}
+
+	lock_all(hashmap);
+	size_t size = 0;
+	unsigned char *image = build_image(hashmap, &size);
+	unlock_all(hashmap);
+
+	if (image == NULL) {
+		return false;
+	}
+
+	size_t path_len = strlen(path);
+	char *tmp_path = malloc(path_len + sizeof(".tmp"));
+	if (tmp_path == NULL) {
+		free(image);
+		return false;
+	}
+	memcpy(tmp_path, path, path_len);
+	memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+
+	bool written = false;
+	FILE *file = fopen(tmp_path, "wb");
+	if (file != NULL) {
+		written = fwrite(image, 1, size, file) == size;
+		written = fclose(file) == 0 && written;
+	}
+	free(image);
+
+#ifdef _WIN32
+	/* rename() does not replace an existing file there */
+	if (written) {
+		remove(path);
+	}
+#endif
+	if (!written || rename(tmp_path, path) != 0) {
+		remove(tmp_path);
+		free(tmp_path);
+		return false;
+	}
+
+	free(tmp_path);
+
+	return true;
+}
+
+/*
+ * @brief Map a whole file read-only. Without mmap() it is read into memory instead.
+ * @return true on success.
+ */
+static bool map_file(const char *path, void **base, size_t *length) {
+#ifdef _WIN32
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	long size = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		size = ftell(file);
+	}
+	if (size <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		return false;
+	}
+
+	*base = malloc((size_t)size);
+	if (*base == NULL || fread(*base, 1, (size_t)size, file) != (size_t)size) {
+		free(*base);
+		fclose(file);
+		return false;
+	}
+	fclose(file);
+	*length = (size_t)size;
+
+	return true;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uintmax_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return false;
+	}
+
+	void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+
+	*base = addr;
+	*length = (size_t)st.st_size;
+
+	return true;
+#endif
+}
+
+static void unmap_file(void *base, size_t length) {
+#ifdef _WIN32
+	(void)length;
+	free(base);
+#else
+	munmap(base, length);
+#endif
+}
+
+/*
+ * @brief Check a file header against the expected key handling and the actual file size.
+ * @return true if the rest of the file can be trusted to have the described layout.
+ */
+static bool check_header(const struct file_header *header, const hm_config_s *config,
+						 size_t length, struct file_layout *layout) {
+	if (memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != MYCLIB_HASHMAP_FILE_VERSION || header->byte_order != FILE_BYTE_ORDER) {
+		return false;
+	}
+
+	if (header->key_type != (uint32_t)config->key_type || header->key_size != config->key_size ||
+		header->value_size != config->value_size || header->capacity_bits < FILE_MIN_BITS ||
+		header->capacity_bits >= sizeof(size_t) * 8) {
+		return false;
+	}
+
+	if (!file_layout(config->key_size, config->value_size, (unsigned int)header->capacity_bits,
+					 layout)) {
+		return false;
+	}
+
+	return header->used_offset == layout->used && header->hashes_offset == layout->hashes &&
+		   header->slots_offset == layout->slots && header->file_size == layout->size &&
+		   layout->size == length && header->count < ((uint64_t)1 << header->capacity_bits);
+}
+
+hm_mapped_s *hm_open_mapped(const char *path, const hm_config_s *config) {
+	if (path == NULL || config == NULL || config->variable || config->key_size == 0 ||
+		config->value_size == 0) {
+		return NULL;
+	}
+
+	if (config->key_type == HM_KEY_CUSTOM && (config->hash == NULL || config->equal == NULL)) {
+		return NULL;
+	}
+
+	void *base;
+	size_t length;
+	if (!map_file(path, &base, &length)) {
+		return NULL;
+	}
+
+	struct file_header header;
+	struct file_layout layout;
+	hm_mapped_s *mapped = NULL;
+
+	if (length >= sizeof(header)) {
+		memcpy(&header, base, sizeof(header));
+		if (check_header(&header, config, length, &layout)) {
+			mapped = malloc(sizeof(hm_mapped_s));
+		}
+	}
+
+	if (mapped == NULL) {
+		unmap_file(base, length);
+		return NULL;
+	}
+
+	const unsigned char *bytes = base;
+	*mapped = (hm_mapped_s){
+		.key_type = config->key_type,
+		.hash = config->hash,
+		.equal = config->equal,
+		.key_size = config->key_size,
+		.value_size = config->value_size,
+		.value_offset = layout.value_offset,
+		.slot_size = layout.slot_size,
+		.count = (size_t)header.count,
+		.capacity = (size_t)1 << header.capacity_bits,
+		.capacity_bits = (unsigned int)header.capacity_bits,
+		.used = bytes + layout.used,
+		.hashes = (const uint64_t *)(bytes + layout.hashes),
+		.slots = bytes + layout.slots,
+		.base = base,
+		.length = length,
+	};
+
+	return mapped;
+}
+
+const void *hm_mapped_get(const hm_mapped_s *mapped, const void *key) {
+	if (mapped == NULL || key == NULL) {
+		return NULL;
+	}
+
+	uint64_t hash = hash_key_typed(mapped->key_type, mapped->hash, mapped->key_size, key);
+	size_t mask = mapped->capacity - 1;
+	size_t i = hash_index(hash, mapped->capacity_bits);
+
+	/* Bounded even if a corrupted file has no empty slot left */
+	for (size_t probes = 0; probes < mapped->capacity && mapped->used[i] != 0; ++probes) {
+		if (mapped->hashes[i] == hash) {
+			const unsigned char *slot = mapped->slots + i * mapped->slot_size;
+			if (key_equal_typed(mapped->key_type, mapped->equal, mapped->key_size, slot, key)) {
+				return slot + mapped->value_offset;
+			}
+		}
+		i = (i + 1) & mask;
+	}
+
+	return NULL;
+}
+
+size_t hm_mapped_size(const hm_mapped_s *mapped) {
+	if (mapped == NULL) {
+		return 0;
+	}
+
+	return mapped->count;
+}
+
+void hm_mapped_close(hm_mapped_s *mapped) {
+	if (mapped == NULL) {
+		return;
+	}
+
+	unmap_file(mapped->base, mapped->length);
+	free(mapped);
+}
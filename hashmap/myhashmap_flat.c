@@ -0,0 +1,360 @@
+#include "myhashmap_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**< Largest probe distance a meta byte can hold (meta is distance + 1) */
+#define MAX_DIST 254
+
+/**< Smallest segment capacity */
+#define MIN_SEGMENT 8
+
+/*
+ * @brief Returns the preferred slot of a hash.
+ *
+ * The top bits of the hash already select the stripe, so the slot is taken from the low bits.
+ */
+static inline size_t home_slot(const hm_segment_s *segment, uint64_t hash) {
+	return (size_t)hash & (segment->capacity - 1);
+}
+
+static inline unsigned char *slot_at(hashmap_s *hashmap, const hm_segment_s *segment,
+									 size_t index) {
+	return segment->slots + index * hashmap->slot_size;
+}
+
+static bool alloc_segment(hashmap_s *hashmap, hm_segment_s *segment, size_t capacity) {
+	if (capacity > SIZE_MAX / sizeof(uint64_t)) {
+		return false;
+	}
+
+	segment->meta = calloc(capacity, 1);
+	if (segment->meta == NULL) {
+		return false;
+	}
+
+	segment->hashes = malloc(capacity * sizeof(uint64_t));
+	segment->slots = malloc(capacity * hashmap->slot_size);
+	if (segment->hashes == NULL || segment->slots == NULL) {
+		free(segment->meta);
+		free(segment->hashes);
+		free(segment->slots);
+		segment->meta = NULL;
+		segment->hashes = NULL;
+		segment->slots = NULL;
+		return false;
+	}
+
+	segment->capacity = capacity;
+	segment->count = 0;
+
+	return true;
+}
+
+static void free_segment(hm_segment_s *segment) {
+	free(segment->meta);
+	free(segment->hashes);
+	free(segment->slots);
+	segment->meta = NULL;
+	segment->hashes = NULL;
+	segment->slots = NULL;
+	segment->capacity = 0;
+	segment->count = 0;
+}
+
+/*
+ * @brief Returns the index of the slot holding a key, or SIZE_MAX.
+ */
+static size_t find_index(hashmap_s *hashmap, const hm_segment_s *segment, uint64_t hash,
+						 const void *key) {
+	size_t mask = segment->capacity - 1;
+	size_t pos = home_slot(segment, hash);
+
+	/* An entry farther from its home than we are from ours means the key is absent */
+	for (unsigned int dist = 0; segment->meta[pos] > dist; ++dist) {
+		/* Same distance at the same position means same home slot, then the full hash decides */
+		if (segment->meta[pos] == dist + 1 && segment->hashes[pos] == hash &&
+			key_equal(hashmap, slot_at(hashmap, segment, pos), key)) {
+			return pos;
+		}
+		pos = (pos + 1) & mask;
+	}
+
+	return SIZE_MAX;
+}
+
+/*
+ * @brief Place a new entry without checking for duplicates.
+ *
+ * Robin Hood insertion: the entry takes the first slot whose occupant sits closer to its home,
+ * and the rest of the run moves one slot forward.
+ * @return false if a probe distance would no longer fit in a meta byte.
+ */
+static bool insert_slot(hashmap_s *hashmap, hm_segment_s *segment, uint64_t hash,
+						const void *key, const void *value) {
+	size_t mask = segment->capacity - 1;
+	size_t pos = home_slot(segment, hash);
+	unsigned int dist = 0;
+
+	while (segment->meta[pos] != 0 && segment->meta[pos] - 1u >= dist) {
+		++dist;
+		pos = (pos + 1) & mask;
+	}
+	if (dist > MAX_DIST) {
+		return false;
+	}
+
+	size_t end = pos;
+	while (segment->meta[end] != 0) {
+		if (segment->meta[end] > MAX_DIST) {
+			return false;
+		}
+		end = (end + 1) & mask;
+	}
+
+	/* Shift the run [pos, end) one slot forward */
+	while (end != pos) {
+		size_t prev = (end - 1) & mask;
+		memcpy(slot_at(hashmap, segment, end), slot_at(hashmap, segment, prev),
+			   hashmap->slot_size);
+		segment->meta[end] = (unsigned char)(segment->meta[prev] + 1);
+		segment->hashes[end] = segment->hashes[prev];
+		end = prev;
+	}
+
+	unsigned char *slot = slot_at(hashmap, segment, pos);
+	memcpy(slot, key, hashmap->key_size);
+	memcpy(slot + hashmap->value_offset, value, hashmap->value_size);
+	segment->meta[pos] = (unsigned char)(dist + 1);
+	segment->hashes[pos] = hash;
+	segment->count++;
+
+	return true;
+}
+
+/*
+ * @brief Move every entry of a segment into an empty, larger one, reusing the cached hashes.
+ */
+static bool rehash_into(hashmap_s *hashmap, const hm_segment_s *from, hm_segment_s *to) {
+	for (size_t i = 0; i < from->capacity; ++i) {
+		if (from->meta[i] == 0) {
+			continue;
+		}
+
+		unsigned char *slot = slot_at(hashmap, from, i);
+		if (!insert_slot(hashmap, to, from->hashes[i], slot,
+						 slot + hashmap->value_offset)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * @brief Move a segment into a table of at least capacity slots.
+ */
+static bool resize_segment(hashmap_s *hashmap, hm_segment_s *segment, size_t capacity) {
+	for (;;) {
+		hm_segment_s bigger;
+		if (!alloc_segment(hashmap, &bigger, capacity)) {
+			return false;
+		}
+
+		if (rehash_into(hashmap, segment, &bigger)) {
+			free_segment(segment);
+			*segment = bigger;
+			return true;
+		}
+
+		/* Pathological clustering, try an even larger table */
+		free_segment(&bigger);
+		if (capacity > SIZE_MAX / 2 / hashmap->slot_size) {
+			return false;
+		}
+		capacity *= 2;
+	}
+}
+
+static bool grow_segment(hashmap_s *hashmap, hm_segment_s *segment) {
+	if (segment->capacity > SIZE_MAX / 2 / hashmap->slot_size) {
+		return false;
+	}
+
+	return resize_segment(hashmap, segment, segment->capacity * 2);
+}
+
+bool hm_flat_init(hashmap_s *hashmap, size_t capacity) {
+	slot_layout(hashmap->key_size, hashmap->value_size, &hashmap->value_offset,
+				&hashmap->slot_size);
+
+	size_t per_segment = MIN_SEGMENT;
+	while (per_segment < capacity / hashmap->num_locks) {
+		per_segment <<= 1;
+	}
+
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		if (!alloc_segment(hashmap, &hashmap->locks[i].segment, per_segment)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void hm_flat_destroy(hashmap_s *hashmap) {
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		free_segment(&hashmap->locks[i].segment);
+	}
+}
+
+unsigned char *hm_flat_find(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash,
+							const void *key) {
+	size_t index = find_index(hashmap, &stripe->segment, hash, key);
+	if (index == SIZE_MAX) {
+		return NULL;
+	}
+
+	return slot_at(hashmap, &stripe->segment, index);
+}
+
+void hm_flat_prefetch(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash) {
+	size_t pos = home_slot(&stripe->segment, hash);
+
+	HM_PREFETCH(&stripe->segment.meta[pos]);
+	HM_PREFETCH(&stripe->segment.hashes[pos]);
+	HM_PREFETCH(slot_at(hashmap, &stripe->segment, pos));
+}
+
+int hm_flat_set(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash, const void *key,
+				const void *value) {
+	hm_segment_s *segment = &stripe->segment;
+
+	size_t index = find_index(hashmap, segment, hash, key);
+	if (index != SIZE_MAX) {
+		memcpy(slot_at(hashmap, segment, index) + hashmap->value_offset, value,
+			   hashmap->value_size);
+		return 0;
+	}
+
+	if (segment->count + 1 >
+		segment->capacity / MYCLIB_HASHMAP_FLAT_LOAD_DEN * MYCLIB_HASHMAP_FLAT_LOAD_NUM) {
+		if (!grow_segment(hashmap, segment)) {
+			return -1;
+		}
+	}
+
+	while (!insert_slot(hashmap, segment, hash, key, value)) {
+		if (!grow_segment(hashmap, segment)) {
+			return -1;
+		}
+	}
+
+	return 1;
+}
+
+bool hm_flat_reserve(hashmap_s *hashmap, hm_stripe_s *stripe, size_t count) {
+	hm_segment_s *segment = &stripe->segment;
+	size_t capacity = segment->capacity;
+
+	while (count > capacity / MYCLIB_HASHMAP_FLAT_LOAD_DEN * MYCLIB_HASHMAP_FLAT_LOAD_NUM) {
+		if (capacity > SIZE_MAX / 2 / hashmap->slot_size) {
+			return false;
+		}
+		capacity *= 2;
+	}
+
+	return capacity == segment->capacity || resize_segment(hashmap, segment, capacity);
+}
+
+bool hm_flat_remove(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash, const void *key) {
+	hm_segment_s *segment = &stripe->segment;
+
+	size_t index = find_index(hashmap, segment, hash, key);
+	if (index == SIZE_MAX) {
+		return false;
+	}
+
+	/* Backward shift: pull the rest of the run one slot closer to home */
+	size_t mask = segment->capacity - 1;
+	size_t next = (index + 1) & mask;
+	while (segment->meta[next] > 1) {
+		memcpy(slot_at(hashmap, segment, index), slot_at(hashmap, segment, next),
+			   hashmap->slot_size);
+		segment->meta[index] = (unsigned char)(segment->meta[next] - 1);
+		segment->hashes[index] = segment->hashes[next];
+		index = next;
+		next = (next + 1) & mask;
+	}
+
+	segment->meta[index] = 0;
+	segment->count--;
+
+	return true;
+}
+
+void hm_flat_clear(hashmap_s *hashmap) {
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		hm_segment_s *segment = &hashmap->locks[i].segment;
+		memset(segment->meta, 0, segment->capacity);
+		segment->count = 0;
+	}
+}
+
+bool hm_flat_walk(hashmap_s *hashmap, hm_stripe_s *stripe, hm_walk_f *fn, void *arg) {
+	hm_segment_s *segment = &stripe->segment;
+
+	for (size_t i = 0; i < segment->capacity; ++i) {
+		if (segment->meta[i] == 0) {
+			continue;
+		}
+
+		unsigned char *slot = slot_at(hashmap, segment, i);
+		bucket_s view = {
+			.key = slot,
+			.value = slot + hashmap->value_offset,
+			.next = NULL,
+			.hash = segment->hashes[i],
+		};
+		if (!fn(&view, arg)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bucket_s *hm_flat_next(hashmap_s *hashmap, hm_stripe_s *stripe, size_t *index, bucket_s *view) {
+	hm_segment_s *segment = &stripe->segment;
+
+	for (size_t i = *index; i < segment->capacity; ++i) {
+		if (segment->meta[i] == 0) {
+			continue;
+		}
+
+		unsigned char *slot = slot_at(hashmap, segment, i);
+		*view = (bucket_s){
+			.key = slot,
+			.value = slot + hashmap->value_offset,
+			.next = NULL,
+			.hash = segment->hashes[i],
+		};
+		*index = i + 1;
+		return view;
+	}
+
+	*index = segment->capacity;
+	return NULL;
+}
+
+void hm_flat_stats(const hm_stripe_s *stripe, hm_stats_s *stats) {
+	const hm_segment_s *segment = &stripe->segment;
+
+	stats->capacity += segment->capacity;
+	stats->used_buckets += segment->count;
+	for (size_t i = 0; i < segment->capacity; ++i) {
+		if (segment->meta[i] != 0) {
+			stats_add_probe(stats, segment->meta[i]);
+		}
+	}
+}
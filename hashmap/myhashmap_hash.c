@@ -0,0 +1,146 @@
+#include "myhashmap_internal.h"
+
+#include <string.h>
+
+/*
+ * Multiply-mix byte hash in the style of wyhash (public domain, Wang Yi): every step folds the
+ * 128-bit product of two 64-bit words, which spreads each input bit over the whole output.
+ */
+
+static const uint64_t secret[4] = {
+	0x2d358dccaa6c78a5ULL,
+	0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL,
+	0x4d5a2da51de1aa47ULL,
+};
+
+/*
+ * @brief Full 64x64 -> 128 bit multiply: *a receives the low half, *b the high half.
+ */
+static inline void mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 u128;
+	u128 r = (u128)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32;
+	uint64_t hb = *b >> 32;
+	uint64_t la = (uint32_t)*a;
+	uint64_t lb = (uint32_t)*b;
+	uint64_t rh = ha * hb;
+	uint64_t rm0 = ha * lb;
+	uint64_t rm1 = hb * la;
+	uint64_t rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t carry = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	carry += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static inline uint64_t mum_mix(uint64_t a, uint64_t b) {
+	mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read32(const unsigned char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * @brief Read 1 to 3 bytes: first, middle and last.
+ */
+static inline uint64_t read_small(const unsigned char *p, size_t len) {
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+uint64_t hm_hash_bytes(const void *data, size_t len, uint64_t seed) {
+	const unsigned char *p = data;
+	uint64_t a = 0;
+	uint64_t b = 0;
+
+	seed ^= mum_mix(seed ^ secret[0], secret[1]);
+
+	if (len <= 16) {
+		if (len >= 4) {
+			/* Two overlapping 4-byte reads from each end cover 4 to 16 bytes */
+			size_t mid = (len >> 3) << 2;
+			a = (read32(p) << 32) | read32(p + mid);
+			b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+		} else if (len > 0) {
+			a = read_small(p, len);
+		}
+	} else {
+		size_t left = len;
+		if (left > 48) {
+			/* Three independent lanes keep the multipliers busy */
+			uint64_t seed1 = seed;
+			uint64_t seed2 = seed;
+			do {
+				seed = mum_mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+				seed1 = mum_mix(read64(p + 16) ^ secret[2], read64(p + 24) ^ seed1);
+				seed2 = mum_mix(read64(p + 32) ^ secret[3], read64(p + 40) ^ seed2);
+				p += 48;
+				left -= 48;
+			} while (left > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (left > 16) {
+			seed = mum_mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+			p += 16;
+			left -= 16;
+		}
+		/* The last 16 bytes, overlapping what was already consumed */
+		a = read64(p + left - 16);
+		b = read64(p + left - 8);
+	}
+
+	a ^= secret[1];
+	b ^= seed;
+	mum(&a, &b);
+
+	return mum_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+uint64_t hm_hash_int(uint64_t x) {
+	return mix_hash(x);
+}
+
+uint64_t hm_hash_u32(const void *key) {
+	uint32_t v;
+	memcpy(&v, key, sizeof(v));
+	return mix_hash(v);
+}
+
+uint64_t hm_hash_u64(const void *key) {
+	uint64_t v;
+	memcpy(&v, key, sizeof(v));
+	return mix_hash(v);
+}
+
+uint64_t hm_hash_str(const void *key) {
+	return hm_hash_bytes(key, strlen(key), 0);
+}
+
+bool hm_equal_u32(const void *key_a, const void *key_b) {
+	return memcmp(key_a, key_b, sizeof(uint32_t)) == 0;
+}
+
+bool hm_equal_u64(const void *key_a, const void *key_b) {
+	return memcmp(key_a, key_b, sizeof(uint64_t)) == 0;
+}
+
+bool hm_equal_str(const void *key_a, const void *key_b) {
+	return strcmp(key_a, key_b) == 0;
+}
@@ -0,0 +1,504 @@
+#ifndef MYCLIB_HASHMAP_INTERNAL_H
+#define MYCLIB_HASHMAP_INTERNAL_H
+
+/*
+ * Helpers shared by the hash map backends. Not installed.
+ */
+
+#include "myhashmap.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * @brief Callback used to walk the entries of a map, stops the walk when returning false.
+ */
+typedef bool hm_walk_f(bucket_s *bucket, void *arg);
+
+/*
+ * @brief Spread a user hash over all 64 bits.
+ *
+ * Stripes and buckets are picked from the top bits and flat slots from the low bits, so the
+ * user hash is mixed first to make every bit depend on all of it.
+ */
+static inline uint64_t mix_hash(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+/*
+ * @brief Returns the length of a string key, bounded by its buffer size.
+ */
+static inline size_t string_key_len(const void *key, size_t key_size) {
+	const char *end = memchr(key, '\0', key_size);
+	return end != NULL ? (size_t)(end - (const char *)key) : key_size;
+}
+
+/*
+ * @brief Hash a key with the function of its key type, as returned by hm_hash().
+ */
+static inline uint64_t user_hash_typed(hm_key_e key_type, hash_f *hash, size_t key_size,
+									   const void *key) {
+	switch (key_type) {
+	case HM_KEY_BYTES:
+		return hm_hash_bytes(key, key_size, 0);
+	case HM_KEY_STRING:
+		return hm_hash_bytes(key, string_key_len(key, key_size), 0);
+	default:
+		return hash(key);
+	}
+}
+
+/*
+ * @brief Turn a hash from user_hash_typed() into the hash that picks stripes and buckets.
+ *
+ * Built-in hashes are already well-distributed and skip the extra mix.
+ */
+static inline uint64_t finish_hash(hm_key_e key_type, uint64_t hash) {
+	return key_type == HM_KEY_CUSTOM ? mix_hash(hash) : hash;
+}
+
+/*
+ * @brief Hash a key according to its key type.
+ */
+static inline uint64_t hash_key_typed(hm_key_e key_type, hash_f *hash, size_t key_size,
+									  const void *key) {
+	return finish_hash(key_type, user_hash_typed(key_type, hash, key_size, key));
+}
+
+/*
+ * @brief Compare two keys according to their key type.
+ */
+static inline bool key_equal_typed(hm_key_e key_type, equal_f *equal, size_t key_size,
+								   const void *key_a, const void *key_b) {
+	switch (key_type) {
+	case HM_KEY_BYTES:
+		return memcmp(key_a, key_b, key_size) == 0;
+	case HM_KEY_STRING:
+		return strncmp(key_a, key_b, key_size) == 0;
+	default:
+		return equal(key_a, key_b);
+	}
+}
+
+/*
+ * @brief Hash a key with the map hash function.
+ */
+static inline uint64_t hash_key(hashmap_s *hashmap, const void *key) {
+	return hash_key_typed(hashmap->key_type, hashmap->hash, hashmap->key_size, key);
+}
+
+/*
+ * @brief A key or value of a variable-mode map, as given by the caller.
+ */
+typedef struct hm_blob {
+	const void *data; /**< First byte */
+	size_t len;		  /**< Length in bytes */
+} hm_blob_s;
+
+/**< Bytes of the length stored in front of every key and value of a variable-mode map */
+#define HM_VAR_PREFIX sizeof(uint32_t)
+
+/*
+ * @brief Returns the length stored in front of a variable-length key or value.
+ */
+static inline size_t var_len(const void *data) {
+	uint32_t len;
+	memcpy(&len, (const unsigned char *)data - HM_VAR_PREFIX, sizeof(len));
+	return len;
+}
+
+/*
+ * @brief Compare a stored key (key_a) with a key being looked up (key_b).
+ *
+ * In variable mode the key looked up is an hm_blob_s.
+ */
+static inline bool key_equal(hashmap_s *hashmap, const void *key_a, const void *key_b) {
+	if (hashmap->variable) {
+		const hm_blob_s *blob = key_b;
+		return var_len(key_a) == blob->len && memcmp(key_a, blob->data, blob->len) == 0;
+	}
+
+	return key_equal_typed(hashmap->key_type, hashmap->equal, hashmap->key_size, key_a, key_b);
+}
+
+/*
+ * @brief Natural alignment of a blob: its lowest set bit, capped to max_align_t.
+ */
+static inline size_t blob_align(size_t size) {
+	size_t align = size & (~size + 1);
+	if (align > _Alignof(max_align_t)) {
+		align = _Alignof(max_align_t);
+	}
+
+	return align;
+}
+
+static inline size_t round_up(size_t n, size_t align) {
+	return (n + align - 1) / align * align;
+}
+
+/*
+ * @brief Layout of an inline entry: the key, then the value at its natural alignment.
+ */
+static inline void slot_layout(size_t key_size, size_t value_size, size_t *value_offset,
+							   size_t *slot_size) {
+	size_t align = blob_align(key_size);
+	if (blob_align(value_size) > align) {
+		align = blob_align(value_size);
+	}
+
+	*value_offset = round_up(key_size, blob_align(value_size));
+	*slot_size = round_up(*value_offset + value_size, align);
+}
+
+/*
+ * @brief Allocate zeroed memory starting on a cache line boundary.
+ */
+static inline void *cache_aligned_calloc(size_t size) {
+	size = (size + MYCLIB_HASHMAP_CACHE_LINE - 1) / MYCLIB_HASHMAP_CACHE_LINE *
+		   MYCLIB_HASHMAP_CACHE_LINE;
+#ifdef _WIN32
+	void *ptr = _aligned_malloc(size, MYCLIB_HASHMAP_CACHE_LINE);
+#else
+	void *ptr = aligned_alloc(MYCLIB_HASHMAP_CACHE_LINE, size);
+#endif
+	if (ptr != NULL) {
+		memset(ptr, 0, size);
+	}
+
+	return ptr;
+}
+
+static inline void cache_aligned_free(void *ptr) {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+/*
+ * @brief Returns the top bits of a hash, i.e. its index in a table of 1 << bits entries.
+ *
+ * Indexing by the top bits keeps ranges nested: when a table doubles, bucket i splits into
+ * buckets 2i and 2i + 1, so a stripe keeps owning the same contiguous range of the keyspace.
+ */
+static inline size_t hash_index(uint64_t hash, unsigned int bits) {
+	return bits == 0 ? 0 : (size_t)(hash >> (64 - bits));
+}
+
+/*
+ * @brief Returns the stripe protecting a given hash.
+ */
+static inline hm_stripe_s *get_stripe(hashmap_s *hashmap, uint64_t hash) {
+	return &hashmap->locks[hash_index(hash, hashmap->lock_bits)];
+}
+
+/* Hint the CPU to start loading an address, where the compiler supports it */
+#if defined(__GNUC__) || defined(__clang__)
+#define HM_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HM_PREFETCH(addr) ((void)(addr))
+#endif
+
+/* Bump a stripe counter, compiled out unless MYCLIB_HASHMAP_STATS is defined */
+#ifdef MYCLIB_HASHMAP_STATS
+#define HM_STAT_INC(counter) atomic_fetch_add_explicit(&(counter), 1, memory_order_relaxed)
+#else
+#define HM_STAT_INC(counter) ((void)0)
+#endif
+
+/* Reader-writer stripe state: reader count in the low bits plus two flags */
+#define HM_RW_WRITER 0x80000000u  /**< A writer owns the stripe */
+#define HM_RW_PENDING 0x40000000u /**< A writer is waiting, new readers back off */
+
+/*
+ * @brief Lock the mutex of a stripe (HM_LOCK_MUTEX).
+ * @return true on success.
+ */
+static inline bool stripe_mutex_lock(hm_stripe_s *stripe) {
+#ifdef MYCLIB_HASHMAP_STATS
+	int res = mtx_trylock(&stripe->lock);
+	if (res == thrd_busy) {
+		HM_STAT_INC(stripe->contended);
+		res = mtx_lock(&stripe->lock);
+	}
+	if (res != thrd_success) {
+		return false;
+	}
+	HM_STAT_INC(stripe->acquired);
+
+	return true;
+#else
+	return mtx_lock(&stripe->lock) == thrd_success;
+#endif
+}
+
+/*
+ * @brief Lock a stripe for writing.
+ * @return true on success.
+ */
+static inline bool stripe_lock(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->lock_mode == HM_LOCK_MUTEX) {
+		return stripe_mutex_lock(stripe);
+	}
+
+	HM_STAT_INC(stripe->acquired);
+	for (bool waited = false;; waited = true) {
+		unsigned int state = atomic_load_explicit(&stripe->rw, memory_order_relaxed);
+
+		if ((state & ~HM_RW_PENDING) == 0) {
+			/* No reader and no writer: take it, clearing our pending flag */
+			if (atomic_compare_exchange_weak_explicit(&stripe->rw, &state, HM_RW_WRITER,
+													  memory_order_acquire,
+													  memory_order_relaxed)) {
+				return true;
+			}
+			continue;
+		}
+
+		if (!waited) {
+			HM_STAT_INC(stripe->contended);
+		}
+		if ((state & (HM_RW_WRITER | HM_RW_PENDING)) == 0) {
+			/* Readers inside: stop new ones from coming in */
+			atomic_fetch_or_explicit(&stripe->rw, HM_RW_PENDING, memory_order_relaxed);
+		}
+		thrd_yield();
+	}
+}
+
+static inline void stripe_unlock(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->lock_mode == HM_LOCK_MUTEX) {
+		mtx_unlock(&stripe->lock);
+		return;
+	}
+
+	atomic_fetch_and_explicit(&stripe->rw, ~HM_RW_WRITER, memory_order_release);
+}
+
+/*
+ * @brief Lock a stripe for reading. Readers share it in HM_LOCK_RWLOCK mode.
+ * @return true on success.
+ */
+static inline bool stripe_lock_shared(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->lock_mode == HM_LOCK_MUTEX) {
+		return stripe_mutex_lock(stripe);
+	}
+
+	HM_STAT_INC(stripe->acquired);
+	for (bool waited = false;; waited = true) {
+		unsigned int state = atomic_fetch_add_explicit(&stripe->rw, 1, memory_order_acquire);
+		if ((state & (HM_RW_WRITER | HM_RW_PENDING)) == 0) {
+			return true;
+		}
+
+		if (!waited) {
+			HM_STAT_INC(stripe->contended);
+		}
+
+		/* A writer owns or wants the stripe: step back until it is done */
+		atomic_fetch_sub_explicit(&stripe->rw, 1, memory_order_relaxed);
+		while ((atomic_load_explicit(&stripe->rw, memory_order_relaxed) &
+				(HM_RW_WRITER | HM_RW_PENDING)) != 0) {
+			thrd_yield();
+		}
+	}
+}
+
+static inline void stripe_unlock_shared(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->lock_mode == HM_LOCK_MUTEX) {
+		mtx_unlock(&stripe->lock);
+		return;
+	}
+
+	atomic_fetch_sub_explicit(&stripe->rw, 1, memory_order_release);
+}
+
+static inline void lock_all(hashmap_s *hashmap) {
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		stripe_lock(hashmap, &hashmap->locks[i]);
+	}
+}
+
+static inline void unlock_all(hashmap_s *hashmap) {
+	for (size_t i = 0; i < hashmap->num_locks; ++i) {
+		stripe_unlock(hashmap, &hashmap->locks[i]);
+	}
+}
+
+/*
+ * @brief A chained entry of a map in cache mode, linked in the recency list of its stripe.
+ */
+typedef struct hm_cache_node {
+	bucket_s bucket;			 /**< Chain entry (must be first) */
+	struct hm_cache_node *newer; /**< Neighbour towards the most recently used end */
+	struct hm_cache_node *older; /**< Neighbour towards the eviction end */
+	uint64_t expires;			 /**< Expiry time in ms on the monotonic clock, 0 for never */
+	atomic_bool referenced;		 /**< Used since the CLOCK hand last passed (HM_EVICT_CLOCK) */
+} hm_cache_node_s;
+
+/*
+ * @brief Size of the header allocated in front of every chained entry.
+ */
+static inline size_t bucket_header_size(hashmap_s *hashmap) {
+	return hashmap->cache ? sizeof(hm_cache_node_s) : sizeof(bucket_s);
+}
+
+/*
+ * @brief Lock a stripe for a lookup: exclusively when the lookup moves entries in an LRU list.
+ *
+ * Only bounded caches move entries on a hit, unbounded ones keep their list for expiry sweeps.
+ */
+static inline bool stripe_lock_lookup(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->stripe_max != 0 && hashmap->eviction == HM_EVICT_LRU) {
+		return stripe_lock(hashmap, stripe);
+	}
+
+	return stripe_lock_shared(hashmap, stripe);
+}
+
+static inline void stripe_unlock_lookup(hashmap_s *hashmap, hm_stripe_s *stripe) {
+	if (hashmap->stripe_max != 0 && hashmap->eviction == HM_EVICT_LRU) {
+		stripe_unlock(hashmap, stripe);
+		return;
+	}
+
+	stripe_unlock_shared(hashmap, stripe);
+}
+
+/* Slab pool (myhashmap_pool.c). The stripe lock of the pool must be held. */
+
+/*
+ * @brief Offset of the key inside a pool node, right after its bucket header.
+ */
+static inline size_t pool_key_offset(hashmap_s *hashmap) {
+	return round_up(bucket_header_size(hashmap), _Alignof(max_align_t));
+}
+
+/*
+ * @brief Take a node of node_size bytes (a multiple of max_align_t) from a pool.
+ * @return The node, or NULL on allocation failure.
+ */
+void *hm_pool_alloc(hm_pool_s *pool, size_t node_size);
+
+/*
+ * @brief Return a node to the freelist of its pool.
+ */
+void hm_pool_free(hm_pool_s *pool, void *node);
+
+/*
+ * @brief Release every slab of a pool at once, invalidating all of its nodes.
+ */
+void hm_pool_release(hm_pool_s *pool);
+
+/*
+ * @brief Count one entry of a given probe length in the histogram of hm_stats().
+ */
+static inline void stats_add_probe(hm_stats_s *stats, size_t probe) {
+	size_t bin = probe <= MYCLIB_HASHMAP_STATS_BINS ? probe - 1 : MYCLIB_HASHMAP_STATS_BINS - 1;
+	stats->probes[bin]++;
+	if (probe > stats->max_probe) {
+		stats->max_probe = probe;
+	}
+}
+
+/* Blob arena (myhashmap_pool.c). The stripe lock of the arena must be held. */
+
+/*
+ * @brief Allocate a blob of size bytes, aligned at least for a pointer.
+ * @return The blob, or NULL on allocation failure.
+ */
+void *hm_arena_alloc(hm_arena_s *arena, size_t size);
+
+/*
+ * @brief Give back a blob, with the size it was allocated with.
+ */
+void hm_arena_free(hm_arena_s *arena, void *blob, size_t size);
+
+/*
+ * @brief Release every chunk of an arena at once, invalidating all of its blobs.
+ */
+void hm_arena_release(hm_arena_s *arena);
+
+/*
+ * @brief Call a function on every entry: both tables when chained, every segment when flat.
+ *
+ * Must be called with all stripe locks held. Stops early when fn returns false.
+ */
+void hm_walk_all(hashmap_s *hashmap, hm_walk_f *fn, void *arg);
+
+/* Flat backend (myhashmap_flat.c). Unless stated otherwise the stripe lock must be held. */
+
+/*
+ * @brief Compute the slot layout and allocate every segment.
+ * @return true on success.
+ */
+bool hm_flat_init(hashmap_s *hashmap, size_t capacity);
+
+/*
+ * @brief Release every segment. No lock needed.
+ */
+void hm_flat_destroy(hashmap_s *hashmap);
+
+/*
+ * @brief Find a key in the segment of its stripe.
+ * @return The slot holding the key (value at value_offset), or NULL.
+ */
+unsigned char *hm_flat_find(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash,
+							const void *key);
+
+/*
+ * @brief Prefetch the meta byte, cached hash and slot a lookup of hash would start from.
+ */
+void hm_flat_prefetch(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash);
+
+/*
+ * @brief Insert a key or overwrite its value.
+ * @return 1 if a new entry was inserted, 0 if an existing one was updated, -1 on failure.
+ */
+int hm_flat_set(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash, const void *key,
+				const void *value);
+
+/*
+ * @brief Grow a stripe's segment so that it holds count entries without growing again.
+ * @return false on allocation failure, the segment is left as it was.
+ */
+bool hm_flat_reserve(hashmap_s *hashmap, hm_stripe_s *stripe, size_t count);
+
+/*
+ * @brief Remove a key.
+ * @return true if the key was found and removed.
+ */
+bool hm_flat_remove(hashmap_s *hashmap, hm_stripe_s *stripe, uint64_t hash, const void *key);
+
+/*
+ * @brief Empty every segment, keeping its memory. All stripe locks must be held.
+ */
+void hm_flat_clear(hashmap_s *hashmap);
+
+/*
+ * @brief Walk every entry of a segment with borrowed pointers.
+ * @return false if fn stopped the walk.
+ */
+bool hm_flat_walk(hashmap_s *hashmap, hm_stripe_s *stripe, hm_walk_f *fn, void *arg);
+
+/*
+ * @brief Next used slot of a stripe's segment from *index on, exposed through view.
+ * @return view, or NULL once the segment is exhausted.
+ */
+bucket_s *hm_flat_next(hashmap_s *hashmap, hm_stripe_s *stripe, size_t *index, bucket_s *view);
+
+/*
+ * @brief Add the slots and probe distances of a stripe's segment to stats.
+ */
+void hm_flat_stats(const hm_stripe_s *stripe, hm_stats_s *stats);
+
+#endif /* MYCLIB_HASHMAP_INTERNAL_H */
@@ -0,0 +1,177 @@
+#include "myhashmap_internal.h"
+
+#include <stdlib.h>
+
+/*
+ * @brief A block of nodes. Nodes are never released one by one, only whole slabs.
+ */
+struct hm_slab {
+	struct hm_slab *next;
+	_Alignas(max_align_t) unsigned char nodes[];
+};
+
+void *hm_pool_alloc(hm_pool_s *pool, size_t node_size) {
+	if (pool->free_list != NULL) {
+		void *node = pool->free_list;
+		pool->free_list = *(void **)node;
+		return node;
+	}
+
+	if (pool->slabs == NULL || pool->slab_used == pool->slab_nodes) {
+		size_t nodes = pool->slab_nodes * 2;
+		if (nodes < MYCLIB_HASHMAP_SLAB_MIN) {
+			nodes = MYCLIB_HASHMAP_SLAB_MIN;
+		}
+		if (nodes > MYCLIB_HASHMAP_SLAB_MAX) {
+			nodes = MYCLIB_HASHMAP_SLAB_MAX;
+		}
+		if (nodes > (SIZE_MAX - sizeof(struct hm_slab)) / node_size) {
+			return NULL;
+		}
+
+		struct hm_slab *slab = malloc(sizeof(struct hm_slab) + nodes * node_size);
+		if (slab == NULL) {
+			return NULL;
+		}
+
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		pool->slab_nodes = nodes;
+		pool->slab_used = 0;
+	}
+
+	return pool->slabs->nodes + pool->slab_used++ * node_size;
+}
+
+void hm_pool_free(hm_pool_s *pool, void *node) {
+	*(void **)node = pool->free_list;
+	pool->free_list = node;
+}
+
+void hm_pool_release(hm_pool_s *pool) {
+	while (pool->slabs != NULL) {
+		struct hm_slab *next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+
+	pool->free_list = NULL;
+	pool->slab_used = 0;
+	pool->slab_nodes = 0;
+}
+
+/*
+ * @brief A chunk of arena memory: shared by the size classes, or holding one large blob.
+ */
+struct hm_arena_chunk {
+	struct hm_arena_chunk *next;
+	struct hm_arena_chunk *prev; /**< Only maintained for large blobs */
+	_Alignas(max_align_t) unsigned char bytes[];
+};
+
+/**< Smallest size class, room for the freelist link */
+#define ARENA_MIN_CLASS 16
+
+/*
+ * @brief Returns the size class of a blob, or MYCLIB_HASHMAP_ARENA_CLASSES for a large one.
+ */
+static size_t arena_class(size_t size) {
+	size_t class = 0;
+	for (size_t class_size = ARENA_MIN_CLASS;
+		 class < MYCLIB_HASHMAP_ARENA_CLASSES && class_size < size; class_size *= 2) {
+		class++;
+	}
+
+	return class;
+}
+
+void *hm_arena_alloc(hm_arena_s *arena, size_t size) {
+	size_t class = arena_class(size);
+
+	if (class == MYCLIB_HASHMAP_ARENA_CLASSES) {
+		if (size > SIZE_MAX - sizeof(struct hm_arena_chunk)) {
+			return NULL;
+		}
+
+		struct hm_arena_chunk *chunk = malloc(sizeof(struct hm_arena_chunk) + size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+
+		chunk->prev = NULL;
+		chunk->next = arena->large;
+		if (arena->large != NULL) {
+			arena->large->prev = chunk;
+		}
+		arena->large = chunk;
+		return chunk->bytes;
+	}
+
+	if (arena->free_lists[class] != NULL) {
+		void *blob = arena->free_lists[class];
+		arena->free_lists[class] = *(void **)blob;
+		return blob;
+	}
+
+	size_t class_size = (size_t)ARENA_MIN_CLASS << class;
+	if (arena->chunks == NULL || arena->chunk_used + class_size > MYCLIB_HASHMAP_ARENA_CHUNK) {
+		struct hm_arena_chunk *chunk =
+			malloc(sizeof(struct hm_arena_chunk) + MYCLIB_HASHMAP_ARENA_CHUNK);
+		if (chunk == NULL) {
+			return NULL;
+		}
+
+		chunk->prev = NULL;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->chunk_used = 0;
+	}
+
+	/* Class sizes are multiples of the smallest one, so every blob stays aligned to it */
+	void *blob = arena->chunks->bytes + arena->chunk_used;
+	arena->chunk_used += class_size;
+
+	return blob;
+}
+
+void hm_arena_free(hm_arena_s *arena, void *blob, size_t size) {
+	size_t class = arena_class(size);
+
+	if (class == MYCLIB_HASHMAP_ARENA_CLASSES) {
+		unsigned char *bytes = blob;
+		struct hm_arena_chunk *chunk =
+			(struct hm_arena_chunk *)(bytes - offsetof(struct hm_arena_chunk, bytes));
+		if (chunk->prev != NULL) {
+			chunk->prev->next = chunk->next;
+		} else {
+			arena->large = chunk->next;
+		}
+		if (chunk->next != NULL) {
+			chunk->next->prev = chunk->prev;
+		}
+		free(chunk);
+		return;
+	}
+
+	*(void **)blob = arena->free_lists[class];
+	arena->free_lists[class] = blob;
+}
+
+void hm_arena_release(hm_arena_s *arena) {
+	struct hm_arena_chunk *lists[] = {arena->chunks, arena->large};
+
+	for (size_t i = 0; i < 2; ++i) {
+		while (lists[i] != NULL) {
+			struct hm_arena_chunk *next = lists[i]->next;
+			free(lists[i]);
+			lists[i] = next;
+		}
+	}
+
+	for (size_t i = 0; i < MYCLIB_HASHMAP_ARENA_CLASSES; ++i) {
+		arena->free_lists[i] = NULL;
+	}
+	arena->chunks = NULL;
+	arena->large = NULL;
+	arena->chunk_used = 0;
+}
@@ -0,0 +1,518 @@
+#include "mylfhashmap.h"
+#include "myhashmap_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Reclamation protocol (epoch based):
+ *
+ * - A reader loads the global epoch (acquire), publishes it in its own record, issues a full
+ *   fence and only then loads the table. It clears the record when done.
+ * - A writer unlinks a node, issues a full fence, and tags it with a fetch_add of the global
+ *   epoch. A reader that observed a later epoch synchronized with that increment, so it cannot
+ *   reach the unlinked node.
+ * - An object tagged e is freed once every active record holds an epoch greater than e.
+ */
+
+static inline lfhashmap_s *thread_map(lfhm_thread_s *thread) {
+	return thread->map;
+}
+
+static inline mtx_t *get_lock(lfhashmap_s *map, uint64_t hash) {
+	return &map->locks[hash_index(hash, map->lock_bits)].lock;
+}
+
+static inline unsigned char *node_value(lfhashmap_s *map, lfhm_node_s *node) {
+	return node->data + map->value_offset;
+}
+
+static lfhm_table_s *table_new(size_t capacity, unsigned int bits) {
+	lfhm_table_s *table =
+		malloc(sizeof(lfhm_table_s) + capacity * sizeof(_Atomic(lfhm_node_s *)));
+	if (table == NULL) {
+		return NULL;
+	}
+
+	table->capacity = capacity;
+	table->capacity_bits = bits;
+	for (size_t i = 0; i < capacity; ++i) {
+		atomic_init(&table->buckets[i], NULL);
+	}
+
+	return table;
+}
+
+static lfhm_node_s *node_new(lfhashmap_s *map, uint64_t hash, const void *key,
+							 const void *value) {
+	lfhm_node_s *node = malloc(sizeof(lfhm_node_s) + map->value_offset + map->value_size);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	atomic_init(&node->next, NULL);
+	node->hash = hash;
+	memcpy(node->data, key, map->key_size);
+	memcpy(node_value(map, node), value, map->value_size);
+
+	return node;
+}
+
+/*
+ * @brief Free every retired object no active reader can still hold.
+ *
+ * Must be called with retire_lock held.
+ */
+static void reclaim(lfhashmap_s *map) {
+	atomic_thread_fence(memory_order_seq_cst);
+
+	uint64_t min = atomic_load(&map->epoch);
+	for (lfhm_thread_s *t = atomic_load(&map->threads); t != NULL; t = t->next) {
+		uint64_t epoch = atomic_load(&t->epoch);
+		if (epoch != 0 && epoch < min) {
+			min = epoch;
+		}
+	}
+
+	lfhm_garbage_s **link = &map->retired;
+	while (*link != NULL) {
+		lfhm_garbage_s *garbage = *link;
+		if (garbage->epoch < min) {
+			*link = garbage->next;
+			free(garbage);
+			map->num_retired--;
+		} else {
+			link = &garbage->next;
+		}
+	}
+}
+
+/*
+ * @brief Queue unlinked objects for deferred free.
+ *
+ * @param[in] first First object of a list linked through garbage.next.
+ * @param[in] last Last object of that list.
+ * @param[in] count Number of objects.
+ */
+static void retire_list(lfhashmap_s *map, lfhm_garbage_s *first, lfhm_garbage_s *last,
+						size_t count) {
+	atomic_thread_fence(memory_order_seq_cst);
+	uint64_t epoch = atomic_fetch_add_explicit(&map->epoch, 1, memory_order_acq_rel);
+
+	for (lfhm_garbage_s *g = first; g != NULL; g = g->next) {
+		g->epoch = epoch;
+		if (g == last) {
+			break;
+		}
+	}
+
+	mtx_lock(&map->retire_lock);
+	last->next = map->retired;
+	map->retired = first;
+	map->num_retired += count;
+	if (map->num_retired >= MYCLIB_LFHASHMAP_RECLAIM_BATCH) {
+		reclaim(map);
+	}
+	mtx_unlock(&map->retire_lock);
+}
+
+static void retire(lfhashmap_s *map, lfhm_garbage_s *garbage) {
+	garbage->next = NULL;
+	retire_list(map, garbage, garbage, 1);
+}
+
+static inline void read_enter(lfhm_thread_s *thread) {
+	lfhashmap_s *map = thread_map(thread);
+
+	uint64_t epoch = atomic_load_explicit(&map->epoch, memory_order_acquire);
+	atomic_store_explicit(&thread->epoch, epoch, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline void read_exit(lfhm_thread_s *thread) {
+	atomic_store_explicit(&thread->epoch, 0, memory_order_release);
+}
+
+/*
+ * @brief Find a key in a table.
+ *
+ * @param[out] node The matching node as loaded during the walk, or NULL. Readers must use it
+ * rather than reloading the link, which a writer may have changed since.
+ * @return The link pointing to the matching node, or to the NULL terminating the chain.
+ */
+static _Atomic(lfhm_node_s *) *find_link(lfhashmap_s *map, lfhm_table_s *table, uint64_t hash,
+										  const void *key, lfhm_node_s **node) {
+	_Atomic(lfhm_node_s *) *link = &table->buckets[hash_index(hash, table->capacity_bits)];
+
+	for (;;) {
+		*node = atomic_load_explicit(link, memory_order_acquire);
+		if (*node == NULL || ((*node)->hash == hash && map->equal((*node)->data, key))) {
+			return link;
+		}
+		link = &(*node)->next;
+	}
+}
+
+/*
+ * @brief Double the table by copying every node. Readers keep using the old copy meanwhile.
+ */
+static void grow(lfhashmap_s *map) {
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		mtx_lock(&map->locks[i].lock);
+	}
+
+	lfhm_table_s *old = atomic_load_explicit(&map->table, memory_order_relaxed);
+	size_t size = atomic_load(&map->size);
+	if (size <= old->capacity / MYCLIB_HASHMAP_LOAD_DEN * MYCLIB_HASHMAP_LOAD_NUM ||
+		old->capacity > SIZE_MAX / 2 / sizeof(_Atomic(lfhm_node_s *))) {
+		goto out;
+	}
+
+	lfhm_table_s *table = table_new(old->capacity * 2, old->capacity_bits + 1);
+	if (table == NULL) {
+		goto out;
+	}
+
+	for (size_t i = 0; i < old->capacity; ++i) {
+		lfhm_node_s *node = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+		for (; node != NULL; node = atomic_load_explicit(&node->next, memory_order_relaxed)) {
+			lfhm_node_s *copy = node_new(map, node->hash, node->data, node_value(map, node));
+			if (copy == NULL) {
+				/* Drop the partial copy, the map keeps its current table */
+				for (size_t j = 0; j < table->capacity; ++j) {
+					lfhm_node_s *n = atomic_load_explicit(&table->buckets[j], memory_order_relaxed);
+					while (n != NULL) {
+						lfhm_node_s *next = atomic_load_explicit(&n->next, memory_order_relaxed);
+						free(n);
+						n = next;
+					}
+				}
+				free(table);
+				goto out;
+			}
+
+			size_t index = hash_index(copy->hash, table->capacity_bits);
+			atomic_init(&copy->next,
+						atomic_load_explicit(&table->buckets[index], memory_order_relaxed));
+			atomic_init(&table->buckets[index], copy);
+		}
+	}
+
+	atomic_store_explicit(&map->table, table, memory_order_release);
+
+	/* Retire the old table and all its nodes as one batch */
+	lfhm_garbage_s *first = &old->garbage;
+	lfhm_garbage_s *last = first;
+	size_t count = 1;
+	for (size_t i = 0; i < old->capacity; ++i) {
+		lfhm_node_s *node = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+		for (; node != NULL; node = atomic_load_explicit(&node->next, memory_order_relaxed)) {
+			last->next = &node->garbage;
+			last = last->next;
+			count++;
+		}
+	}
+	last->next = NULL;
+	retire_list(map, first, last, count);
+
+out:
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		mtx_unlock(&map->locks[i].lock);
+	}
+}
+
+lfhashmap_s *lfhm_new(hash_f *hash, equal_f *equal, size_t key_size, size_t value_size,
+					  size_t capacity) {
+	if (hash == NULL || equal == NULL || key_size == 0 || value_size == 0) {
+		return NULL;
+	}
+
+	if (capacity == 0) {
+		capacity = MYCLIB_HASHMAP_SIZE;
+	}
+	/* A bucket must never span two writer stripes */
+	if (capacity < MYCLIB_HASHMAP_LOCKS) {
+		capacity = MYCLIB_HASHMAP_LOCKS;
+	}
+	unsigned int bits = 0;
+	while (((size_t)1 << bits) < capacity) {
+		if (bits == sizeof(size_t) * 8 - 2) {
+			return NULL;
+		}
+		bits++;
+	}
+
+	lfhashmap_s *map = cache_aligned_calloc(sizeof(lfhashmap_s));
+	if (map == NULL) {
+		return NULL;
+	}
+
+	map->hash = hash;
+	map->equal = equal;
+	map->key_size = key_size;
+	map->value_size = value_size;
+	map->value_offset = (key_size + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) *
+						_Alignof(max_align_t);
+	map->retired = NULL;
+	map->num_retired = 0;
+	atomic_init(&map->threads, NULL);
+	atomic_init(&map->epoch, 1);
+	atomic_init(&map->size, 0);
+
+	map->num_locks = MYCLIB_HASHMAP_LOCKS;
+	map->lock_bits = 0;
+	while (((size_t)1 << map->lock_bits) < map->num_locks) {
+		map->lock_bits++;
+	}
+
+	lfhm_table_s *table = table_new((size_t)1 << bits, bits);
+	if (table == NULL) {
+		cache_aligned_free(map);
+		return NULL;
+	}
+	atomic_init(&map->table, table);
+
+	map->locks = cache_aligned_calloc(map->num_locks * sizeof(lfhm_stripe_s));
+	if (map->locks == NULL) {
+		free(table);
+		cache_aligned_free(map);
+		return NULL;
+	}
+
+	size_t inited = 0;
+	for (; inited < map->num_locks; ++inited) {
+		if (mtx_init(&map->locks[inited].lock, mtx_plain) != thrd_success) {
+			break;
+		}
+	}
+	if (inited < map->num_locks || mtx_init(&map->threads_lock, mtx_plain) != thrd_success) {
+		for (size_t i = 0; i < inited; ++i) {
+			mtx_destroy(&map->locks[i].lock);
+		}
+		cache_aligned_free(map->locks);
+		free(table);
+		cache_aligned_free(map);
+		return NULL;
+	}
+	if (mtx_init(&map->retire_lock, mtx_plain) != thrd_success) {
+		mtx_destroy(&map->threads_lock);
+		for (size_t i = 0; i < map->num_locks; ++i) {
+			mtx_destroy(&map->locks[i].lock);
+		}
+		cache_aligned_free(map->locks);
+		free(table);
+		cache_aligned_free(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+void lfhm_free(lfhashmap_s *map) {
+	if (map == NULL) {
+		return;
+	}
+
+	lfhm_table_s *table = atomic_load(&map->table);
+	for (size_t i = 0; i < table->capacity; ++i) {
+		lfhm_node_s *node = atomic_load_explicit(&table->buckets[i], memory_order_relaxed);
+		while (node != NULL) {
+			lfhm_node_s *next = atomic_load_explicit(&node->next, memory_order_relaxed);
+			free(node);
+			node = next;
+		}
+	}
+	free(table);
+
+	while (map->retired != NULL) {
+		lfhm_garbage_s *next = map->retired->next;
+		free(map->retired);
+		map->retired = next;
+	}
+
+	lfhm_thread_s *thread = atomic_load(&map->threads);
+	while (thread != NULL) {
+		lfhm_thread_s *next = thread->next;
+		cache_aligned_free(thread);
+		thread = next;
+	}
+
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		mtx_destroy(&map->locks[i].lock);
+	}
+	cache_aligned_free(map->locks);
+	mtx_destroy(&map->threads_lock);
+	mtx_destroy(&map->retire_lock);
+
+	cache_aligned_free(map);
+}
+
+lfhm_thread_s *lfhm_thread_register(lfhashmap_s *map) {
+	if (map == NULL) {
+		return NULL;
+	}
+
+	/* Reuse a released record first */
+	for (lfhm_thread_s *t = atomic_load(&map->threads); t != NULL; t = t->next) {
+		bool expected = false;
+		if (atomic_compare_exchange_strong(&t->in_use, &expected, true)) {
+			return t;
+		}
+	}
+
+	lfhm_thread_s *thread = cache_aligned_calloc(sizeof(lfhm_thread_s));
+	if (thread == NULL) {
+		return NULL;
+	}
+	atomic_init(&thread->epoch, 0);
+	atomic_init(&thread->in_use, true);
+	thread->map = map;
+
+	/* Records are only ever prepended, reclaim can walk the list without the lock */
+	mtx_lock(&map->threads_lock);
+	thread->next = atomic_load(&map->threads);
+	atomic_store(&map->threads, thread);
+	mtx_unlock(&map->threads_lock);
+
+	return thread;
+}
+
+void lfhm_thread_unregister(lfhm_thread_s *thread) {
+	if (thread == NULL) {
+		return;
+	}
+
+	atomic_store(&thread->epoch, 0);
+	atomic_store(&thread->in_use, false);
+}
+
+bool lfhm_set(lfhm_thread_s *thread, const void *key, const void *value) {
+	if (thread == NULL || key == NULL || value == NULL) {
+		return false;
+	}
+
+	lfhashmap_s *map = thread_map(thread);
+	uint64_t hash = mix_hash(map->hash(key));
+
+	lfhm_node_s *node = node_new(map, hash, key, value);
+	if (node == NULL) {
+		return false;
+	}
+
+	mtx_t *lock = get_lock(map, hash);
+	mtx_lock(lock);
+
+	/* The table only changes with every writer lock held */
+	lfhm_table_s *table = atomic_load_explicit(&map->table, memory_order_relaxed);
+	lfhm_node_s *old;
+	_Atomic(lfhm_node_s *) *link = find_link(map, table, hash, key, &old);
+
+	bool need_grow = false;
+	if (old != NULL) {
+		/* Replace the node: readers see either the old or the new value, never a mix */
+		atomic_init(&node->next, atomic_load_explicit(&old->next, memory_order_relaxed));
+		atomic_store_explicit(link, node, memory_order_release);
+	} else {
+		atomic_store_explicit(link, node, memory_order_release);
+		size_t size = atomic_fetch_add(&map->size, 1) + 1;
+		need_grow = size > table->capacity / MYCLIB_HASHMAP_LOAD_DEN * MYCLIB_HASHMAP_LOAD_NUM;
+	}
+
+	mtx_unlock(lock);
+
+	if (old != NULL) {
+		retire(map, &old->garbage);
+	}
+	if (need_grow) {
+		grow(map);
+	}
+
+	return true;
+}
+
+bool lfhm_peek(lfhm_thread_s *thread, const void *key, hm_visit_f *callback, void *arg) {
+	if (thread == NULL || key == NULL) {
+		return false;
+	}
+
+	lfhashmap_s *map = thread_map(thread);
+	uint64_t hash = mix_hash(map->hash(key));
+
+	read_enter(thread);
+
+	lfhm_table_s *table = atomic_load_explicit(&map->table, memory_order_acquire);
+	lfhm_node_s *node;
+	find_link(map, table, hash, key, &node);
+	if (node != NULL && callback != NULL) {
+		callback(node->data, node_value(map, node), arg);
+	}
+
+	read_exit(thread);
+
+	return node != NULL;
+}
+
+struct copy_arg {
+	void *value;
+	size_t value_size;
+};
+
+static void copy_value(const void *key, const void *value, void *arg) {
+	(void)key;
+	struct copy_arg *ca = arg;
+	memcpy(ca->value, value, ca->value_size);
+}
+
+bool lfhm_get(lfhm_thread_s *thread, const void *key, void *value) {
+	if (thread == NULL || value == NULL) {
+		return false;
+	}
+
+	struct copy_arg arg = {
+		.value = value,
+		.value_size = thread_map(thread)->value_size,
+	};
+
+	return lfhm_peek(thread, key, copy_value, &arg);
+}
+
+bool lfhm_remove(lfhm_thread_s *thread, const void *key) {
+	if (thread == NULL || key == NULL) {
+		return false;
+	}
+
+	lfhashmap_s *map = thread_map(thread);
+	uint64_t hash = mix_hash(map->hash(key));
+
+	mtx_t *lock = get_lock(map, hash);
+	mtx_lock(lock);
+
+	lfhm_table_s *table = atomic_load_explicit(&map->table, memory_order_relaxed);
+	lfhm_node_s *old;
+	_Atomic(lfhm_node_s *) *link = find_link(map, table, hash, key, &old);
+
+	if (old != NULL) {
+		/* Readers already on the node can still follow its next pointer */
+		atomic_store_explicit(link, atomic_load_explicit(&old->next, memory_order_relaxed),
+							  memory_order_release);
+		atomic_fetch_sub(&map->size, 1);
+	}
+
+	mtx_unlock(lock);
+
+	if (old == NULL) {
+		return false;
+	}
+
+	retire(map, &old->garbage);
+
+	return true;
+}
+
+size_t lfhm_size(lfhashmap_s *map) {
+	if (map == NULL) {
+		return 0;
+	}
+
+	return atomic_load(&map->size);
+}
@@ -0,0 +1,184 @@
+#ifndef MYCLIB_LFHASHMAP_H
+#define MYCLIB_LFHASHMAP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "myhashmap.h"
+
+/**< Retired objects accumulated before trying to reclaim them */
+#define MYCLIB_LFHASHMAP_RECLAIM_BATCH 64
+
+/**
+ * @brief Header shared by every object that is retired instead of freed.
+ */
+typedef struct lfhm_garbage {
+	struct lfhm_garbage *next; /**< Next object in the retire list */
+	uint64_t epoch;			   /**< Global epoch at the time it was unlinked */
+} lfhm_garbage_s;
+
+/**
+ * @brief An immutable entry: updates replace the whole node.
+ */
+typedef struct lfhm_node {
+	lfhm_garbage_s garbage;						/**< Retire list link (must be first) */
+	_Atomic(struct lfhm_node *) next;			/**< Next node of the chain */
+	uint64_t hash;								/**< Mixed hash of the key */
+	_Alignas(max_align_t) unsigned char data[];	/**< Key, then value at value_offset */
+} lfhm_node_s;
+
+/**
+ * @brief A bucket array. Replaced as a whole when the map grows.
+ */
+typedef struct lfhm_table {
+	lfhm_garbage_s garbage;			  /**< Retire list link (must be first) */
+	size_t capacity;				  /**< Number of buckets (power of two) */
+	unsigned int capacity_bits;		  /**< log2(capacity) */
+	_Atomic(lfhm_node_s *) buckets[]; /**< Chain heads */
+} lfhm_table_s;
+
+/**
+ * @brief Per-thread reader record.
+ *
+ * The only memory a reader writes. Each record sits alone on its cache line.
+ */
+typedef struct lfhm_thread {
+	/** Global epoch observed when entering a read section, 0 while quiescent */
+	_Alignas(MYCLIB_HASHMAP_CACHE_LINE) atomic_uint_fast64_t epoch;
+	atomic_bool in_use;		  /**< Record owned by a registered thread */
+	struct lfhashmap *map;	  /**< Owning map */
+	struct lfhm_thread *next; /**< Next record of the map */
+} lfhm_thread_s;
+
+/**
+ * @brief A writer stripe, alone on its cache line(s) like hm_stripe_s.
+ */
+typedef struct lfhm_stripe {
+	/** Stripe mutex, aligned so that no two stripes share a cache line */
+	_Alignas(MYCLIB_HASHMAP_CACHE_LINE) mtx_t lock;
+} lfhm_stripe_s;
+
+/**
+ * @brief Concurrent hash map with non-blocking readers.
+ *
+ * Readers never take a lock and only write to their own lfhm_thread_s record: a lookup
+ * publishes the current epoch, walks the chain and clears it. Writers serialize per stripe,
+ * never modify a published node in place, and retire unlinked nodes (and old tables after a
+ * resize) until no reader can still hold them. A resize copies the table under all writer
+ * locks: writers wait for it, readers do not.
+ */
+typedef struct lfhashmap {
+	hash_f *hash;					  /**< Hash function */
+	equal_f *equal;					  /**< Equality comparison function */
+	size_t key_size;				  /**< Size in bytes of the key */
+	size_t value_size;				  /**< Size in bytes of the value */
+	size_t value_offset;			  /**< Offset of the value inside node data */
+	_Atomic(lfhm_table_s *) table;	  /**< Current bucket array */
+	lfhm_stripe_s *locks;			  /**< Writer stripes */
+	size_t num_locks;				  /**< Number of writer stripes (power of two) */
+	unsigned int lock_bits;			  /**< log2(num_locks) */
+	_Atomic(lfhm_thread_s *) threads; /**< Registered reader records */
+	mtx_t threads_lock;				  /**< Serializes registration */
+	mtx_t retire_lock;				  /**< Protects the retire list */
+	lfhm_garbage_s *retired;		  /**< Objects waiting for readers to move on */
+	size_t num_retired;				  /**< Length of the retire list */
+	/** Global epoch, bumped by every retire. Starts its own cache line */
+	_Alignas(MYCLIB_HASHMAP_CACHE_LINE) atomic_uint_fast64_t epoch;
+	atomic_size_t size; /**< Number of keys */
+} lfhashmap_s;
+
+/**
+ * @brief Create a new hash map with non-blocking readers.
+ *
+ * Keys and values are copied inside the nodes, like in the flat hashmap backend.
+ *
+ * @param[in] hash Function used to hash keys.
+ * @param[in] equal Function used to compare keys.
+ * @param[in] key_size Size in bytes of each key.
+ * @param[in] value_size Size in bytes of each value.
+ * @param[in] capacity Initial number of buckets (0 for MYCLIB_HASHMAP_SIZE).
+ * @return Pointer to the new map, or NULL on failure.
+ */
+lfhashmap_s *lfhm_new(hash_f *hash, equal_f *equal, size_t key_size, size_t value_size,
+					  size_t capacity);
+
+/**
+ * @brief Free the map and everything it owns.
+ *
+ * No other thread may use the map or its thread records anymore.
+ *
+ * @param[in] map Map to free.
+ */
+void lfhm_free(lfhashmap_s *map);
+
+/**
+ * @brief Register the calling thread with the map.
+ *
+ * Every thread needs its own record to call the other functions.
+ *
+ * @param[in] map Map.
+ * @return The thread record, or NULL on failure.
+ */
+lfhm_thread_s *lfhm_thread_register(lfhashmap_s *map);
+
+/**
+ * @brief Release a thread record. The record must not be used afterwards.
+ *
+ * @param[in] thread Thread record.
+ */
+void lfhm_thread_unregister(lfhm_thread_s *thread);
+
+/**
+ * @brief Insert or update a key. Takes the writer lock of the key's stripe.
+ *
+ * @param[in] thread Record of the calling thread.
+ * @param[in] key Pointer to the key (key_size bytes are copied).
+ * @param[in] value Pointer to the value (value_size bytes are copied).
+ * @return true on success, false on failure.
+ */
+bool lfhm_set(lfhm_thread_s *thread, const void *key, const void *value);
+
+/**
+ * @brief Copy the value of a key. Never blocks.
+ *
+ * @param[in] thread Record of the calling thread.
+ * @param[in] key Pointer to the key.
+ * @param[out] value Buffer of value_size bytes receiving the value.
+ * @return true if the key was found.
+ */
+bool lfhm_get(lfhm_thread_s *thread, const void *key, void *value);
+
+/**
+ * @brief Run a callback on the stored entry of a key. Never blocks.
+ *
+ * The entry is immutable and stays valid for the duration of the callback.
+ *
+ * @param[in] thread Record of the calling thread.
+ * @param[in] key Pointer to the key.
+ * @param[in] callback Function called on the entry if found (can be NULL).
+ * @param[in] arg User argument passed to the callback.
+ * @return true if the key was found.
+ */
+bool lfhm_peek(lfhm_thread_s *thread, const void *key, hm_visit_f *callback, void *arg);
+
+/**
+ * @brief Remove a key. Takes the writer lock of the key's stripe.
+ *
+ * @param[in] thread Record of the calling thread.
+ * @param[in] key Pointer to the key.
+ * @return true if the key was found and removed.
+ */
+bool lfhm_remove(lfhm_thread_s *thread, const void *key);
+
+/**
+ * @brief Get the number of entries.
+ *
+ * @param[in] map Map.
+ * @return Number of keys.
+ */
+size_t lfhm_size(lfhashmap_s *map);
+
+#endif /* MYCLIB_LFHASHMAP_H */
@@ -0,0 +1,202 @@
+#include "myshardmap.h"
+#include "myhashmap_internal.h"
+
+#include <stdlib.h>
+
+/**< Added to the user hash before picking a shard, see shard_of() */
+#define SHARD_SEED 0x9e3779b97f4a7c15ULL
+
+/*
+ * @brief Returns the shard of a user hash.
+ *
+ * Shards must not be picked from the bits a shard itself indexes with (the top bits for stripes
+ * and buckets, the low bits for flat slots), or every key of a shard would land in the same
+ * fraction of its table. The seeded re-mix makes the shard independent of both.
+ */
+static inline size_t shard_of(shardmap_s *map, uint64_t hash) {
+	return hash_index(mix_hash(hash + SHARD_SEED), map->shard_bits);
+}
+
+static inline uint64_t user_hash(shardmap_s *map, const void *key) {
+	return user_hash_typed(map->key_type, map->hash, map->key_size, key);
+}
+
+shardmap_s *smap_new(const hm_config_s *config, size_t num_shards) {
+	if (config == NULL || config->variable) {
+		return NULL;
+	}
+
+	if (num_shards == 0) {
+		num_shards = MYCLIB_SHARDMAP_SHARDS;
+	}
+	unsigned int bits = 0;
+	while (((size_t)1 << bits) < num_shards) {
+		if (bits == sizeof(size_t) * 8 - 2) {
+			return NULL;
+		}
+		bits++;
+	}
+	num_shards = (size_t)1 << bits;
+
+	if (config->max_entries != 0 && config->max_entries < num_shards) {
+		/* Some shard would get a bound of 0, which means unbounded */
+		return NULL;
+	}
+
+	/* Shards are created later, reject now what hm_new_config() would reject then */
+	hm_config_s probe = *config;
+	probe.capacity = 1;
+	probe.num_stripes = 1;
+	hashmap_s *checked = hm_new_config(&probe);
+	if (checked == NULL) {
+		return NULL;
+	}
+	hm_free(checked);
+
+	shardmap_s *map = malloc(sizeof(shardmap_s));
+	if (map == NULL) {
+		return NULL;
+	}
+
+	map->shards = malloc(num_shards * sizeof(*map->shards));
+	if (map->shards == NULL) {
+		free(map);
+		return NULL;
+	}
+	for (size_t i = 0; i < num_shards; ++i) {
+		atomic_init(&map->shards[i], NULL);
+	}
+
+	map->key_type = config->key_type;
+	map->hash = config->hash;
+	map->key_size = config->key_size;
+	map->config = *config;
+	map->config.capacity = (config->capacity + num_shards - 1) / num_shards;
+	map->num_shards = num_shards;
+	map->shard_bits = bits;
+
+	return map;
+}
+
+/*
+ * @brief Returns a shard if it was created, NULL otherwise.
+ */
+static inline hashmap_s *shard_get(shardmap_s *map, size_t index) {
+	return atomic_load_explicit(&map->shards[index], memory_order_acquire);
+}
+
+/*
+ * @brief Returns a shard, creating it on the calling thread if it does not exist yet.
+ *
+ * hm_new_config() zeroes the shard, its stripes and its table on this thread, so under a
+ * first-touch policy they land on its NUMA node. Concurrent callers may both build the shard:
+ * the first to publish it wins and the others free their copy.
+ * @return The shard, or NULL on allocation failure.
+ */
+static hashmap_s *shard_create(shardmap_s *map, size_t index) {
+	hashmap_s *shard = shard_get(map, index);
+	if (shard != NULL) {
+		return shard;
+	}
+
+	/* Split exactly, so that the shards together never go past max_entries */
+	hm_config_s config = map->config;
+	config.max_entries = map->config.max_entries / map->num_shards +
+						 (index < map->config.max_entries % map->num_shards);
+
+	hashmap_s *created = hm_new_config(&config);
+	if (created == NULL) {
+		return NULL;
+	}
+
+	if (!atomic_compare_exchange_strong_explicit(&map->shards[index], &shard, created,
+												 memory_order_acq_rel, memory_order_acquire)) {
+		hm_free(created);
+		return shard;
+	}
+
+	return created;
+}
+
+void smap_free(shardmap_s *map) {
+	if (map == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		hm_free(shard_get(map, i));
+	}
+	free(map->shards);
+	free(map);
+}
+
+size_t smap_shard_index(shardmap_s *map, const void *key) {
+	if (map == NULL || key == NULL) {
+		return 0;
+	}
+
+	return shard_of(map, user_hash(map, key));
+}
+
+hashmap_s *smap_shard(shardmap_s *map, size_t index) {
+	if (map == NULL || index >= map->num_shards) {
+		return NULL;
+	}
+
+	return shard_create(map, index);
+}
+
+bool smap_set(shardmap_s *map, void *key, void *value) {
+	if (map == NULL || key == NULL || value == NULL) {
+		return false;
+	}
+
+	/* Hashed once: the shard reuses the hash that picked it */
+	uint64_t hash = user_hash(map, key);
+	hashmap_s *shard = shard_create(map, shard_of(map, hash));
+	return shard != NULL && hm_set_with_hash(shard, key, value, hash);
+}
+
+bool smap_get_value(shardmap_s *map, const void *key, void *value) {
+	if (map == NULL || key == NULL || value == NULL) {
+		return false;
+	}
+
+	/* A shard nothing wrote to yet has no keys */
+	uint64_t hash = user_hash(map, key);
+	hashmap_s *shard = shard_get(map, shard_of(map, hash));
+	return shard != NULL && hm_get_value_with_hash(shard, key, value, hash);
+}
+
+bool smap_remove(shardmap_s *map, void *key) {
+	if (map == NULL || key == NULL) {
+		return false;
+	}
+
+	uint64_t hash = user_hash(map, key);
+	hashmap_s *shard = shard_get(map, shard_of(map, hash));
+	return shard != NULL && hm_remove_with_hash(shard, key, hash);
+}
+
+size_t smap_size(shardmap_s *map) {
+	if (map == NULL) {
+		return 0;
+	}
+
+	size_t size = 0;
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		size += hm_size(shard_get(map, i));
+	}
+
+	return size;
+}
+
+void smap_clear(shardmap_s *map) {
+	if (map == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		hm_clear(shard_get(map, i));
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef MYCLIB_SHARDMAP_H
+#define MYCLIB_SHARDMAP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "myhashmap.h"
+
+/**< Default number of shards */
+#define MYCLIB_SHARDMAP_SHARDS 16
+
+/**
+ * @brief Hash map split into independent sub-maps.
+ *
+ * Every key belongs to exactly one shard, picked from its hash. Shards share nothing: each has
+ * its own stripes, table, resize and size counter, so writers on different shards never touch
+ * the same cache line. A shard grows on its own instead of the whole map rehashing at once.
+ *
+ * Shards are created lazily, on the thread of their first smap_set() or smap_shard() call,
+ * which allocates and zeroes the shard, its stripes and its table. With a first-touch NUMA
+ * policy (the Linux default) they land on that thread's node: calling smap_shard() for each
+ * index from a thread bound to the chosen node places every shard before any write.
+ */
+typedef struct shardmap {
+	hm_key_e key_type;			  /**< Key handling of every shard */
+	hash_f *hash;				  /**< Hash function of every shard */
+	size_t key_size;			  /**< Size in bytes of the key */
+	hm_config_s config;			  /**< Shard configuration, max_entries split on creation */
+	_Atomic(hashmap_s *) *shards; /**< Sub-maps, NULL until created */
+	size_t num_shards;			  /**< Number of shards (power of two) */
+	unsigned int shard_bits;	  /**< log2(num_shards) */
+} shardmap_s;
+
+/**
+ * @brief Create a new sharded hash map.
+ *
+ * Every shard will be created with hm_new_config(), with capacity and max_entries divided among
+ * the shards; none is created yet, but the configuration is checked up front. Variable-length
+ * maps are not supported, nor a max_entries below num_shards.
+ *
+ * @param[in] config Configuration of the map, as for hm_new_config().
+ * @param[in] num_shards Number of shards, rounded up to a power of two (0 for
+ * MYCLIB_SHARDMAP_SHARDS).
+ * @return Pointer to the new map, or NULL on failure.
+ */
+shardmap_s *smap_new(const hm_config_s *config, size_t num_shards);
+
+/**
+ * @brief Free the map and every shard.
+ *
+ * @param[in] map Map to free.
+ */
+void smap_free(shardmap_s *map);
+
+/**
+ * @brief Get the shard a key belongs to.
+ *
+ * Threads that only ever write keys of the same shards do not contend with each other.
+ *
+ * @param[in] map Map.
+ * @param[in] key Pointer to the key.
+ * @return Index of the shard, below num_shards.
+ */
+size_t smap_shard_index(shardmap_s *map, const void *key);
+
+/**
+ * @brief Get a shard, to use any hm_*() function on its keys.
+ *
+ * Creates the shard on the calling thread if it does not exist yet, which places its memory
+ * (see shardmap_s). Only keys for which smap_shard_index() returns index may be stored in it.
+ *
+ * @param[in] map Map.
+ * @param[in] index Index of the shard.
+ * @return The shard, or NULL if index is out of range or on allocation failure.
+ */
+hashmap_s *smap_shard(shardmap_s *map, size_t index);
+
+/**
+ * @brief Insert or update a key.
+ *
+ * @param[in] map Map.
+ * @param[in] key Pointer to the key (key_size bytes are copied).
+ * @param[in] value Pointer to the value (value_size bytes are copied).
+ * @return true on success, false on failure.
+ */
+bool smap_set(shardmap_s *map, void *key, void *value);
+
+/**
+ * @brief Copy the value of a key.
+ *
+ * @param[in] map Map.
+ * @param[in] key Pointer to the key.
+ * @param[out] value Buffer of value_size bytes receiving the value.
+ * @return true if the key was found.
+ */
+bool smap_get_value(shardmap_s *map, const void *key, void *value);
+
+/**
+ * @brief Remove a key.
+ *
+ * @param[in] map Map.
+ * @param[in] key Pointer to the key.
+ * @return true if the key was found and removed.
+ */
+bool smap_remove(shardmap_s *map, void *key);
+
+/**
+ * @brief Get the number of entries, summed over the shards.
+ *
+ * Each shard is read once: concurrent writes to other shards may or may not be counted.
+ *
+ * @param[in] map Map.
+ * @return Number of keys.
+ */
+size_t smap_size(shardmap_s *map);
+
+/**
+ * @brief Remove every entry, one shard after another.
+ *
+ * @param[in] map Map.
+ */
+void smap_clear(shardmap_s *map);
+
+#endif /* MYCLIB_SHARDMAP_H */
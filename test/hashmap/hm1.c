@@ -12,19 +12,6 @@ struct my_custom_type {
 	char favourite_brand[MAX_STR_LEN];
 };
 
-/* Let's hash our name */
-static unsigned int my_hash_func(const void *key) {
-	char *name = (char *)key;
-	size_t len = strlen(name);
-
-	unsigned int hash = 0;
-	for (size_t i = 0; i < len; ++i) {
-		hash += (int)name[i];
-	}
-
-	return hash % 2069;
-}
-
 /* Let's write our compare function */
 bool my_equal_fun(const void *key_a, const void *key_b) {
 	char *name_a = (char *)key_a;
@@ -50,12 +37,12 @@ void my_free_value(void *value) {
 
 int main(void) {
 	/* Allocate a new hashmap */
-	/* Pass your custom hash, equal and free functions */
+	/* Pass a hash function (here the built-in string hash), your equal and free functions */
 	/* This hashmap will contain names as keys and a custom type as value */
 	size_t key_size = sizeof(char) * MAX_STR_LEN;
 	size_t value_size = sizeof(struct my_custom_type);
 	hashmap_s *map =
-		hm_new(my_hash_func, my_equal_fun, my_free_key, my_free_value, key_size, value_size);
+		hm_new(hm_hash_str, my_equal_fun, my_free_key, my_free_value, key_size, value_size, 0);
 	assert(map != NULL);
 
 	/* Make a new value */
@@ -0,0 +1,266 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define CAPACITY 64
+
+static void sleep_ms(long ms) {
+	struct timespec duration = {.tv_sec = ms / 1000, .tv_nsec = ms % 1000 * 1000000};
+	thrd_sleep(&duration, NULL);
+}
+
+static hashmap_s *new_cache(size_t max_entries, hm_evict_e eviction, uint64_t ttl_ms,
+							hm_alloc_e alloc) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.alloc = alloc,
+		.max_entries = max_entries,
+		.eviction = eviction,
+		.ttl_ms = ttl_ms,
+		.num_stripes = 1,
+	};
+
+	return hm_new_config(&config);
+}
+
+static bool has(hashmap_s *map, uint32_t key) {
+	uint32_t value;
+	return hm_get_value(map, &key, &value) && value == key * 2;
+}
+
+static void put(hashmap_s *map, uint32_t key) {
+	uint32_t value = key * 2;
+	assert(hm_set(map, &key, &value));
+}
+
+static void check_lru(hm_alloc_e alloc) {
+	hashmap_s *map = new_cache(CAPACITY, HM_EVICT_LRU, 0, alloc);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < CAPACITY; ++key) {
+		put(map, key);
+	}
+	assert(hm_size(map) == CAPACITY);
+
+	/* Key 0 was used last, so key 1 is the least recently used */
+	assert(has(map, 0));
+	put(map, CAPACITY);
+	assert(hm_size(map) == CAPACITY);
+	assert(has(map, 0) && !has(map, 1) && has(map, CAPACITY));
+
+	/* Updates never evict */
+	put(map, 2);
+	assert(hm_size(map) == CAPACITY);
+
+	/* A long run keeps the most recent keys only */
+	for (uint32_t key = 0; key < 10 * CAPACITY; ++key) {
+		put(map, 1000 + key);
+	}
+	assert(hm_size(map) == CAPACITY);
+	for (uint32_t key = 0; key < 10 * CAPACITY; ++key) {
+		assert(has(map, 1000 + key) == (key >= 9 * CAPACITY));
+	}
+
+	/* Removed entries free their place */
+	uint32_t key = 1000 + 10 * CAPACITY - 1;
+	assert(hm_remove(map, &key));
+	put(map, 1);
+	assert(hm_size(map) == CAPACITY && has(map, 1) && has(map, 1000 + 9 * CAPACITY));
+
+	hm_clear(map);
+	assert(hm_size(map) == 0);
+	for (uint32_t key = 0; key < 2 * CAPACITY; ++key) {
+		put(map, key);
+	}
+	assert(hm_size(map) == CAPACITY);
+
+	hm_free(map);
+}
+
+static void check_clock(void) {
+	hashmap_s *map = new_cache(CAPACITY, HM_EVICT_CLOCK, 0, HM_ALLOC_MALLOC);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < CAPACITY; ++key) {
+		put(map, key);
+	}
+
+	/* Referenced entries get a second chance, the oldest unreferenced one goes */
+	assert(has(map, 0) && has(map, 1));
+	put(map, CAPACITY);
+	assert(hm_size(map) == CAPACITY);
+	assert(has(map, 0) && has(map, 1) && !has(map, 2));
+
+	for (uint32_t key = 0; key < 10 * CAPACITY; ++key) {
+		put(map, 1000 + key);
+	}
+	assert(hm_size(map) == CAPACITY);
+
+	hm_free(map);
+}
+
+static size_t walked;
+
+static void count_entry(bucket_s *bucket) {
+	(void)bucket;
+	walked++;
+}
+
+static void check_ttl(hm_alloc_e alloc) {
+	hashmap_s *map = new_cache(0, HM_EVICT_LRU, 50, alloc);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < CAPACITY; ++key) {
+		put(map, key);
+	}
+	uint32_t key = CAPACITY;
+	uint32_t value = key * 2;
+	assert(hm_set_ttl(map, &key, &value, 0));
+	key++;
+	value = key * 2;
+	assert(hm_set_ttl(map, &key, &value, 10000));
+	assert(has(map, 0) && has(map, CAPACITY) && has(map, CAPACITY + 1));
+
+	sleep_ms(100);
+
+	/* Expired entries are gone from lookups and walks before they are reclaimed */
+	assert(!has(map, 0) && !has(map, CAPACITY - 1));
+	assert(has(map, CAPACITY) && has(map, CAPACITY + 1));
+	walked = 0;
+	hm_foreach(map, count_entry);
+	assert(walked == 2);
+	key = 0;
+	assert(!hm_remove(map, &key));
+
+	assert(hm_expire(map) == CAPACITY - 1);
+	assert(hm_size(map) == 2);
+	assert(hm_expire(map) == 0);
+
+	/* Writing a key again gives it a new lifetime */
+	put(map, 0);
+	assert(has(map, 0));
+
+	hm_free(map);
+}
+
+#define READERS 4
+
+static int read_all(void *arg) {
+	hashmap_s *map = arg;
+	for (int round = 0; round < 1000; ++round) {
+		for (uint32_t key = 0; key < CAPACITY; ++key) {
+			assert(has(map, key));
+			bucket_s *bucket = hm_get(map, &key);
+			assert(bucket != NULL);
+			hm_free_bucket(bucket);
+		}
+	}
+	return 0;
+}
+
+/* Lookups on an unbounded cache share the stripe, so they must leave its list alone */
+static void check_ttl_readers(void) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.ttl_ms = 60000,
+		.lock_mode = HM_LOCK_RWLOCK,
+		.num_stripes = 1,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < CAPACITY; ++key) {
+		put(map, key);
+	}
+
+	thrd_t readers[READERS];
+	for (int i = 0; i < READERS; ++i) {
+		assert(thrd_create(&readers[i], read_all, map) == thrd_success);
+	}
+	for (int i = 0; i < READERS; ++i) {
+		assert(thrd_join(readers[i], NULL) == thrd_success);
+	}
+
+	/* The list is intact: a sweep along it finds every entry once they all expired */
+	assert(hm_size(map) == CAPACITY);
+	assert(hm_expire(map) == 0);
+	for (uint32_t key = 0; key < CAPACITY; ++key) {
+		uint32_t value = key * 2;
+		assert(hm_set_ttl(map, &key, &value, 1));
+	}
+	sleep_ms(10);
+	assert(hm_expire(map) == CAPACITY);
+	assert(hm_size(map) == 0);
+
+	hm_free(map);
+}
+
+/* The whole map never goes past max_entries, and small bounds keep enough entries per stripe */
+static void check_bound(size_t max_entries, size_t num_stripes) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.max_entries = max_entries,
+		.num_stripes = num_stripes,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+	assert(map->num_locks == 1 || map->stripe_max >= MYCLIB_HASHMAP_STRIPE_ENTRIES);
+
+	for (uint32_t key = 0; key < 100000; ++key) {
+		put(map, key);
+		assert(hm_size(map) <= max_entries);
+	}
+	assert(hm_size(map) >= max_entries / 2);
+
+	hm_free(map);
+}
+
+int main(void) {
+	check_lru(HM_ALLOC_MALLOC);
+	check_lru(HM_ALLOC_POOL);
+	check_clock();
+	check_ttl(HM_ALLOC_MALLOC);
+	check_ttl(HM_ALLOC_POOL);
+	check_ttl_readers();
+
+	/* Bounded across stripes too, bounds that do not divide evenly included */
+	size_t bounds[] = {1, 5, 65, 100, 1000, 1001, 4095};
+	for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); ++b) {
+		check_bound(bounds[b], 0);
+		check_bound(bounds[b], 6);
+	}
+
+	/* Without cache mode there is no per-entry lifetime */
+	hashmap_s *map =
+		hm_new_config(&(hm_config_s){.key_type = HM_KEY_BYTES, .key_size = 4, .value_size = 4});
+	assert(map != NULL);
+	uint32_t key = 1;
+	assert(!hm_set_ttl(map, &key, &key, 10));
+	assert(hm_expire(map) == 0);
+	hm_free(map);
+
+	/* Flat entries cannot be tracked */
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.max_entries = 1000,
+		.backend = HM_BACKEND_FLAT,
+	};
+	assert(hm_new_config(&config) == NULL);
+	config.max_entries = 0;
+	config.ttl_ms = 10;
+	assert(hm_new_config(&config) == NULL);
+}
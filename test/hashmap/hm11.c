@@ -0,0 +1,112 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_KEYS 10000
+
+/* Every key lands in bucket 0 of its stripe's range: one long chain per stripe */
+static uint64_t hash_stripe_only(const void *key) {
+	return (uint64_t)(*(const uint32_t *)key % 4) << 62;
+}
+
+static void check_consistent(const hm_stats_s *stats) {
+	size_t entries = 0;
+	size_t longest = 0;
+	for (size_t i = 0; i < MYCLIB_HASHMAP_STATS_BINS; ++i) {
+		entries += stats->probes[i];
+		if (stats->probes[i] != 0) {
+			longest = i + 1;
+		}
+	}
+	assert(entries == stats->size);
+	assert(stats->max_probe >= longest);
+	assert(stats->used_buckets <= stats->size && stats->used_buckets <= stats->capacity);
+	if (stats->size != 0) {
+		assert(stats->used_buckets != 0 && stats->max_probe != 0);
+	}
+}
+
+static void check_backend(hm_backend_e backend, hm_lock_e lock_mode) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.backend = backend,
+		.lock_mode = lock_mode,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	hm_stats_s stats;
+	hm_stripe_stats_s *stripes = calloc(map->num_locks, sizeof(hm_stripe_stats_s));
+	assert(stripes != NULL);
+
+	assert(hm_stats(map, &stats, stripes));
+	assert(stats.size == 0 && stats.used_buckets == 0 && stats.max_probe == 0);
+	assert(stats.load_factor == 0 && stats.num_stripes == map->num_locks);
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_set(map, &key, &key));
+	}
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_contains(map, &key));
+	}
+
+	assert(hm_stats(map, &stats, stripes));
+	assert(stats.size == NUM_KEYS);
+	assert(stats.load_factor == (double)NUM_KEYS / (double)stats.capacity);
+	check_consistent(&stats);
+
+	hm_stripe_stats_s sum = {0};
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		sum.acquired += stripes[i].acquired;
+		sum.contended += stripes[i].contended;
+		sum.allocs += stripes[i].allocs;
+	}
+	assert(sum.acquired == stats.total.acquired);
+	assert(sum.contended == stats.total.contended);
+	assert(sum.allocs == stats.total.allocs);
+
+#ifdef MYCLIB_HASHMAP_STATS
+	/* Every set and lookup locked a stripe once, a single thread never waits */
+	assert(stats.total.acquired >= 2 * NUM_KEYS);
+	assert(stats.total.contended == 0);
+	assert(stats.total.allocs == (backend == HM_BACKEND_CHAINED ? NUM_KEYS : 0));
+#else
+	assert(stats.total.acquired == 0 && stats.total.allocs == 0);
+#endif
+
+	free(stripes);
+	hm_free(map);
+}
+
+int main(void) {
+	check_backend(HM_BACKEND_CHAINED, HM_LOCK_MUTEX);
+	check_backend(HM_BACKEND_CHAINED, HM_LOCK_RWLOCK);
+	check_backend(HM_BACKEND_FLAT, HM_LOCK_MUTEX);
+
+	/* A degenerate hash shows up as long chains in few buckets */
+	hm_config_s config = {
+		.hash = hash_stripe_only,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.capacity = 4 * NUM_KEYS,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+	for (uint32_t key = 0; key < 100; ++key) {
+		assert(hm_set(map, &key, &key));
+	}
+	hm_stats_s stats;
+	assert(hm_stats(map, &stats, NULL));
+	check_consistent(&stats);
+	assert(stats.used_buckets == 4);
+	assert(stats.max_probe == 25);
+	assert(stats.probes[MYCLIB_HASHMAP_STATS_BINS - 1] == 4 * (25 - MYCLIB_HASHMAP_STATS_BINS + 1));
+	hm_free(map);
+
+	assert(!hm_stats(NULL, &stats, NULL));
+}
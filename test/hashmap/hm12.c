@@ -0,0 +1,100 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_KEYS 5000
+
+static size_t hash_calls;
+
+static uint64_t counting_hash(const void *key) {
+	hash_calls++;
+	return hm_hash_u32(key);
+}
+
+static void check_counted(hm_backend_e backend) {
+	hm_config_s config = {
+		.hash = counting_hash,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.backend = backend,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	uint64_t *hashes = malloc(NUM_KEYS * sizeof(uint64_t));
+	assert(hashes != NULL);
+	hash_calls = 0;
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		hashes[key] = hm_hash(map, &key);
+		assert(hashes[key] == hm_hash_u32(&key));
+	}
+	assert(hash_calls == NUM_KEYS);
+
+	/* A known hash is never recomputed */
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		uint32_t value = key + 1;
+		assert(hm_set_with_hash(map, &key, &value, hashes[key]));
+	}
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		uint32_t value;
+		assert(hm_get_value_with_hash(map, &key, &value, hashes[key]));
+		assert(value == key + 1);
+		bucket_s *bucket = hm_get_with_hash(map, &key, hashes[key]);
+		assert(bucket != NULL && *(uint32_t *)bucket->value == key + 1);
+		hm_free_bucket(bucket);
+	}
+	for (uint32_t key = 0; key < NUM_KEYS; key += 2) {
+		assert(hm_remove_with_hash(map, &key, hashes[key]));
+		assert(!hm_remove_with_hash(map, &key, hashes[key]));
+	}
+	assert(hash_calls == NUM_KEYS);
+
+	/* Both entry points agree */
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		uint32_t value;
+		assert(hm_get_value(map, &key, &value) == (key % 2 == 1));
+	}
+	assert(hm_size(map) == NUM_KEYS / 2);
+
+	free(hashes);
+	hm_free(map);
+}
+
+static void check_strings(void) {
+	hashmap_s *map = hm_new_string(64, sizeof(int), 0);
+	assert(map != NULL);
+
+	char key[64] = {0};
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		snprintf(key, sizeof(key), "a rather long key shared by many entries %d", i);
+		uint64_t hash = hm_hash(map, key);
+		assert(hash == hm_hash_bytes(key, strlen(key), 0));
+		assert(hm_set_with_hash(map, key, &i, hash));
+	}
+
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		snprintf(key, sizeof(key), "a rather long key shared by many entries %d", i);
+		int value;
+		assert(hm_get_value(map, key, &value) && value == i);
+		assert(hm_get_value_with_hash(map, key, &value, hm_hash(map, key)) && value == i);
+	}
+
+	hm_free(map);
+}
+
+int main(void) {
+	check_counted(HM_BACKEND_CHAINED);
+	check_counted(HM_BACKEND_FLAT);
+	check_strings();
+
+	uint32_t key = 1;
+	assert(hm_hash(NULL, &key) == 0);
+	assert(!hm_set_with_hash(NULL, &key, &key, 0));
+	assert(hm_get_with_hash(NULL, &key, 0) == NULL);
+	assert(!hm_get_value_with_hash(NULL, &key, &key, 0));
+	assert(!hm_remove_with_hash(NULL, &key, 0));
+}
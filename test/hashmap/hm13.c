@@ -0,0 +1,164 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_KEYS 20000
+
+/* Longer than the largest arena class: such blobs get a chunk of their own */
+#define LARGE_LEN 100000
+
+static char large[LARGE_LEN];
+
+/* Key i and its value: lengths spread from inline sizes to several hundred bytes */
+static size_t make_key(char *buf, uint32_t i) {
+	int len = snprintf(buf, 512, "key-%u-", i);
+	while ((size_t)len < 4 + i % 300) {
+		buf[len++] = (char)('a' + i % 26);
+	}
+	return (size_t)len;
+}
+
+static size_t make_value(char *buf, uint32_t i, uint32_t round) {
+	size_t len = (i * 7 + round * 13) % 400;
+	for (size_t j = 0; j < len; ++j) {
+		buf[j] = (char)(i + j + round);
+	}
+	return len;
+}
+
+static void check_value(hashmap_s *map, uint32_t i, uint32_t round) {
+	char key[512];
+	char expected[512];
+	char value[512];
+	size_t key_len = make_key(key, i);
+	size_t expected_len = make_value(expected, i, round);
+
+	size_t value_len = sizeof(value);
+	assert(hm_get_var(map, key, key_len, value, &value_len));
+	assert(value_len == expected_len);
+	assert(memcmp(value, expected, value_len) == 0);
+}
+
+static size_t walked;
+
+static void check_entry(bucket_s *bucket) {
+	size_t key_len = hm_var_len(bucket->key);
+	assert(key_len >= 4 && memcmp(bucket->key, "key-", 4) == 0);
+	assert(hm_var_len(bucket->value) < 400);
+	walked++;
+}
+
+static void check_map(size_t inline_size, size_t max_entries) {
+	hm_config_s config = {
+		.variable = true,
+		.key_size = inline_size,
+		.value_size = inline_size,
+		.max_entries = max_entries,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	char key[512];
+	char value[512];
+	for (uint32_t round = 0; round < 2; ++round) {
+		for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+			size_t key_len = make_key(key, i);
+			size_t value_len = make_value(value, i, round);
+			assert(hm_set_var(map, key, key_len, value, value_len));
+		}
+	}
+
+	if (max_entries != 0) {
+		assert(hm_size(map) <= map->stripe_max * map->num_locks);
+		hm_free(map);
+		return;
+	}
+
+	/* Updates moved values between their node and the arena */
+	assert(hm_size(map) == NUM_KEYS);
+	for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+		check_value(map, i, 1);
+	}
+
+	walked = 0;
+	hm_foreach(map, check_entry);
+	assert(walked == NUM_KEYS);
+
+	/* A prefix or an extension of a key is another key */
+	size_t key_len = make_key(key, 7);
+	assert(!hm_get_var(map, key, key_len - 1, NULL, NULL));
+	key[key_len] = 'x';
+	assert(!hm_get_var(map, key, key_len + 1, NULL, NULL));
+
+	/* Too small a buffer gets the start of the value and its full length */
+	size_t value_len = 2;
+	uint32_t i = 99;
+	key_len = make_key(key, i);
+	assert(hm_get_var(map, key, key_len, value, &value_len));
+	assert(value_len == make_value(value + 2, i, 1));
+	assert(memcmp(value, value + 2, 2) == 0);
+
+	for (i = 0; i < NUM_KEYS; i += 2) {
+		key_len = make_key(key, i);
+		assert(hm_remove_var(map, key, key_len));
+		assert(!hm_remove_var(map, key, key_len));
+	}
+	assert(hm_size(map) == NUM_KEYS / 2);
+	for (i = 1; i < NUM_KEYS; i += 2) {
+		check_value(map, i, 1);
+	}
+
+	/* Empty values, and values beyond the largest arena class */
+	key_len = make_key(key, 0);
+	assert(hm_set_var(map, key, key_len, NULL, 0));
+	value_len = sizeof(value);
+	assert(hm_get_var(map, key, key_len, value, &value_len) && value_len == 0);
+	memset(large, 'L', sizeof(large));
+	assert(hm_set_var(map, large, sizeof(large), large, sizeof(large)));
+	assert(hm_set_var(map, large, sizeof(large), "small", 5));
+	value_len = sizeof(value);
+	assert(hm_get_var(map, large, sizeof(large), value, &value_len) && value_len == 5);
+	assert(hm_set_var(map, key, key_len, large, sizeof(large)));
+	assert(hm_get_var(map, key, key_len, NULL, &value_len) && value_len == sizeof(large));
+
+	hm_clear(map);
+	assert(hm_size(map) == 0);
+	assert(hm_set_var(map, key, key_len, large, sizeof(large)));
+	assert(hm_get_var(map, key, key_len, NULL, NULL));
+
+	hm_free(map);
+}
+
+int main(void) {
+	check_map(0, 0);
+	check_map(16, 0);
+	check_map(200, 0);
+	check_map(16, 1000);
+
+	hm_config_s config = {.variable = true, .key_size = 8, .value_size = 8};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	/* Fixed-size entry points do not apply */
+	uint64_t key = 1;
+	uint64_t value = 2;
+	assert(!hm_set(map, &key, &value));
+	assert(!hm_get_value(map, &key, &value));
+	assert(!hm_remove(map, &key));
+	size_t count;
+	assert(hm_get_keys(map, &count) == NULL);
+	hm_free(map);
+
+	/* Nor do variable ones to fixed maps */
+	map = hm_new_bytes(sizeof(key), sizeof(value), 0);
+	assert(map != NULL);
+	assert(!hm_set_var(map, &key, sizeof(key), &value, sizeof(value)));
+	assert(!hm_get_var(map, &key, sizeof(key), NULL, NULL));
+	hm_free(map);
+
+	config.backend = HM_BACKEND_FLAT;
+	assert(hm_new_config(&config) == NULL);
+}
@@ -0,0 +1,157 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define NUM_THREADS 4
+#define NUM_KEYS 1000
+#define ROUNDS 50
+
+static void add_one(const void *key, void *value, bool inserted, void *arg) {
+	(void)key;
+	(void)inserted;
+	(void)arg;
+	++*(uint64_t *)value;
+}
+
+static void record_insert(const void *key, void *value, bool inserted, void *arg) {
+	*(uint64_t *)value += *(const uint32_t *)key;
+	*(size_t *)arg += inserted;
+}
+
+static int counter(void *arg) {
+	hashmap_s *map = arg;
+	uint64_t zero = 0;
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+			if (!hm_upsert(map, &key, &zero, add_one, NULL)) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int cas_adder(void *arg) {
+	hashmap_s *map = arg;
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		for (int round = 0; round < ROUNDS; ++round) {
+			uint64_t expected = 0;
+			uint64_t desired;
+			do {
+				desired = expected + 1;
+			} while (!hm_cas(map, &key, &expected, &desired));
+		}
+	}
+
+	return 0;
+}
+
+static void run_threads(hashmap_s *map, thrd_start_t fn) {
+	thrd_t threads[NUM_THREADS];
+	for (int t = 0; t < NUM_THREADS; ++t) {
+		assert(thrd_create(&threads[t], fn, map) == thrd_success);
+	}
+	for (int t = 0; t < NUM_THREADS; ++t) {
+		int res;
+		thrd_join(threads[t], &res);
+		assert(res == 0);
+	}
+}
+
+static void check_map(hm_backend_e backend, hm_alloc_e alloc, hm_lock_e lock_mode) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint64_t),
+		.capacity = 1,
+		.backend = backend,
+		.alloc = alloc,
+		.lock_mode = lock_mode,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	/* Nothing to compute on or compare against yet */
+	uint32_t key = 5;
+	uint64_t value = 0;
+	uint64_t desired = 1;
+	assert(!hm_compute(map, &key, add_one, NULL));
+	assert(!hm_cas(map, &key, &value, &desired));
+	assert(hm_size(map) == 0);
+
+	/* Concurrent increments are never lost */
+	run_threads(map, counter);
+	assert(hm_size(map) == NUM_KEYS);
+	for (key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_get_value(map, &key, &value));
+		assert(value == (uint64_t)NUM_THREADS * ROUNDS);
+	}
+
+	/* The callback tells inserts from updates */
+	size_t inserts = 0;
+	uint64_t init = 0;
+	for (key = 0; key < 2 * NUM_KEYS; ++key) {
+		assert(hm_upsert(map, &key, &init, record_insert, &inserts));
+	}
+	assert(inserts == NUM_KEYS);
+	key = NUM_KEYS + 3;
+	assert(hm_get_value(map, &key, &value) && value == key);
+
+	for (key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_compute(map, &key, add_one, NULL));
+	}
+	key = 7;
+	assert(hm_get_value(map, &key, &value) && value == NUM_THREADS * ROUNDS + 7 + 1);
+
+	/* Get-or-insert keeps the first value */
+	bool inserted;
+	uint64_t out = 0;
+	key = 3 * NUM_KEYS;
+	value = 42;
+	assert(hm_get_or_insert(map, &key, &value, &out, &inserted));
+	assert(inserted && out == 42);
+	value = 43;
+	assert(hm_get_or_insert(map, &key, &value, &out, &inserted));
+	assert(!inserted && out == 42);
+	assert(hm_get_or_insert(map, &key, &value, NULL, NULL));
+
+	/* A failed swap reports the current value */
+	value = 0;
+	desired = 100;
+	assert(!hm_cas(map, &key, &value, &desired));
+	assert(value == 42);
+	assert(hm_cas(map, &key, &value, &desired));
+	assert(hm_get_value(map, &key, &value) && value == 100);
+
+	hm_clear(map);
+	init = 0;
+	for (key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_get_or_insert(map, &key, &init, NULL, NULL));
+	}
+	run_threads(map, cas_adder);
+	for (key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_get_value(map, &key, &value));
+		assert(value == (uint64_t)NUM_THREADS * ROUNDS);
+	}
+
+	hm_free(map);
+}
+
+int main(void) {
+	check_map(HM_BACKEND_CHAINED, HM_ALLOC_MALLOC, HM_LOCK_MUTEX);
+	check_map(HM_BACKEND_CHAINED, HM_ALLOC_POOL, HM_LOCK_RWLOCK);
+	check_map(HM_BACKEND_FLAT, HM_ALLOC_MALLOC, HM_LOCK_MUTEX);
+
+	uint32_t key = 1;
+	uint64_t value = 1;
+	assert(!hm_upsert(NULL, &key, &value, add_one, NULL));
+	assert(!hm_get_or_insert(NULL, &key, &value, NULL, NULL));
+	assert(!hm_cas(NULL, &key, &value, &value));
+	assert(!hm_compute(NULL, &key, add_one, NULL));
+}
@@ -0,0 +1,86 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define NUM_KEYS 1000
+
+struct record {
+	int id;
+	long score;
+};
+
+static uint64_t int_hash(const void *key) {
+	return *(const unsigned int *)key;
+}
+
+static bool int_equal(const void *key_a, const void *key_b) {
+	return *(const int *)key_a == *(const int *)key_b;
+}
+
+/* Called with the entry still inside the map, don't keep the pointers */
+static void read_score(const void *key, const void *value, void *arg) {
+	const struct record *record = value;
+	assert(record->id == *(const int *)key);
+	*(long *)arg = record->score;
+}
+
+/* Lookups that copy into the caller or look in place, never allocating a bucket */
+static void check_backend(hm_backend_e backend) {
+	hm_config_s config = {
+		.hash = int_hash,
+		.equal = int_equal,
+		.key_size = sizeof(int),
+		.value_size = sizeof(struct record),
+		.backend = backend,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		struct record record = {.id = i, .score = (long)i * 7};
+		assert(hm_set(map, &i, &record));
+	}
+
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		struct record record;
+		assert(hm_get_value(map, &i, &record));
+		assert(record.id == i && record.score == (long)i * 7);
+
+		long score = -1;
+		assert(hm_peek(map, &i, read_score, &score));
+		assert(score == (long)i * 7);
+		assert(hm_peek(map, &i, NULL, NULL));
+		assert(hm_contains(map, &i));
+	}
+
+	/* Missing keys leave the buffer untouched and never call back */
+	int missing = NUM_KEYS;
+	struct record untouched = {.id = -1, .score = -1};
+	assert(!hm_get_value(map, &missing, &untouched));
+	assert(untouched.id == -1 && untouched.score == -1);
+	long score = -1;
+	assert(!hm_peek(map, &missing, read_score, &score));
+	assert(score == -1);
+	assert(!hm_contains(map, &missing));
+
+	for (int i = 0; i < NUM_KEYS; i += 2) {
+		assert(hm_remove(map, &i));
+	}
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		struct record record;
+		assert(hm_get_value(map, &i, &record) == (i % 2 == 1));
+		assert(hm_contains(map, &i) == (i % 2 == 1));
+	}
+
+	assert(!hm_get_value(NULL, &missing, &untouched));
+	assert(!hm_get_value(map, NULL, &untouched));
+	assert(!hm_peek(NULL, &missing, read_score, &score));
+
+	hm_free(map);
+}
+
+int main(void) {
+	check_backend(HM_BACKEND_CHAINED);
+	check_backend(HM_BACKEND_FLAT);
+}
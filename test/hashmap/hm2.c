@@ -0,0 +1,188 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define NUM_KEYS 200000
+#define NUM_THREADS 4
+
+static uint64_t int_hash(const void *key) {
+	return *(const unsigned int *)key;
+}
+
+static bool int_equal(const void *key_a, const void *key_b) {
+	return *(const int *)key_a == *(const int *)key_b;
+}
+
+static int int_cmp(const void *a, const void *b) {
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+/* Counting variants: entries cache their hash, so neither should run more than needed */
+static size_t hash_calls;
+static size_t equal_calls;
+
+static uint64_t counting_hash(const void *key) {
+	hash_calls++;
+	return int_hash(key);
+}
+
+static bool counting_equal(const void *key_a, const void *key_b) {
+	equal_calls++;
+	return int_equal(key_a, key_b);
+}
+
+/* Each thread inserts its own slice of keys while the table keeps growing */
+struct worker_arg {
+	hashmap_s *map;
+	int first;
+	int last;
+};
+
+static int insert_worker(void *arg) {
+	struct worker_arg *wa = (struct worker_arg *)arg;
+
+	for (int i = wa->first; i < wa->last; ++i) {
+		int value = i * 2;
+		if (!hm_set(wa->map, &i, &value)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(void) {
+	/* Start tiny and let the map grow by itself */
+	hashmap_s *map = hm_new(int_hash, int_equal, NULL, NULL, sizeof(int), sizeof(int), 1);
+	assert(map != NULL);
+	assert(map->capacity == MYCLIB_HASHMAP_LOCKS);
+
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		int value = i;
+		assert(hm_set(map, &i, &value));
+	}
+	assert(hm_size(map) == NUM_KEYS);
+	assert(map->capacity >= NUM_KEYS);
+
+	/* Every key must be reachable, whether it was migrated or not */
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		bucket_s *b = hm_get(map, &i);
+		assert(b != NULL);
+		assert(*(int *)b->value == i);
+		hm_free_bucket(b);
+	}
+
+	/* Remove the odd keys */
+	for (int i = 1; i < NUM_KEYS; i += 2) {
+		assert(hm_remove(map, &i));
+	}
+	assert(hm_size(map) == NUM_KEYS / 2);
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		assert(hm_contains(map, &i) == (i % 2 == 0));
+	}
+
+	/* Packed snapshots: one buffer each, ready for qsort() */
+	size_t count = 0;
+	int *keys = hm_get_keys(map, &count);
+	assert(keys != NULL);
+	assert(count == NUM_KEYS / 2);
+	qsort(keys, count, sizeof(int), int_cmp);
+	for (size_t i = 0; i < count; ++i) {
+		assert(keys[i] == (int)i * 2);
+	}
+	free(keys);
+
+	int *values = hm_get_values(map, &count);
+	assert(values != NULL);
+	assert(count == NUM_KEYS / 2);
+	qsort(values, count, sizeof(int), int_cmp);
+	for (size_t i = 0; i < count; ++i) {
+		assert(values[i] == (int)i * 2);
+	}
+	free(values);
+
+	int *entries = hm_get_entries(map, &count);
+	assert(entries != NULL);
+	assert(count == NUM_KEYS / 2);
+	for (size_t i = 0; i < count; ++i) {
+		assert(entries[2 * i] == entries[2 * i + 1]);
+	}
+	free(entries);
+
+	hm_clear(map);
+	assert(hm_size(map) == 0);
+	hm_free(map);
+
+	/* Resizes reuse the cached hashes and lookups only compare keys whose hash matches */
+	hm_backend_e backends[] = {HM_BACKEND_CHAINED, HM_BACKEND_FLAT};
+	for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+		hm_config_s config = {
+			.hash = counting_hash,
+			.equal = counting_equal,
+			.key_size = sizeof(int),
+			.value_size = sizeof(int),
+			.capacity = 1,
+			.backend = backends[b],
+		};
+		map = hm_new_config(&config);
+		assert(map != NULL);
+
+		hash_calls = 0;
+		equal_calls = 0;
+		for (int i = 0; i < NUM_KEYS; ++i) {
+			assert(hm_set(map, &i, &i));
+		}
+		assert(hash_calls == NUM_KEYS);
+		assert(equal_calls == 0);
+
+		for (int i = 0; i < 2 * NUM_KEYS; ++i) {
+			assert(hm_contains(map, &i) == (i < NUM_KEYS));
+		}
+		assert(equal_calls == NUM_KEYS);
+
+		hm_free(map);
+	}
+
+	/* Concurrent inserts across resizes, with both stripe lock kinds */
+	hm_lock_e modes[] = {HM_LOCK_MUTEX, HM_LOCK_RWLOCK};
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+		hm_config_s config = {
+			.hash = int_hash,
+			.equal = int_equal,
+			.key_size = sizeof(int),
+			.value_size = sizeof(int),
+			.lock_mode = modes[m],
+			.num_stripes = 6,
+		};
+		map = hm_new_config(&config);
+		assert(map != NULL);
+		assert(map->num_locks == 8);
+		assert((uintptr_t)&map->locks[1] % MYCLIB_HASHMAP_CACHE_LINE == 0);
+
+		thrd_t threads[NUM_THREADS];
+		struct worker_arg args[NUM_THREADS];
+		int slice = NUM_KEYS / NUM_THREADS;
+		for (int t = 0; t < NUM_THREADS; ++t) {
+			args[t] = (struct worker_arg){.map = map, .first = t * slice, .last = (t + 1) * slice};
+			assert(thrd_create(&threads[t], insert_worker, &args[t]) == thrd_success);
+		}
+		for (int t = 0; t < NUM_THREADS; ++t) {
+			int res;
+			thrd_join(threads[t], &res);
+			assert(res == 0);
+		}
+
+		assert(hm_size(map) == (size_t)slice * NUM_THREADS);
+		for (int i = 0; i < slice * NUM_THREADS; ++i) {
+			int value;
+			assert(hm_get_value(map, &i, &value));
+			assert(value == i * 2);
+		}
+
+		hm_free(map);
+	}
+}
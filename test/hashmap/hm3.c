@@ -0,0 +1,117 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_KEYS 50000
+#define NUM_OPS 400000
+
+/* Value with stricter alignment than the key */
+struct point {
+	double x;
+	double y;
+};
+
+static uint64_t u32_hash(const void *key) {
+	return *(const uint32_t *)key * 2654435761u;
+}
+
+static bool u32_equal(const void *key_a, const void *key_b) {
+	return *(const uint32_t *)key_a == *(const uint32_t *)key_b;
+}
+
+static size_t visited;
+
+static void count_entry(bucket_s *bucket) {
+	struct point *p = (struct point *)bucket->value;
+	assert(p->x == (double)*(uint32_t *)bucket->key);
+	visited++;
+}
+
+int main(void) {
+	hm_config_s config = {
+		.hash = u32_hash,
+		.equal = u32_equal,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(struct point),
+		.backend = HM_BACKEND_FLAT,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+	assert(map->value_offset % _Alignof(double) == 0);
+
+	/* Inline storage cannot be released by user callbacks */
+	config.free_value = free;
+	assert(hm_new_config(&config) == NULL);
+
+	/* Random inserts, updates and removals checked against a reference table */
+	static bool present[NUM_KEYS];
+	static double version[NUM_KEYS];
+	size_t expected = 0;
+	uint32_t seed = 12345;
+
+	for (int op = 0; op < NUM_OPS; ++op) {
+		seed = seed * 1103515245u + 12345u;
+		uint32_t key = (seed >> 8) % NUM_KEYS;
+
+		if ((seed & 3) != 0) {
+			struct point p = {.x = key, .y = op};
+			assert(hm_set(map, &key, &p));
+			if (!present[key]) {
+				present[key] = true;
+				expected++;
+			}
+			version[key] = op;
+		} else {
+			assert(hm_remove(map, &key) == present[key]);
+			if (present[key]) {
+				present[key] = false;
+				expected--;
+			}
+		}
+	}
+	assert(hm_size(map) == expected);
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		bucket_s *b = hm_get(map, &key);
+		assert((b != NULL) == present[key]);
+		if (b != NULL) {
+			struct point *p = (struct point *)b->value;
+			assert(*(uint32_t *)b->key == key);
+			assert(p->x == key && p->y == version[key]);
+			hm_free_bucket(b);
+		}
+	}
+
+	hm_foreach(map, count_entry);
+	assert(visited == expected);
+
+	size_t count = 0;
+	uint32_t *keys = hm_get_keys(map, &count);
+	assert(count == expected);
+	for (size_t i = 0; i < count; ++i) {
+		assert(present[keys[i]]);
+	}
+	free(keys);
+
+	/* Entries pack the key right before its value */
+	unsigned char *entries = hm_get_entries(map, &count);
+	assert(count == expected);
+	for (size_t i = 0; i < count; ++i) {
+		unsigned char *record = entries + i * (sizeof(uint32_t) + sizeof(struct point));
+		uint32_t key;
+		struct point p;
+		memcpy(&key, record, sizeof(key));
+		memcpy(&p, record + sizeof(key), sizeof(p));
+		assert(p.x == key && p.y == version[key]);
+	}
+	free(entries);
+
+	hm_clear(map);
+	assert(hm_size(map) == 0);
+	uint32_t key = 7;
+	assert(!hm_contains(map, &key));
+
+	hm_free(map);
+}
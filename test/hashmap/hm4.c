@@ -0,0 +1,85 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define NUM_KEYS 5000
+
+static uint64_t int_hash(const void *key) {
+	return *(const unsigned int *)key;
+}
+
+static bool int_equal(const void *key_a, const void *key_b) {
+	return *(const int *)key_a == *(const int *)key_b;
+}
+
+/* Batched calls must behave exactly like the equivalent loop of single calls */
+static void check_backend(hm_backend_e backend) {
+	hm_config_s config = {
+		.hash = int_hash,
+		.equal = int_equal,
+		.key_size = sizeof(int),
+		.value_size = sizeof(long),
+		.capacity = 1,
+		.backend = backend,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	/* Large batch (heap path) that grows the map, with every key given twice */
+	int *keys = malloc(2 * NUM_KEYS * sizeof(int));
+	long *values = malloc(2 * NUM_KEYS * sizeof(long));
+	bool *found = malloc(2 * NUM_KEYS * sizeof(bool));
+	assert(keys != NULL && values != NULL && found != NULL);
+
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = i;
+		values[i] = -1;
+		keys[NUM_KEYS + i] = i;
+		values[NUM_KEYS + i] = (long)i * 3;
+	}
+	assert(hm_set_many(map, keys, values, 2 * NUM_KEYS) == 2 * NUM_KEYS);
+	assert(hm_size(map) == NUM_KEYS);
+
+	/* The last pair of a duplicated key wins */
+	for (int i = 0; i < NUM_KEYS; ++i) {
+		long value;
+		assert(hm_get_value(map, &i, &value));
+		assert(value == (long)i * 3);
+	}
+
+	/* Half of the keys are missing: their value slots stay untouched */
+	for (int i = 0; i < 2 * NUM_KEYS; ++i) {
+		keys[i] = i;
+		values[i] = -7;
+	}
+	assert(hm_get_many(map, keys, 2 * NUM_KEYS, values, found) == NUM_KEYS);
+	for (int i = 0; i < 2 * NUM_KEYS; ++i) {
+		assert(found[i] == (i < NUM_KEYS));
+		assert(values[i] == (i < NUM_KEYS ? (long)i * 3 : -7));
+	}
+
+	/* Small batch (stack path) in reverse order, without the found array */
+	int few_keys[8];
+	long few_values[8];
+	for (int i = 0; i < 8; ++i) {
+		few_keys[i] = NUM_KEYS + 3 - i;
+	}
+	assert(hm_get_many(map, few_keys, 8, few_values, NULL) == 4);
+	for (int i = 4; i < 8; ++i) {
+		assert(few_values[i] == (long)few_keys[i] * 3);
+	}
+
+	assert(hm_get_many(map, keys, 0, values, found) == 0);
+	assert(hm_set_many(map, keys, values, 0) == 0);
+
+	free(keys);
+	free(values);
+	free(found);
+	hm_free(map);
+}
+
+int main(void) {
+	check_backend(HM_BACKEND_CHAINED);
+	check_backend(HM_BACKEND_FLAT);
+}
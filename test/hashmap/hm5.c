@@ -0,0 +1,150 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_KEYS 100000
+
+struct coord {
+	int32_t x;
+	int32_t y;
+};
+
+static int popcount64(uint64_t x) {
+	int n = 0;
+	for (; x != 0; x &= x - 1) {
+		n++;
+	}
+	return n;
+}
+
+/* Built-in hashes: deterministic, seeded, and flipping any input bit flips about half the output */
+static void check_hash_bytes(void) {
+	unsigned char buf[128];
+	for (size_t i = 0; i < sizeof(buf); ++i) {
+		buf[i] = (unsigned char)(i * 31 + 7);
+	}
+
+	for (size_t len = 0; len <= sizeof(buf); ++len) {
+		uint64_t h = hm_hash_bytes(buf, len, 0);
+		assert(h == hm_hash_bytes(buf, len, 0));
+		assert(h != hm_hash_bytes(buf, len, 1));
+		if (len > 0) {
+			assert(h != hm_hash_bytes(buf, len - 1, 0));
+		}
+	}
+
+	size_t lens[] = {1, 3, 4, 8, 12, 16, 17, 32, 48, 49, 100};
+	for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+		uint64_t h = hm_hash_bytes(buf, lens[l], 0);
+		int flipped = 0;
+		for (size_t bit = 0; bit < lens[l] * 8; ++bit) {
+			buf[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+			flipped += popcount64(h ^ hm_hash_bytes(buf, lens[l], 0));
+			buf[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+		}
+		double average = (double)flipped / (double)(lens[l] * 8);
+		assert(average > 28.0 && average < 36.0);
+	}
+
+	uint32_t a = 42;
+	uint32_t b = 43;
+	assert(hm_hash_u32(&a) != hm_hash_u32(&b));
+	assert(hm_hash_int(a) == hm_hash_u32(&a));
+	assert(hm_equal_u32(&a, &a) && !hm_equal_u32(&a, &b));
+	assert(hm_hash_str("abc") == hm_hash_bytes("abc", 3, 0));
+	assert(hm_equal_str("abc", "abc") && !hm_equal_str("abc", "abd"));
+}
+
+/* Sequential integer keys must spread evenly over the buckets */
+static void check_distribution(void) {
+	hashmap_s *map = hm_new(hm_hash_u32, hm_equal_u32, NULL, NULL, sizeof(uint32_t),
+							sizeof(uint32_t), (size_t)1 << 18);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_set(map, &key, &key));
+	}
+
+	size_t longest = 0;
+	for (size_t i = 0; i < map->capacity; ++i) {
+		size_t len = 0;
+		for (bucket_s *b = map->map[i]; b != NULL; b = b->next) {
+			len++;
+		}
+		if (len > longest) {
+			longest = len;
+		}
+	}
+	assert(longest <= 10);
+
+	hm_free(map);
+}
+
+static void check_builtin_keys(void) {
+	/* Fixed-size struct keys, zeroed so that padding compares equal */
+	hashmap_s *map = hm_new_bytes(sizeof(struct coord), sizeof(int), 0);
+	assert(map != NULL);
+	for (int i = 0; i < 1000; ++i) {
+		struct coord c;
+		memset(&c, 0, sizeof(c));
+		c.x = i;
+		c.y = -i;
+		assert(hm_set(map, &c, &i));
+	}
+	for (int i = 0; i < 1000; ++i) {
+		struct coord c;
+		memset(&c, 0, sizeof(c));
+		c.x = i;
+		c.y = -i;
+		int value;
+		assert(hm_get_value(map, &c, &value));
+		assert(value == i);
+		c.y = i + 1;
+		assert(!hm_contains(map, &c));
+	}
+	hm_free(map);
+
+	/* String keys: bytes after the terminator are ignored, on both backends */
+	hm_backend_e backends[] = {HM_BACKEND_CHAINED, HM_BACKEND_FLAT};
+	for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+		hm_config_s config = {
+			.key_type = HM_KEY_STRING,
+			.key_size = 16,
+			.value_size = sizeof(int),
+			.backend = backends[b],
+		};
+		map = hm_new_config(&config);
+		assert(map != NULL);
+
+		char key[16];
+		memset(key, 'x', sizeof(key));
+		strcpy(key, "apple");
+		int value = 1;
+		assert(hm_set(map, key, &value));
+
+		char other[16];
+		memset(other, 'y', sizeof(other));
+		strcpy(other, "apple");
+		assert(hm_get_value(map, other, &value));
+		assert(value == 1);
+		strcpy(other, "apples");
+		assert(!hm_contains(map, other));
+
+		hm_free(map);
+	}
+
+	/* Custom keys still need both functions */
+	hm_config_s config = {
+		.key_size = sizeof(int),
+		.value_size = sizeof(int),
+	};
+	assert(hm_new_config(&config) == NULL);
+}
+
+int main(void) {
+	check_hash_bytes();
+	check_distribution();
+	check_builtin_keys();
+}
@@ -0,0 +1,123 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define NUM_KEYS 100000
+#define NUM_THREADS 4
+
+/* Value with stricter alignment than the key */
+struct point {
+	double x;
+	double y;
+};
+
+static size_t count_slabs(hashmap_s *map) {
+	size_t slabs = 0;
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		slabs += map->locks[i].pool.slabs != NULL;
+	}
+	return slabs;
+}
+
+static int insert_worker(void *arg) {
+	hashmap_s *map = arg;
+
+	/* Every thread writes every key: updates and inserts race on the same stripes */
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		struct point p = {.x = key, .y = -(double)key};
+		if (!hm_set(map, &key, &p)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(void) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(struct point),
+		.capacity = 1,
+		.alloc = HM_ALLOC_POOL,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+	assert(count_slabs(map) == 0);
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		struct point p = {.x = key, .y = -(double)key};
+		assert(hm_set(map, &key, &p));
+	}
+	assert(hm_size(map) == NUM_KEYS);
+
+	/* Entries live inside pool nodes, values stay aligned */
+	for (uint32_t key = 0; key < NUM_KEYS; key += 7) {
+		bucket_s *b = hm_get(map, &key);
+		assert(b != NULL);
+		assert(((struct point *)b->value)->x == key);
+		hm_free_bucket(b);
+	}
+
+	/* Updates happen in place */
+	uint32_t key = 5;
+	struct point p = {.x = 1.5, .y = 2.5};
+	assert(hm_set(map, &key, &p));
+	assert(hm_get_value(map, &key, &p));
+	assert(p.x == 1.5 && p.y == 2.5);
+
+	/* Removed nodes are reused before any new slab is carved */
+	struct hm_slab *newest[MYCLIB_HASHMAP_LOCKS];
+	size_t used[MYCLIB_HASHMAP_LOCKS];
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		newest[i] = map->locks[i].pool.slabs;
+		used[i] = map->locks[i].pool.slab_used;
+	}
+	for (key = 0; key < NUM_KEYS; key += 2) {
+		assert(hm_remove(map, &key));
+	}
+	for (key = 0; key < NUM_KEYS; key += 2) {
+		assert(hm_set(map, &key, &p));
+	}
+	for (size_t i = 0; i < map->num_locks; ++i) {
+		assert(map->locks[i].pool.slabs == newest[i]);
+		assert(map->locks[i].pool.slab_used == used[i]);
+	}
+	assert(hm_size(map) == NUM_KEYS);
+
+	/* Clear drops whole slabs, the map stays usable */
+	hm_clear(map);
+	assert(hm_size(map) == 0);
+	assert(count_slabs(map) == 0);
+	assert(!hm_contains(map, &key));
+	key = 3;
+	assert(hm_set(map, &key, &p));
+	assert(hm_contains(map, &key));
+	hm_free(map);
+
+	/* Concurrent writers, each stripe allocating from its own pool */
+	map = hm_new_config(&config);
+	assert(map != NULL);
+	thrd_t threads[NUM_THREADS];
+	for (int t = 0; t < NUM_THREADS; ++t) {
+		assert(thrd_create(&threads[t], insert_worker, map) == thrd_success);
+	}
+	for (int t = 0; t < NUM_THREADS; ++t) {
+		int res;
+		thrd_join(threads[t], &res);
+		assert(res == 0);
+	}
+	assert(hm_size(map) == NUM_KEYS);
+	for (key = 0; key < NUM_KEYS; ++key) {
+		assert(hm_get_value(map, &key, &p));
+		assert(p.x == key && p.y == -(double)key);
+	}
+	hm_free(map);
+
+	/* The pool owns keys and values */
+	config.free_value = free;
+	assert(hm_new_config(&config) == NULL);
+}
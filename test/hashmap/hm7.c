@@ -0,0 +1,124 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define NUM_KEYS 50000
+
+static bool seen[NUM_KEYS];
+
+/* Walk the whole map and check every key shows up exactly once with its value */
+static void check_walk(hashmap_s *map, size_t expected) {
+	for (size_t i = 0; i < NUM_KEYS; ++i) {
+		seen[i] = false;
+	}
+
+	size_t visited = 0;
+	hm_cursor_s cursor;
+	hm_cursor_init(&cursor, map);
+	for (bucket_s *b = hm_cursor_next(&cursor); b != NULL; b = hm_cursor_next(&cursor)) {
+		uint32_t key = *(uint32_t *)b->key;
+		assert(key < NUM_KEYS && !seen[key]);
+		assert(*(uint32_t *)b->value == key * 3);
+		seen[key] = true;
+		visited++;
+	}
+	assert(visited == expected);
+
+	/* Exhausted cursors stay exhausted and hold nothing */
+	assert(hm_cursor_next(&cursor) == NULL);
+	hm_cursor_close(&cursor);
+}
+
+static size_t foreach_visited;
+
+static void count_entry(bucket_s *bucket) {
+	assert(*(uint32_t *)bucket->value == *(uint32_t *)bucket->key * 3);
+	foreach_visited++;
+}
+
+static int writer(void *arg) {
+	hashmap_s *map = arg;
+
+	for (uint32_t key = NUM_KEYS; key < 2 * NUM_KEYS; ++key) {
+		uint32_t value = key * 3;
+		if (!hm_set(map, &key, &value)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(void) {
+	hm_backend_e backends[] = {HM_BACKEND_CHAINED, HM_BACKEND_FLAT};
+	hm_lock_e lock_modes[] = {HM_LOCK_MUTEX, HM_LOCK_RWLOCK};
+
+	for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+		for (size_t l = 0; l < sizeof(lock_modes) / sizeof(lock_modes[0]); ++l) {
+			hm_config_s config = {
+				.hash = hm_hash_u32,
+				.equal = hm_equal_u32,
+				.key_size = sizeof(uint32_t),
+				.value_size = sizeof(uint32_t),
+				.capacity = 1,
+				.backend = backends[b],
+				.lock_mode = lock_modes[l],
+			};
+			hashmap_s *map = hm_new_config(&config);
+			assert(map != NULL);
+			check_walk(map, 0);
+
+			/* A small initial table leaves the last resize unfinished */
+			for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+				uint32_t value = key * 3;
+				assert(hm_set(map, &key, &value));
+			}
+			check_walk(map, NUM_KEYS);
+
+			foreach_visited = 0;
+			hm_foreach(map, count_entry);
+			assert(foreach_visited == NUM_KEYS);
+
+			/* Only the stripe under the cursor is held: other stripes stay writable */
+			hm_cursor_s cursor;
+			hm_cursor_init(&cursor, map);
+			assert(hm_cursor_next(&cursor) != NULL);
+			if (lock_modes[l] == HM_LOCK_MUTEX) {
+				for (size_t i = 0; i < map->num_locks; ++i) {
+					int res = mtx_trylock(&map->locks[i].lock);
+					assert((res == thrd_success) == (i != cursor.stripe));
+					if (res == thrd_success) {
+						mtx_unlock(&map->locks[i].lock);
+					}
+				}
+			}
+			hm_cursor_close(&cursor);
+			assert(hm_cursor_next(&cursor) == NULL);
+
+			/* Walking while another thread writes: every key present from the start is seen */
+			thrd_t thread;
+			assert(thrd_create(&thread, writer, map) == thrd_success);
+			size_t old_keys = 0;
+			hm_cursor_init(&cursor, map);
+			for (bucket_s *e = hm_cursor_next(&cursor); e != NULL; e = hm_cursor_next(&cursor)) {
+				assert(*(uint32_t *)e->value == *(uint32_t *)e->key * 3);
+				old_keys += *(uint32_t *)e->key < NUM_KEYS;
+			}
+			int res;
+			thrd_join(thread, &res);
+			assert(res == 0);
+			assert(old_keys == NUM_KEYS);
+			assert(hm_size(map) == 2 * NUM_KEYS);
+
+			hm_free(map);
+		}
+	}
+
+	/* NULL-safe */
+	hm_cursor_s cursor;
+	hm_cursor_init(&cursor, NULL);
+	assert(hm_cursor_next(&cursor) == NULL);
+	hm_cursor_close(&cursor);
+}
@@ -0,0 +1,89 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_KEYS 200000
+
+static void check_contents(hashmap_s *map, uint32_t num_keys, uint64_t delta) {
+	assert(hm_size(map) == num_keys);
+	for (uint32_t key = 0; key < num_keys; ++key) {
+		uint64_t value;
+		assert(hm_get_value(map, &key, &value));
+		assert(value == (uint64_t)key + delta);
+	}
+}
+
+int main(void) {
+	uint32_t *keys = malloc(2 * NUM_KEYS * sizeof(uint32_t));
+	uint64_t *values = malloc(2 * NUM_KEYS * sizeof(uint64_t));
+	assert(keys != NULL && values != NULL);
+
+	/* Every key twice: the second, later pair must win */
+	for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = i;
+		values[i] = 0;
+		keys[NUM_KEYS + i] = NUM_KEYS - 1 - i;
+		values[NUM_KEYS + i] = NUM_KEYS - 1 - i;
+	}
+
+	hm_backend_e backends[] = {HM_BACKEND_CHAINED, HM_BACKEND_FLAT, HM_BACKEND_CHAINED};
+	hm_alloc_e allocs[] = {HM_ALLOC_MALLOC, HM_ALLOC_MALLOC, HM_ALLOC_POOL};
+	size_t thread_counts[] = {1, 3, 0, 1000};
+
+	for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+		for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t) {
+			hm_config_s config = {
+				.hash = hm_hash_u32,
+				.equal = hm_equal_u32,
+				.key_size = sizeof(uint32_t),
+				.value_size = sizeof(uint64_t),
+				.capacity = 1,
+				.backend = backends[b],
+				.alloc = allocs[b],
+			};
+			hashmap_s *map = hm_new_config(&config);
+			assert(map != NULL);
+
+			assert(hm_bulk_load(map, keys, values, 2 * NUM_KEYS, thread_counts[t]) ==
+				   2 * NUM_KEYS);
+			check_contents(map, NUM_KEYS, 0);
+
+			/* The table was sized up front instead of growing step by step */
+			if (backends[b] == HM_BACKEND_CHAINED) {
+				assert(map->old_map == NULL);
+				assert(map->capacity / MYCLIB_HASHMAP_LOAD_DEN * MYCLIB_HASHMAP_LOAD_NUM >=
+					   NUM_KEYS);
+			}
+
+			/* Loading into a populated map updates and inserts */
+			for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+				values[i] = (uint64_t)keys[i] + 1;
+			}
+			keys[NUM_KEYS] = NUM_KEYS;
+			values[NUM_KEYS] = NUM_KEYS + 1;
+			assert(hm_bulk_load(map, keys, values, NUM_KEYS + 1, thread_counts[t]) ==
+				   NUM_KEYS + 1);
+			check_contents(map, NUM_KEYS + 1, 1);
+
+			for (uint32_t i = 0; i < NUM_KEYS; ++i) {
+				values[i] = 0;
+			}
+			keys[NUM_KEYS] = NUM_KEYS - 1;
+			values[NUM_KEYS] = NUM_KEYS - 1;
+
+			/* The map still works normally afterwards */
+			uint32_t key = 3 * NUM_KEYS;
+			uint64_t value = 7;
+			assert(hm_set(map, &key, &value));
+			assert(hm_remove(map, &key));
+
+			hm_free(map);
+		}
+	}
+
+	assert(hm_bulk_load(NULL, keys, values, 1, 1) == 0);
+
+	free(keys);
+	free(values);
+}
@@ -0,0 +1,147 @@
+#include "../hashmap/myhashmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_KEYS 100000
+#define SNAPSHOT "hm9_snapshot.bin"
+
+/* Value with stricter alignment than the key */
+struct point {
+	double x;
+	double y;
+};
+
+static void check_numbers(hm_backend_e backend) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(struct point),
+		.backend = backend,
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < NUM_KEYS; key += 2) {
+		struct point p = {.x = key, .y = -(double)key};
+		assert(hm_set(map, &key, &p));
+	}
+	assert(hm_save(map, SNAPSHOT));
+
+	/* The snapshot does not depend on the map any more */
+	hm_free(map);
+
+	hm_mapped_s *mapped = hm_open_mapped(SNAPSHOT, &config);
+	assert(mapped != NULL);
+	assert(hm_mapped_size(mapped) == NUM_KEYS / 2);
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		const struct point *p = hm_mapped_get(mapped, &key);
+		if (key % 2 == 0) {
+			assert(p != NULL);
+			assert((uintptr_t)p % _Alignof(struct point) == 0);
+			assert(p->x == key && p->y == -(double)key);
+		} else {
+			assert(p == NULL);
+		}
+	}
+	hm_mapped_close(mapped);
+
+	/* The key handling must match the saved map */
+	config.value_size = sizeof(double);
+	assert(hm_open_mapped(SNAPSHOT, &config) == NULL);
+	config.value_size = sizeof(struct point);
+	config.key_type = HM_KEY_BYTES;
+	assert(hm_open_mapped(SNAPSHOT, &config) == NULL);
+}
+
+static void check_strings(void) {
+	hm_config_s config = {
+		.key_type = HM_KEY_STRING,
+		.key_size = 16,
+		.value_size = sizeof(int),
+	};
+	hashmap_s *map = hm_new_config(&config);
+	assert(map != NULL);
+
+	/* Empty maps save too */
+	assert(hm_save(map, SNAPSHOT));
+	hm_mapped_s *mapped = hm_open_mapped(SNAPSHOT, &config);
+	assert(mapped != NULL);
+	assert(hm_mapped_size(mapped) == 0);
+	char key[16] = "apple";
+	assert(hm_mapped_get(mapped, key) == NULL);
+	hm_mapped_close(mapped);
+
+	int value = 1;
+	assert(hm_set(map, key, &value));
+	strcpy(key, "pear");
+	value = 2;
+	assert(hm_set(map, key, &value));
+	assert(hm_save(map, SNAPSHOT));
+	hm_free(map);
+
+	mapped = hm_open_mapped(SNAPSHOT, &config);
+	assert(mapped != NULL);
+	memset(key, 'x', sizeof(key));
+	strcpy(key, "apple");
+	const int *found = hm_mapped_get(mapped, key);
+	assert(found != NULL && *found == 1);
+	strcpy(key, "pear");
+	found = hm_mapped_get(mapped, key);
+	assert(found != NULL && *found == 2);
+	strcpy(key, "plum");
+	assert(hm_mapped_get(mapped, key) == NULL);
+	hm_mapped_close(mapped);
+}
+
+static void check_corrupted(void) {
+	hashmap_s *map = hm_new_bytes(sizeof(uint64_t), sizeof(uint64_t), 0);
+	assert(map != NULL);
+	for (uint64_t key = 0; key < 100; ++key) {
+		assert(hm_set(map, &key, &key));
+	}
+	assert(hm_save(map, SNAPSHOT));
+	hm_free(map);
+
+	FILE *file = fopen(SNAPSHOT, "rb");
+	assert(file != NULL);
+	unsigned char buf[65536];
+	size_t size = fread(buf, 1, sizeof(buf), file);
+	fclose(file);
+	assert(size > 64 && size < sizeof(buf));
+
+	hm_config_s config = {
+		.key_type = HM_KEY_BYTES,
+		.key_size = sizeof(uint64_t),
+		.value_size = sizeof(uint64_t),
+	};
+
+	/* Truncated */
+	file = fopen(SNAPSHOT, "wb");
+	assert(file != NULL);
+	assert(fwrite(buf, 1, size - 1, file) == size - 1);
+	fclose(file);
+	assert(hm_open_mapped(SNAPSHOT, &config) == NULL);
+
+	/* Wrong magic */
+	buf[0] ^= 1;
+	file = fopen(SNAPSHOT, "wb");
+	assert(file != NULL);
+	assert(fwrite(buf, 1, size, file) == size);
+	fclose(file);
+	assert(hm_open_mapped(SNAPSHOT, &config) == NULL);
+
+	assert(hm_open_mapped("hm9_missing.bin", &config) == NULL);
+}
+
+int main(void) {
+	check_numbers(HM_BACKEND_CHAINED);
+	check_numbers(HM_BACKEND_FLAT);
+	check_strings();
+	check_corrupted();
+
+	remove(SNAPSHOT);
+}
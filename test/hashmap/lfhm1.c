@@ -0,0 +1,174 @@
+#include "../hashmap/mylfhashmap.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define NUM_KEYS 20000
+#define STABLE_KEYS 256
+#define NUM_WRITERS 2
+#define NUM_READERS 4
+#define ROUNDS 20
+
+static uint64_t int_hash(const void *key) {
+	return *(const unsigned int *)key;
+}
+
+static bool int_equal(const void *key_a, const void *key_b) {
+	return *(const int *)key_a == *(const int *)key_b;
+}
+
+/* Values carry their key in the high half and a per-key version in the low half */
+static uint64_t make_value(int key, uint32_t version) {
+	return (uint64_t)key << 32 | version;
+}
+
+static atomic_bool done;
+
+struct writer_arg {
+	lfhashmap_s *map;
+	int id;
+};
+
+/*
+ * Each key has a single writer, so its versions only go up. Stable keys are always present,
+ * the others are inserted (growing the table under the readers) then removed and reinserted.
+ */
+static int writer(void *arg) {
+	struct writer_arg *wa = (struct writer_arg *)arg;
+	lfhm_thread_s *thread = lfhm_thread_register(wa->map);
+	if (thread == NULL) {
+		return 1;
+	}
+
+	uint32_t *versions = calloc(NUM_KEYS, sizeof(uint32_t));
+	if (versions == NULL) {
+		return 1;
+	}
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (int key = wa->id; key < NUM_KEYS; key += NUM_WRITERS) {
+			uint64_t value = make_value(key, ++versions[key]);
+			if (!lfhm_set(thread, &key, &value)) {
+				return 1;
+			}
+		}
+		for (int key = STABLE_KEYS + wa->id; key < NUM_KEYS; key += NUM_WRITERS) {
+			if (round % 2 == 1 && !lfhm_remove(thread, &key)) {
+				return 1;
+			}
+		}
+	}
+
+	free(versions);
+	lfhm_thread_unregister(thread);
+
+	return 0;
+}
+
+static int reader(void *arg) {
+	lfhashmap_s *map = arg;
+	lfhm_thread_s *thread = lfhm_thread_register(map);
+	if (thread == NULL) {
+		return 1;
+	}
+
+	uint32_t *seen = calloc(NUM_KEYS, sizeof(uint32_t));
+	if (seen == NULL) {
+		return 1;
+	}
+
+	uint32_t seed = (uint32_t)(uintptr_t)thread;
+	while (!atomic_load(&done)) {
+		seed = seed * 1103515245u + 12345u;
+		int key = (int)((seed >> 8) % NUM_KEYS);
+
+		uint64_t value;
+		bool found = lfhm_get(thread, &key, &value);
+		if (key < STABLE_KEYS && !found) {
+			return 2;
+		}
+		if (!found) {
+			continue;
+		}
+
+		uint32_t version = (uint32_t)value;
+		if ((int)(value >> 32) != key || version < seen[key]) {
+			return 3;
+		}
+		seen[key] = version;
+	}
+
+	free(seen);
+	lfhm_thread_unregister(thread);
+
+	return 0;
+}
+
+int main(void) {
+	lfhashmap_s *map = lfhm_new(int_hash, int_equal, sizeof(int), sizeof(uint64_t), 1);
+	assert(map != NULL);
+
+	/* Writer stripes never share a cache line */
+	assert(map->num_locks > 1);
+	assert((uintptr_t)&map->locks[1] % MYCLIB_HASHMAP_CACHE_LINE == 0);
+
+	lfhm_thread_s *thread = lfhm_thread_register(map);
+	assert(thread != NULL);
+
+	for (int key = 0; key < STABLE_KEYS; ++key) {
+		uint64_t value = make_value(key, 0);
+		assert(lfhm_set(thread, &key, &value));
+	}
+	assert(lfhm_size(map) == STABLE_KEYS);
+
+	int key = 7;
+	uint64_t value = 0;
+	assert(lfhm_get(thread, &key, &value));
+	assert(value == make_value(7, 0));
+	assert(lfhm_peek(thread, &key, NULL, NULL));
+	key = NUM_KEYS;
+	assert(!lfhm_get(thread, &key, &value));
+	assert(!lfhm_remove(thread, &key));
+
+	/* A released record is handed out again */
+	lfhm_thread_unregister(thread);
+	assert(lfhm_thread_register(map) == thread);
+
+	thrd_t writers[NUM_WRITERS];
+	struct writer_arg args[NUM_WRITERS];
+	thrd_t readers[NUM_READERS];
+	for (int r = 0; r < NUM_READERS; ++r) {
+		assert(thrd_create(&readers[r], reader, map) == thrd_success);
+	}
+	for (int w = 0; w < NUM_WRITERS; ++w) {
+		args[w] = (struct writer_arg){.map = map, .id = w};
+		assert(thrd_create(&writers[w], writer, &args[w]) == thrd_success);
+	}
+
+	for (int w = 0; w < NUM_WRITERS; ++w) {
+		int res;
+		thrd_join(writers[w], &res);
+		assert(res == 0);
+	}
+	atomic_store(&done, true);
+	for (int r = 0; r < NUM_READERS; ++r) {
+		int res;
+		thrd_join(readers[r], &res);
+		assert(res == 0);
+	}
+
+	/* ROUNDS is even: the last round removed every non stable key */
+	assert(lfhm_size(map) == STABLE_KEYS);
+	assert(atomic_load(&map->table)->capacity > MYCLIB_HASHMAP_LOCKS);
+	for (key = 0; key < NUM_KEYS; ++key) {
+		assert(lfhm_get(thread, &key, &value) == (key < STABLE_KEYS));
+		if (key < STABLE_KEYS) {
+			assert(value == make_value(key, ROUNDS));
+		}
+	}
+
+	lfhm_thread_unregister(thread);
+	lfhm_free(map);
+}
@@ -0,0 +1,236 @@
+#include "../hashmap/myshardmap.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#define NUM_KEYS 100000
+#define NUM_THREADS 4
+
+struct writer_arg {
+	shardmap_s *map;
+	uint32_t first;
+};
+
+/* Writers share the map but not their keys */
+static int writer(void *arg) {
+	struct writer_arg *wa = (struct writer_arg *)arg;
+
+	for (uint32_t key = wa->first; key < NUM_KEYS; key += NUM_THREADS) {
+		uint64_t value = (uint64_t)key * 3;
+		if (!smap_set(wa->map, &key, &value)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void check_concurrent(hm_backend_e backend) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint64_t),
+		.capacity = 1,
+		.backend = backend,
+	};
+	shardmap_s *map = smap_new(&config, 0);
+	assert(map != NULL);
+	assert(map->num_shards == MYCLIB_SHARDMAP_SHARDS);
+
+	thrd_t threads[NUM_THREADS];
+	struct writer_arg args[NUM_THREADS];
+	for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+		args[i] = (struct writer_arg){.map = map, .first = i};
+		assert(thrd_create(&threads[i], writer, &args[i]) == thrd_success);
+	}
+	for (int i = 0; i < NUM_THREADS; ++i) {
+		int res;
+		assert(thrd_join(threads[i], &res) == thrd_success);
+		assert(res == 0);
+	}
+
+	assert(smap_size(map) == NUM_KEYS);
+
+	/* Every shard got a share of the keys, and only its own keys */
+	size_t total = 0;
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		hashmap_s *shard = smap_shard(map, i);
+		assert(shard != NULL);
+		assert(hm_size(shard) > NUM_KEYS / map->num_shards / 2);
+		total += hm_size(shard);
+	}
+	assert(total == NUM_KEYS);
+	assert(smap_shard(map, map->num_shards) == NULL);
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		uint64_t value;
+		assert(smap_get_value(map, &key, &value));
+		assert(value == (uint64_t)key * 3);
+		assert(hm_get_value(smap_shard(map, smap_shard_index(map, &key)), &key, &value));
+	}
+
+	for (uint32_t key = 0; key < NUM_KEYS; key += 2) {
+		assert(smap_remove(map, &key));
+		assert(!smap_remove(map, &key));
+	}
+	assert(smap_size(map) == NUM_KEYS / 2);
+	for (uint32_t key = 0; key < 100; ++key) {
+		uint64_t value;
+		assert(smap_get_value(map, &key, &value) == (key % 2 == 1));
+	}
+
+	smap_clear(map);
+	assert(smap_size(map) == 0);
+
+	smap_free(map);
+}
+
+static void check_strings(void) {
+	hm_config_s config = {
+		.key_type = HM_KEY_STRING,
+		.key_size = 16,
+		.value_size = sizeof(int),
+	};
+	shardmap_s *map = smap_new(&config, 3);
+	assert(map != NULL);
+	assert(map->num_shards == 4);
+
+	/* Only the string itself picks the shard, not the bytes after it */
+	char key[16] = "apple";
+	int value = 1;
+	assert(smap_set(map, key, &value));
+	size_t index = smap_shard_index(map, key);
+	memset(key, 'x', sizeof(key));
+	strcpy(key, "apple");
+	assert(smap_shard_index(map, key) == index);
+	value = 0;
+	assert(smap_get_value(map, key, &value));
+	assert(value == 1);
+	assert(smap_size(map) == 1);
+
+	smap_free(map);
+}
+
+struct place_arg {
+	shardmap_s *map;
+	size_t index;
+	hashmap_s *shard;
+};
+
+/* Stands for a thread bound to the NUMA node the shard should live on */
+static int place(void *arg) {
+	struct place_arg *pa = (struct place_arg *)arg;
+	pa->shard = smap_shard(pa->map, pa->index);
+	return pa->shard == NULL;
+}
+
+static int write_one(void *arg) {
+	struct place_arg *pa = (struct place_arg *)arg;
+	uint32_t key = (uint32_t)pa->index;
+	return !smap_set(pa->map, &key, &key);
+}
+
+static void check_placement(void) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+	};
+	shardmap_s *map = smap_new(&config, 4);
+	assert(map != NULL);
+
+	/* No shard exists before it is used, and reads do not create one */
+	uint32_t key = 7;
+	uint32_t value;
+	assert(!smap_get_value(map, &key, &value));
+	assert(!smap_remove(map, &key));
+	assert(smap_size(map) == 0);
+	smap_clear(map);
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		assert(atomic_load(&map->shards[i]) == NULL);
+	}
+
+	/* Each shard is created by the thread that asks for it, one thread at a time */
+	struct place_arg args[4];
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		args[i] = (struct place_arg){.map = map, .index = i};
+		thrd_t thread;
+		int res;
+		assert(thrd_create(&thread, place, &args[i]) == thrd_success);
+		assert(thrd_join(thread, &res) == thrd_success && res == 0);
+		assert(atomic_load(&map->shards[i]) == args[i].shard);
+		for (size_t j = i + 1; j < map->num_shards; ++j) {
+			assert(atomic_load(&map->shards[j]) == NULL);
+		}
+	}
+
+	/* Writes go to the shards already placed */
+	assert(smap_set(map, &key, &key));
+	size_t index = smap_shard_index(map, &key);
+	assert(smap_shard(map, index) == args[index].shard);
+	assert(hm_size(args[index].shard) == 1);
+	smap_free(map);
+
+	/* A writer creates the shard of its key, and only that one */
+	map = smap_new(&config, 4);
+	assert(map != NULL);
+	struct place_arg arg = {.map = map, .index = 12345};
+	thrd_t thread;
+	int res;
+	assert(thrd_create(&thread, write_one, &arg) == thrd_success);
+	assert(thrd_join(thread, &res) == thrd_success && res == 0);
+	key = 12345;
+	index = smap_shard_index(map, &key);
+	for (size_t i = 0; i < map->num_shards; ++i) {
+		assert((atomic_load(&map->shards[i]) != NULL) == (i == index));
+	}
+	assert(smap_get_value(map, &key, &value) && value == key);
+	smap_free(map);
+}
+
+/* Split bounds add up to max_entries at most, never more */
+static void check_bound(size_t max_entries, size_t num_shards) {
+	hm_config_s config = {
+		.hash = hm_hash_u32,
+		.equal = hm_equal_u32,
+		.key_size = sizeof(uint32_t),
+		.value_size = sizeof(uint32_t),
+		.max_entries = max_entries,
+	};
+	shardmap_s *map = smap_new(&config, num_shards);
+	assert(map != NULL);
+
+	for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+		assert(smap_set(map, &key, &key));
+	}
+	assert(smap_size(map) <= max_entries);
+	assert(smap_size(map) >= max_entries / 2);
+
+	smap_free(map);
+}
+
+int main(void) {
+	check_concurrent(HM_BACKEND_CHAINED);
+	check_concurrent(HM_BACKEND_FLAT);
+	check_strings();
+	check_placement();
+	check_bound(17, 16);
+	check_bound(1000, 16);
+	check_bound(1001, 4);
+
+	hm_config_s config = {.key_size = sizeof(uint32_t), .value_size = sizeof(uint32_t)};
+	/* Invalid configurations are rejected like by hm_new_config() */
+	assert(smap_new(&config, 4) == NULL);
+	config.variable = true;
+	assert(smap_new(&config, 4) == NULL);
+	assert(smap_new(NULL, 4) == NULL);
+	config = (hm_config_s){.key_type = HM_KEY_BYTES, .key_size = 4, .value_size = 4};
+	config.max_entries = 15;
+	assert(smap_new(&config, 16) == NULL);
+	smap_free(NULL);
+	assert(smap_size(NULL) == 0);
+}
@@ -0,0 +1,76 @@
+#include "../vector/myvector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <threads.h>
+
+#define NUM_ELEMS 100000
+
+/* Pushes one element, which has to wait for the view to end */
+static int pusher(void *arg) {
+	uint64_t value = NUM_ELEMS;
+	return vec_push((vec_s *)arg, &value);
+}
+
+int main(void) {
+	vec_s *v = vec_new(0, sizeof(uint64_t));
+	assert(v != NULL);
+
+	for (uint64_t i = 0; i < NUM_ELEMS; ++i) {
+		assert(vec_push(v, &i) == 0);
+	}
+
+	/* Copies go to caller buffers */
+	uint64_t value = 0;
+	assert(vec_get_into(v, 42, &value) == 0);
+	assert(value == 42);
+	assert(vec_get_into(v, NUM_ELEMS, &value) == -1);
+	assert(vec_get_into(v, 0, NULL) == -1);
+
+	/* Borrowed pointers see the stored elements */
+	uint64_t *at = vec_at(v, 7);
+	assert(at != NULL && *at == 7);
+	*at = 70;
+	assert(vec_get_into(v, 7, &value) == 0);
+	assert(value == 70);
+	*at = 7;
+	assert(vec_at(v, NUM_ELEMS) == NULL);
+	assert(vec_at(NULL, 0) == NULL);
+
+	/* A view scans and updates in place under a single lock */
+	vec_view_s view;
+	assert(vec_view_begin(v, &view) == 0);
+	assert(view.size == NUM_ELEMS);
+	assert(view.elem_size == sizeof(uint64_t));
+
+	thrd_t thread;
+	assert(thrd_create(&thread, pusher, v) == thrd_success);
+
+	uint64_t *elems = view.data;
+	uint64_t sum = 0;
+	for (size_t i = 0; i < view.size; ++i) {
+		sum += elems[i];
+		elems[i] *= 2;
+	}
+	assert(sum == (uint64_t)NUM_ELEMS * (NUM_ELEMS - 1) / 2);
+	assert(vec_at(v, 3) == &elems[3]);
+	vec_view_end(&view);
+	assert(view.data == NULL);
+	vec_view_end(&view);
+
+	int res;
+	assert(thrd_join(thread, &res) == thrd_success);
+	assert(res == 0);
+	assert(vec_size(v) == NUM_ELEMS + 1);
+
+	assert(vec_pop_into(v, &value) == 0);
+	assert(value == NUM_ELEMS);
+	assert(vec_pop_into(v, &value) == 0);
+	assert(value == 2 * (NUM_ELEMS - 1));
+	assert(vec_size(v) == NUM_ELEMS - 1);
+
+	assert(vec_clear(v) == 0);
+	assert(vec_pop_into(v, &value) == -1);
+	assert(vec_view_begin(NULL, &view) == -1);
+
+	vec_free(v);
+}
@@ -0,0 +1,93 @@
+#include "../vector/myvector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_ELEMS 1000000
+
+static void check_range(vec_s *v, size_t from, size_t count, int first) {
+	for (size_t i = 0; i < count; ++i) {
+		int *elem = vec_at(v, from + i);
+		assert(elem != NULL && *elem == first + (int)i);
+	}
+}
+
+int main(void) {
+	int *elems = malloc(NUM_ELEMS * sizeof(int));
+	assert(elems != NULL);
+	for (int i = 0; i < NUM_ELEMS; ++i) {
+		elems[i] = i;
+	}
+
+	vec_s *v = vec_new(0, sizeof(int));
+	assert(v != NULL);
+
+	/* A bulk push grows once, to the next power of two */
+	assert(vec_push_n(v, elems, NUM_ELEMS) == 0);
+	assert(vec_size(v) == NUM_ELEMS);
+	assert(vec_cap(v) == 1u << 20);
+	check_range(v, 0, NUM_ELEMS, 0);
+	assert(vec_push_n(v, NULL, 0) == 0);
+	assert(vec_push_n(v, NULL, 1) == -1);
+
+	/* [0, 1000) [0, 10) [1000, ...) */
+	assert(vec_insert_range(v, 1000, elems, 10) == 0);
+	assert(vec_size(v) == NUM_ELEMS + 10);
+	check_range(v, 0, 1000, 0);
+	check_range(v, 1000, 10, 0);
+	check_range(v, 1010, NUM_ELEMS - 1000, 1000);
+	assert(vec_insert_range(v, vec_size(v) + 1, elems, 1) == -1);
+
+	/* At both ends */
+	assert(vec_insert_range(v, 0, elems + 5, 2) == 0);
+	check_range(v, 0, 2, 5);
+	assert(vec_insert_range(v, vec_size(v), elems + 7, 3) == 0);
+	check_range(v, NUM_ELEMS + 12, 3, 7);
+
+	assert(vec_remove_range(v, NUM_ELEMS + 12, 3) == 0);
+	assert(vec_remove_range(v, 0, 2) == 0);
+	assert(vec_remove_range(v, 1000, 10) == 0);
+	assert(vec_size(v) == NUM_ELEMS);
+	check_range(v, 0, NUM_ELEMS, 0);
+
+	/* Out of range, nothing is removed */
+	assert(vec_remove_range(v, NUM_ELEMS - 1, 2) == -1);
+	assert(vec_remove_range(v, NUM_ELEMS + 1, 0) == -1);
+	assert(vec_remove_range(v, 10, SIZE_MAX) == -1);
+	assert(vec_remove_range(v, NUM_ELEMS, 0) == 0);
+	assert(vec_size(v) == NUM_ELEMS);
+
+	/* Erase most of it in one pass */
+	assert(vec_remove_range(v, 10, NUM_ELEMS - 20) == 0);
+	assert(vec_size(v) == 20);
+	check_range(v, 0, 10, 0);
+	check_range(v, 10, 10, NUM_ELEMS - 10);
+
+	/* Reserve never shrinks */
+	assert(vec_shrink(v) == 0);
+	assert(vec_cap(v) == 20);
+	assert(vec_reserve(v, 100) == 0);
+	assert(vec_cap(v) == 100);
+	assert(vec_reserve(v, 50) == 0);
+	assert(vec_cap(v) == 100);
+	assert(vec_reserve(v, SIZE_MAX) == -1);
+	assert(vec_cap(v) == 100);
+
+	/* Growing zero-fills, shrinking keeps the prefix */
+	assert(vec_resize(v, 5) == 0);
+	check_range(v, 0, 5, 0);
+	assert(vec_resize(v, 200) == 0);
+	assert(vec_size(v) == 200);
+	for (size_t i = 5; i < 200; ++i) {
+		assert(*(int *)vec_at(v, i) == 0);
+	}
+	assert(vec_resize(v, 0) == 0);
+	assert(vec_size(v) == 0);
+	assert(vec_resize(v, SIZE_MAX) == -1);
+
+	assert(vec_push_n(NULL, elems, 1) == -1);
+	assert(vec_reserve(NULL, 1) == -1);
+
+	vec_free(v);
+	free(elems);
+}
@@ -0,0 +1,57 @@
+#include "../vector/myvector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NUM_ELEMS 100000
+
+int main(void) {
+	vec_s *v = vec_new_unsync(0, sizeof(uint32_t));
+	assert(v != NULL);
+	assert(v->unsync);
+	assert(vec_cap(v) == 1);
+
+	/* The whole API works the same without the lock */
+	for (uint32_t i = 0; i < NUM_ELEMS; ++i) {
+		assert(vec_push(v, &i) == 0);
+	}
+	assert(vec_size(v) == NUM_ELEMS);
+
+	uint32_t value;
+	assert(vec_get_into(v, 123, &value) == 0);
+	assert(value == 123);
+	uint32_t *copy = vec_get(v, 5);
+	assert(copy != NULL && *copy == 5);
+	free(copy);
+
+	value = 7;
+	assert(vec_set(v, 0, &value) == 0);
+	assert(vec_insert(v, 1, &value) == 0);
+	assert(vec_remove(v, 1) == 0);
+	assert(vec_remove_range(v, 10, 10) == 0);
+	assert(vec_size(v) == NUM_ELEMS - 10);
+
+	vec_view_s view;
+	assert(vec_view_begin(v, &view) == 0);
+	uint32_t *elems = view.data;
+	assert(elems[0] == 7 && elems[10] == 20);
+	/* Nothing is held, the same thread can keep calling in */
+	assert(vec_size(v) == view.size);
+	vec_view_end(&view);
+
+	assert(vec_pop_into(v, &value) == 0);
+	assert(value == NUM_ELEMS - 1);
+	assert(vec_shrink(v) == 0);
+	assert(vec_cap(v) == NUM_ELEMS - 11);
+	assert(vec_clear(v) == 0);
+	assert(vec_size(v) == 0);
+
+	vec_free(v);
+
+	assert(vec_new_unsync(1, 0) == NULL);
+
+	/* Locked vectors stay locked */
+	v = vec_new(1, sizeof(uint32_t));
+	assert(v != NULL && !v->unsync);
+	vec_free(v);
+}
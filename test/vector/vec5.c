@@ -0,0 +1,247 @@
+#include "../vector/myvector.h"
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIG 100000
+
+/* Elements start with an int32_t key, the rest is payload */
+static size_t elem_size;
+
+static int key_cmp(const void *a, const void *b) {
+	int32_t ka;
+	int32_t kb;
+	memcpy(&ka, a, sizeof(ka));
+	memcpy(&kb, b, sizeof(kb));
+	return (ka > kb) - (ka < kb);
+}
+
+/* Total order on the whole element, to compare contents regardless of the order of ties */
+static int bytes_cmp(const void *a, const void *b) {
+	int res = key_cmp(a, b);
+	return res != 0 ? res : memcmp(a, b, elem_size);
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t next_random(void) {
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 1;
+}
+
+enum pattern { RANDOM, SORTED, REVERSED, FEW, EQUAL };
+
+static void fill(unsigned char *elems, size_t n, enum pattern pattern) {
+	for (size_t i = 0; i < n; ++i) {
+		unsigned char *elem = elems + i * elem_size;
+		for (size_t b = 0; b < elem_size; ++b) {
+			elem[b] = (unsigned char)next_random();
+		}
+
+		int32_t key = 0;
+		switch (pattern) {
+		case RANDOM:
+			key = (int32_t)next_random() - INT32_MAX / 2;
+			break;
+		case SORTED:
+			key = (int32_t)i;
+			break;
+		case REVERSED:
+			key = -(int32_t)i;
+			break;
+		case FEW:
+			key = (int32_t)(next_random() % 4);
+			break;
+		case EQUAL:
+			key = 7;
+			break;
+		}
+		memcpy(elem, &key, sizeof(key));
+	}
+}
+
+/* threads == 0 runs vec_sort() */
+static void check_sort(size_t n, enum pattern pattern, size_t threads) {
+	vec_s *v = vec_new(n, elem_size);
+	assert(v != NULL);
+
+	unsigned char *expected = malloc(n * elem_size + 1);
+	assert(expected != NULL);
+	fill(expected, n, pattern);
+	assert(vec_push_n(v, expected, n) == 0);
+
+	if (threads == 0) {
+		assert(vec_sort(v, key_cmp) == 0);
+	} else {
+		assert(vec_sort_parallel(v, key_cmp, threads) == 0);
+	}
+
+	assert(vec_size(v) == n);
+	for (size_t i = 1; i < n; ++i) {
+		assert(key_cmp(vec_at(v, i - 1), vec_at(v, i)) <= 0);
+	}
+
+	/* Same elements as before */
+	qsort(expected, n, elem_size, bytes_cmp);
+	qsort(v->data, n, elem_size, bytes_cmp);
+	assert(n == 0 || memcmp(expected, v->data, n * elem_size) == 0);
+
+	free(expected);
+	vec_free(v);
+}
+
+static void check_comparison_sorts(void) {
+	size_t sizes[] = {4, 8, 16, 24};
+	size_t counts[] = {0, 1, 2, 3, 16, 17, 100, 1000};
+	size_t threads[] = {0, 1, 3, 4, 64};
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		elem_size = sizes[s];
+		for (int p = RANDOM; p <= EQUAL; ++p) {
+			for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+				check_sort(counts[c], (enum pattern)p, 0);
+			}
+			for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+				check_sort(BIG, (enum pattern)p, threads[t]);
+			}
+		}
+	}
+
+	assert(vec_sort(NULL, key_cmp) == -1);
+	assert(vec_sort_parallel(NULL, key_cmp, 2) == -1);
+}
+
+struct record {
+	uint32_t seq;
+	float f;
+	int64_t i;
+	double d;
+};
+
+static bool radix_le(const struct record *a, const struct record *b, vec_key_e key_type) {
+	switch (key_type) {
+	case VEC_KEY_U32:
+		return a->seq <= b->seq;
+	case VEC_KEY_F32:
+		return a->f <= b->f;
+	case VEC_KEY_I64:
+		return a->i <= b->i;
+	default:
+		return a->d <= b->d;
+	}
+}
+
+static bool radix_same(const struct record *a, const struct record *b, vec_key_e key_type) {
+	switch (key_type) {
+	case VEC_KEY_U32:
+		return a->seq == b->seq;
+	case VEC_KEY_F32:
+		return memcmp(&a->f, &b->f, sizeof(a->f)) == 0;
+	case VEC_KEY_I64:
+		return a->i == b->i;
+	default:
+		return memcmp(&a->d, &b->d, sizeof(a->d)) == 0;
+	}
+}
+
+static void check_radix_records(size_t n, bool few) {
+	vec_key_e key_types[] = {VEC_KEY_U32, VEC_KEY_F32, VEC_KEY_I64, VEC_KEY_F64};
+	size_t offsets[] = {offsetof(struct record, seq), offsetof(struct record, f),
+						offsetof(struct record, i), offsetof(struct record, d)};
+	double specials[] = {-INFINITY, INFINITY, -0.0, 0.0, -1e300, 1e300, 1e-310, -1e-310};
+
+	for (size_t k = 0; k < sizeof(key_types) / sizeof(key_types[0]); ++k) {
+		vec_s *v = vec_new(0, sizeof(struct record));
+		assert(v != NULL);
+
+		for (uint32_t s = 0; s < n; ++s) {
+			uint32_t r = next_random();
+			double d = few ? (double)(r % 5) - 2.0 : ((double)r - (double)INT32_MAX / 2) / 7.0;
+			if (r % 50 == 0) {
+				d = specials[r / 50 % (sizeof(specials) / sizeof(specials[0]))];
+			}
+			struct record rec = {
+				.seq = s,
+				.f = (float)d,
+				.i = few ? (int64_t)(r % 5) - 2 : ((int64_t)r - INT32_MAX / 2) * 1000003,
+				.d = d,
+			};
+			assert(vec_push(v, &rec) == 0);
+		}
+
+		assert(vec_sort_radix(v, key_types[k], offsets[k]) == 0);
+		assert(vec_size(v) == n);
+
+		bool *seen = calloc(n + 1, sizeof(bool));
+		assert(seen != NULL);
+		for (size_t i = 0; i < n; ++i) {
+			const struct record *rec = vec_at(v, i);
+			assert(rec->seq < n && !seen[rec->seq]);
+			seen[rec->seq] = true;
+			if (i > 0) {
+				const struct record *prev = vec_at(v, i - 1);
+				assert(radix_le(prev, rec, key_types[k]));
+				/* Stable: equal keys keep their insertion order */
+				if (radix_same(prev, rec, key_types[k])) {
+					assert(prev->seq < rec->seq);
+				}
+				/* Negative zero first */
+				if (key_types[k] == VEC_KEY_F64 && prev->d == 0.0 && rec->d == 0.0) {
+					assert(!(signbit(rec->d) && !signbit(prev->d)));
+				}
+			}
+		}
+		free(seen);
+		vec_free(v);
+	}
+}
+
+static void check_radix_integers(void) {
+	vec_s *v = vec_new(0, sizeof(int32_t));
+	assert(v != NULL);
+	for (int32_t i = 0; i < BIG; ++i) {
+		int32_t value = (int32_t)next_random() - INT32_MAX / 2;
+		assert(vec_push(v, &value) == 0);
+	}
+
+	assert(vec_sort_radix(v, VEC_KEY_I32, 0) == 0);
+	for (size_t i = 1; i < BIG; ++i) {
+		assert(*(int32_t *)vec_at(v, i - 1) <= *(int32_t *)vec_at(v, i));
+	}
+
+	/* As unsigned, the negative ones come last */
+	assert(vec_sort_radix(v, VEC_KEY_U32, 0) == 0);
+	for (size_t i = 1; i < BIG; ++i) {
+		assert(*(uint32_t *)vec_at(v, i - 1) <= *(uint32_t *)vec_at(v, i));
+	}
+	assert(*(int32_t *)vec_at(v, BIG - 1) < 0);
+
+	/* The key must fit inside the element */
+	assert(vec_sort_radix(v, VEC_KEY_U64, 0) == -1);
+	assert(vec_sort_radix(v, VEC_KEY_U32, 1) == -1);
+	assert(vec_sort_radix(v, (vec_key_e)42, 0) == -1);
+	assert(vec_sort_radix(NULL, VEC_KEY_U32, 0) == -1);
+
+	/* The vector is still usable once its buffer was replaced */
+	int32_t value = 0;
+	assert(vec_push(v, &value) == 0);
+	assert(vec_size(v) == BIG + 1);
+	vec_free(v);
+
+	v = vec_new(0, sizeof(uint64_t));
+	assert(v != NULL);
+	assert(vec_sort_radix(v, VEC_KEY_U64, 0) == 0);
+	vec_free(v);
+}
+
+int main(void) {
+	check_comparison_sorts();
+	check_radix_records(0, false);
+	check_radix_records(1, false);
+	check_radix_records(BIG, false);
+	check_radix_records(BIG, true);
+	check_radix_integers();
+}
@@ -0,0 +1,282 @@
+#include "../vector/myvector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t seed = 777;
+
+static uint32_t next_random(void) {
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 8;
+}
+
+/* Lengths around every register width, so that both the vector loop and the tail run */
+static const size_t lengths[] = {0, 1, 3, 7, 8, 15, 16, 17, 31, 32, 33, 63, 100, 1000, 4099};
+
+static void check_scans(size_t size) {
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+		size_t n = lengths[l];
+		vec_s *v = vec_new(n, size);
+		assert(v != NULL);
+
+		/* Few distinct values, so that most lookups hit several times */
+		unsigned char elem[16];
+		for (size_t i = 0; i < n; ++i) {
+			memset(elem, 0, sizeof(elem));
+			elem[size - 1] = (unsigned char)(next_random() % 5);
+			assert(vec_push(v, elem) == 0);
+		}
+
+		for (unsigned char value = 0; value < 6; ++value) {
+			memset(elem, 0, sizeof(elem));
+			elem[size - 1] = value;
+
+			size_t first = n;
+			size_t count = 0;
+			for (size_t i = 0; i < n; ++i) {
+				if (memcmp(vec_at(v, i), elem, size) == 0) {
+					first = first < i ? first : i;
+					count++;
+				}
+			}
+
+			size_t index = SIZE_MAX;
+			assert(vec_find(v, elem, &index) == (count > 0 ? 0 : -1));
+			if (count > 0) {
+				assert(index == first);
+			}
+			assert(vec_count(v, elem) == count);
+
+			/* A match in the other half of a wide element is not a match */
+			elem[0] ^= 0x80;
+			assert(size == 1 || vec_count(v, elem) == 0);
+		}
+
+		vec_free(v);
+	}
+}
+
+static void check_extremes(vec_key_e key_type, size_t size) {
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+		size_t n = lengths[l];
+		vec_s *v = vec_new(n, size);
+		assert(v != NULL);
+
+		double lo = 0.0;
+		double hi = 0.0;
+		for (size_t i = 0; i < n; ++i) {
+			/* Never zero, so that -0.0 and 0.0 never tie */
+			int32_t r = (int32_t)(next_random() % 250) - 125;
+			r = r == 0 ? 1 : r;
+			unsigned char elem[8];
+			double value = r;
+			switch (key_type) {
+			case VEC_KEY_U8:
+			case VEC_KEY_U16:
+			case VEC_KEY_U32:
+			case VEC_KEY_U64: {
+				uint64_t u = (uint64_t)(r + 125) << (8 * size - 8);
+				value = (double)u;
+				memcpy(elem, &u, size);
+				break;
+			}
+			case VEC_KEY_I8: {
+				int8_t x = (int8_t)r;
+				memcpy(elem, &x, size);
+				break;
+			}
+			case VEC_KEY_I16: {
+				int16_t x = (int16_t)(r * 100);
+				value = x;
+				memcpy(elem, &x, size);
+				break;
+			}
+			case VEC_KEY_I32: {
+				int32_t x = r * 10000000;
+				value = x;
+				memcpy(elem, &x, size);
+				break;
+			}
+			case VEC_KEY_I64: {
+				int64_t x = (int64_t)r * ((int64_t)1 << 50);
+				value = (double)x;
+				memcpy(elem, &x, size);
+				break;
+			}
+			case VEC_KEY_F32: {
+				float x = (float)r / 3.0f;
+				value = x;
+				memcpy(elem, &x, size);
+				break;
+			}
+			default: {
+				double x = (double)r * 1e100;
+				value = x;
+				memcpy(elem, &x, size);
+				break;
+			}
+			}
+			assert(vec_push(v, elem) == 0);
+			lo = i == 0 || value < lo ? value : lo;
+			hi = i == 0 || value > hi ? value : hi;
+		}
+
+		unsigned char out[8];
+		if (n == 0) {
+			assert(vec_min(v, key_type, out) == -1);
+			assert(vec_max(v, key_type, out) == -1);
+			vec_free(v);
+			continue;
+		}
+
+		/* The extremes are elements of the vector, compared as numbers */
+		size_t index;
+		assert(vec_min(v, key_type, out) == 0);
+		assert(vec_find(v, out, &index) == 0);
+		assert(vec_max(v, key_type, out) == 0);
+		size_t max_index;
+		assert(vec_find(v, out, &max_index) == 0);
+
+		double found[2];
+		size_t indexes[2] = {index, max_index};
+		for (int k = 0; k < 2; ++k) {
+			const unsigned char *p = vec_at(v, indexes[k]);
+			switch (key_type) {
+			case VEC_KEY_U8:
+				found[k] = (double)*p;
+				break;
+			case VEC_KEY_U16: {
+				uint16_t x;
+				memcpy(&x, p, size);
+				found[k] = x;
+				break;
+			}
+			case VEC_KEY_U32: {
+				uint32_t x;
+				memcpy(&x, p, size);
+				found[k] = x;
+				break;
+			}
+			case VEC_KEY_U64: {
+				uint64_t x;
+				memcpy(&x, p, size);
+				found[k] = (double)x;
+				break;
+			}
+			case VEC_KEY_I8:
+				found[k] = (int8_t)*p;
+				break;
+			case VEC_KEY_I16: {
+				int16_t x;
+				memcpy(&x, p, size);
+				found[k] = x;
+				break;
+			}
+			case VEC_KEY_I32: {
+				int32_t x;
+				memcpy(&x, p, size);
+				found[k] = x;
+				break;
+			}
+			case VEC_KEY_I64: {
+				int64_t x;
+				memcpy(&x, p, size);
+				found[k] = (double)x;
+				break;
+			}
+			case VEC_KEY_F32: {
+				float x;
+				memcpy(&x, p, size);
+				found[k] = x;
+				break;
+			}
+			default:
+				memcpy(&found[k], p, size);
+				break;
+			}
+		}
+		assert(found[0] == lo);
+		assert(found[1] == hi);
+
+		vec_free(v);
+	}
+}
+
+static int int_cmp(const void *a, const void *b) {
+	int ia = *(const int *)a;
+	int ib = *(const int *)b;
+	return (ia > ib) - (ia < ib);
+}
+
+static void check_bounds(void) {
+	vec_s *v = vec_new(0, sizeof(int));
+	assert(v != NULL);
+
+	size_t index = 42;
+	int key = 0;
+	assert(vec_lower_bound(v, &key, int_cmp, &index) == 0);
+	assert(index == 0);
+	assert(vec_upper_bound(v, &key, int_cmp, &index) == 0);
+	assert(index == 0);
+
+	/* 0, 0, 0, 2, 2, 2, 4, ... */
+	for (int i = 0; i < 3000; ++i) {
+		int value = i / 3 * 2;
+		assert(vec_push(v, &value) == 0);
+	}
+
+	for (key = -1; key <= 2000; ++key) {
+		size_t lower = 0;
+		while (lower < 3000 && *(int *)vec_at(v, lower) < key) {
+			lower++;
+		}
+		size_t upper = lower;
+		while (upper < 3000 && *(int *)vec_at(v, upper) <= key) {
+			upper++;
+		}
+
+		assert(vec_lower_bound(v, &key, int_cmp, &index) == 0);
+		assert(index == lower);
+		assert(vec_upper_bound(v, &key, int_cmp, &index) == 0);
+		assert(index == upper);
+	}
+
+	assert(vec_lower_bound(v, &key, NULL, &index) == -1);
+	assert(vec_upper_bound(NULL, &key, int_cmp, &index) == -1);
+	vec_free(v);
+}
+
+int main(void) {
+	size_t sizes[] = {1, 2, 4, 8, 3, 12};
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		check_scans(sizes[s]);
+	}
+
+	check_extremes(VEC_KEY_U8, 1);
+	check_extremes(VEC_KEY_I8, 1);
+	check_extremes(VEC_KEY_U16, 2);
+	check_extremes(VEC_KEY_I16, 2);
+	check_extremes(VEC_KEY_U32, 4);
+	check_extremes(VEC_KEY_I32, 4);
+	check_extremes(VEC_KEY_F32, 4);
+	check_extremes(VEC_KEY_U64, 8);
+	check_extremes(VEC_KEY_I64, 8);
+	check_extremes(VEC_KEY_F64, 8);
+
+	/* Elements must be exactly one key */
+	vec_s *v = vec_new(1, sizeof(uint32_t));
+	assert(v != NULL);
+	uint32_t value = 5;
+	assert(vec_push(v, &value) == 0);
+	uint32_t out = 0;
+	assert(vec_min(v, VEC_KEY_U64, &out) == -1);
+	assert(vec_max(v, (vec_key_e)42, &out) == -1);
+	assert(vec_min(v, VEC_KEY_U32, &out) == 0);
+	assert(out == 5);
+	assert(vec_find(v, NULL, NULL) == -1);
+	assert(vec_count(NULL, &value) == 0);
+	vec_free(v);
+
+	check_bounds();
+}
@@ -1,5 +1,7 @@
 #include "myvector.h"
+#include "myvector_internal.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <threads.h>
@@ -21,7 +23,37 @@ static size_t next_power_two(size_t len) {
 	return p;
 }
 
-vec_s *vec_new(size_t initial_capacity, size_t element_size) {
+/* Reallocates the buffer to exactly capacity elements. The lock must be held */
+static int set_capacity(vec_s *vec, size_t capacity) {
+	if (capacity > SIZE_MAX / vec->elem_size) {
+		return -1;
+	}
+
+	void *tmp = realloc(vec->data, capacity * vec->elem_size);
+	if (tmp == NULL) {
+		return -1;
+	}
+	vec->data = tmp;
+	vec->capacity = capacity;
+
+	return 0;
+}
+
+/* Makes room for count more elements, reallocating at most once. The lock must be held */
+static int grow(vec_s *vec, size_t count) {
+	if (count > SIZE_MAX - vec->size) {
+		return -1;
+	}
+
+	if (vec->size + count <= vec->capacity) {
+		return 0;
+	}
+
+	return set_capacity(vec, next_power_two(vec->size + count));
+}
+
+/* Shared body of vec_new() and vec_new_unsync() */
+static vec_s *new_vec(size_t initial_capacity, size_t element_size, bool unsync) {
 	if (element_size == 0) {
 		return NULL;
 	}
@@ -34,6 +66,7 @@ vec_s *vec_new(size_t initial_capacity, size_t element_size) {
 	vec->capacity = next_power_two(initial_capacity);
 	vec->elem_size = element_size;
 	vec->size = 0;
+	vec->unsync = unsync;
 	if (vec->capacity > SIZE_MAX / vec->elem_size) {
 		free(vec);
 
@@ -46,7 +79,7 @@ vec_s *vec_new(size_t initial_capacity, size_t element_size) {
 		return NULL;
 	}
 
-	if (mtx_init(&vec->lock, mtx_plain) != thrd_success) {
+	if (!unsync && mtx_init(&vec->lock, mtx_plain) != thrd_success) {
 		free(vec->data);
 		free(vec);
 
@@ -56,39 +89,34 @@ vec_s *vec_new(size_t initial_capacity, size_t element_size) {
 	return vec;
 }
 
+vec_s *vec_new(size_t initial_capacity, size_t element_size) {
+	return new_vec(initial_capacity, element_size, false);
+}
+
+vec_s *vec_new_unsync(size_t initial_capacity, size_t element_size) {
+	return new_vec(initial_capacity, element_size, true);
+}
+
 int vec_push(vec_s *vec, void *elem) {
 	if (vec == NULL || elem == NULL) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
-	if (vec->size + 1 > vec->capacity) {
-		/* Reallocate buffer */
-		size_t new_capacity = next_power_two(vec->size + 1);
-		if (new_capacity > SIZE_MAX / vec->elem_size) {
-			mtx_unlock(&vec->lock);
-
-			return -1;
-		}
-
-		void *tmp = realloc(vec->data, new_capacity * vec->elem_size);
-		if (tmp == NULL) {
-			mtx_unlock(&vec->lock);
+	if (grow(vec, 1) != 0) {
+		unlock_vec(vec);
 
-			return -1;
-		}
-		vec->data = tmp;
-		vec->capacity = new_capacity;
+		return -1;
 	}
 
 	/* Add the new element */
 	memcpy((char *)vec->data + (vec->size * vec->elem_size), elem, vec->elem_size);
 	vec->size++;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
@@ -102,7 +130,9 @@ void vec_free(vec_s *vec) {
 		free(vec->data);
 	}
 
-	mtx_destroy(&vec->lock);
+	if (!vec->unsync) {
+		mtx_destroy(&vec->lock);
+	}
 
 	free(vec);
 }
@@ -112,13 +142,13 @@ size_t vec_size(vec_s *vec) {
 		return 0;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return 0;
 	}
 
 	size_t size = vec->size;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return size;
 }
@@ -128,13 +158,13 @@ size_t vec_cap(vec_s *vec) {
 		return 0;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return 0;
 	}
 
 	size_t cap = vec->capacity;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return cap;
 }
@@ -144,74 +174,118 @@ void *vec_get(vec_s *vec, size_t index) {
 		return NULL;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return NULL;
 	}
 
 	if (index >= vec->size) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return NULL;
 	}
 
 	void *elem = malloc(vec->elem_size);
 	if (elem == NULL) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return NULL;
 	}
 
 	memcpy(elem, (char *)vec->data + (index * vec->elem_size), vec->elem_size);
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return elem;
 }
 
-int vec_shrink(vec_s *vec) {
-	if (vec == NULL) {
+int vec_get_into(vec_s *vec, size_t index, void *out) {
+	if (vec == NULL || out == NULL) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
-	size_t new_capacity = (vec->size == 0) ? 1 : vec->size;
-	if (new_capacity > SIZE_MAX / vec->elem_size) {
-		mtx_unlock(&vec->lock);
+	if (index >= vec->size) {
+		unlock_vec(vec);
 
 		return -1;
 	}
 
-	void *tmp = realloc(vec->data, new_capacity * vec->elem_size);
-	if (tmp == NULL) {
-		mtx_unlock(&vec->lock);
+	memcpy(out, (char *)vec->data + (index * vec->elem_size), vec->elem_size);
+
+	unlock_vec(vec);
+
+	return 0;
+}
+
+void *vec_at(vec_s *vec, size_t index) {
+	if (vec == NULL || index >= vec->size) {
+		return NULL;
+	}
+
+	return (char *)vec->data + (index * vec->elem_size);
+}
 
+int vec_view_begin(vec_s *vec, vec_view_s *view) {
+	if (vec == NULL || view == NULL) {
 		return -1;
 	}
 
-	vec->data = tmp;
-	vec->capacity = new_capacity;
+	if (!lock_vec(vec)) {
+		return -1;
+	}
 
-	mtx_unlock(&vec->lock);
+	view->vec = vec;
+	view->data = vec->data;
+	view->size = vec->size;
+	view->elem_size = vec->elem_size;
 
 	return 0;
 }
 
+void vec_view_end(vec_view_s *view) {
+	if (view == NULL || view->vec == NULL) {
+		return;
+	}
+
+	unlock_vec(view->vec);
+
+	view->vec = NULL;
+	view->data = NULL;
+	view->size = 0;
+}
+
+int vec_shrink(vec_s *vec) {
+	if (vec == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	int res = set_capacity(vec, (vec->size == 0) ? 1 : vec->size);
+
+	unlock_vec(vec);
+
+	return res;
+}
+
 int vec_clear(vec_s *vec) {
 	if (vec == NULL) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
 	memset(vec->data, 0, vec->size * vec->elem_size);
 	vec->size = 0;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
@@ -221,19 +295,19 @@ void *vec_pop(vec_s *vec) {
 		return NULL;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return NULL;
 	}
 
 	if (vec->size == 0) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return NULL;
 	}
 
 	void *e = malloc(vec->elem_size);
 	if (e == NULL) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return NULL;
 	}
@@ -241,43 +315,53 @@ void *vec_pop(vec_s *vec) {
 	vec->size--;
 	memcpy(e, (char *)vec->data + (vec->size * vec->elem_size), vec->elem_size);
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return e;
 }
 
+int vec_pop_into(vec_s *vec, void *out) {
+	if (vec == NULL || out == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	if (vec->size == 0) {
+		unlock_vec(vec);
+
+		return -1;
+	}
+
+	vec->size--;
+	memcpy(out, (char *)vec->data + (vec->size * vec->elem_size), vec->elem_size);
+
+	unlock_vec(vec);
+
+	return 0;
+}
+
 int vec_insert(vec_s *vec, size_t index, void *value) {
 	if (vec == NULL || value == NULL) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
 	if (index > vec->size) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return -1;
 	}
 
-	if (vec->size + 1 > vec->capacity) {
-		/* No space, realloc */
-		size_t new_capacity = next_power_two(vec->size + 1);
-		if (new_capacity > SIZE_MAX / vec->elem_size) {
-			mtx_unlock(&vec->lock);
+	if (grow(vec, 1) != 0) {
+		unlock_vec(vec);
 
-			return -1;
-		}
-
-		void *tmp = realloc(vec->data, new_capacity * vec->elem_size);
-		if (tmp == NULL) {
-			mtx_unlock(&vec->lock);
-
-			return -1;
-		}
-		vec->data = tmp;
-		vec->capacity = new_capacity;
+		return -1;
 	}
 
 	/* Shift memory and copy the new value */
@@ -287,7 +371,7 @@ int vec_insert(vec_s *vec, size_t index, void *value) {
 	memcpy((char *)vec->data + (index * vec->elem_size), value, vec->elem_size);
 	vec->size++;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
@@ -297,12 +381,12 @@ int vec_remove(vec_s *vec, size_t index) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
 	if (index >= vec->size) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return -1;
 	}
@@ -313,7 +397,7 @@ int vec_remove(vec_s *vec, size_t index) {
 			(char *)vec->data + ((index + 1) * vec->elem_size), size * vec->elem_size);
 	vec->size--;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
@@ -323,19 +407,19 @@ int vec_set(vec_s *vec, size_t index, void *value) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
 	if (index >= vec->size) {
-		mtx_unlock(&vec->lock);
+		unlock_vec(vec);
 
 		return -1;
 	}
 
 	memcpy((char *)vec->data + (index * vec->elem_size), value, vec->elem_size);
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
@@ -345,7 +429,7 @@ int vec_foreach(vec_s *vec, void (*callback)(size_t index, void *elem)) {
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	if (!lock_vec(vec)) {
 		return -1;
 	}
 
@@ -353,23 +437,111 @@ int vec_foreach(vec_s *vec, void (*callback)(size_t index, void *elem)) {
 		callback(i, (char *)vec->data + (i * vec->elem_size));
 	}
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
 
-int vec_sort(vec_s *vec, int (*cmp)(const void *a, const void *b)) {
-	if (vec == NULL || cmp == NULL) {
+int vec_push_n(vec_s *vec, const void *elems, size_t count) {
+	return vec_insert_range(vec, SIZE_MAX, elems, count);
+}
+
+int vec_insert_range(vec_s *vec, size_t index, const void *elems, size_t count) {
+	if (vec == NULL || (elems == NULL && count != 0)) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	/* SIZE_MAX appends, see vec_push_n() */
+	if (index == SIZE_MAX) {
+		index = vec->size;
+	}
+	if (index > vec->size || grow(vec, count) != 0) {
+		unlock_vec(vec);
+
 		return -1;
 	}
 
-	if (mtx_lock(&vec->lock) != thrd_success) {
+	/* One shift for the whole range, then one copy */
+	char *at = (char *)vec->data + (index * vec->elem_size);
+	memmove(at + (count * vec->elem_size), at, (vec->size - index) * vec->elem_size);
+	if (count != 0) {
+		memcpy(at, elems, count * vec->elem_size);
+	}
+	vec->size += count;
+
+	unlock_vec(vec);
+
+	return 0;
+}
+
+int vec_remove_range(vec_s *vec, size_t index, size_t count) {
+	if (vec == NULL) {
 		return -1;
 	}
 
-	qsort(vec->data, vec->size, vec->elem_size, cmp);
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	if (index > vec->size || count > vec->size - index) {
+		unlock_vec(vec);
+
+		return -1;
+	}
+
+	char *at = (char *)vec->data + (index * vec->elem_size);
+	memmove(at, at + (count * vec->elem_size), (vec->size - index - count) * vec->elem_size);
+	vec->size -= count;
+
+	unlock_vec(vec);
+
+	return 0;
+}
+
+int vec_reserve(vec_s *vec, size_t capacity) {
+	if (vec == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	int res = 0;
+	if (capacity > vec->capacity) {
+		res = set_capacity(vec, capacity);
+	}
+
+	unlock_vec(vec);
+
+	return res;
+}
+
+int vec_resize(vec_s *vec, size_t size) {
+	if (vec == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	if (size > vec->size) {
+		if (grow(vec, size - vec->size) != 0) {
+			unlock_vec(vec);
+
+			return -1;
+		}
+		memset((char *)vec->data + (vec->size * vec->elem_size), 0,
+			   (size - vec->size) * vec->elem_size);
+	}
+	vec->size = size;
 
-	mtx_unlock(&vec->lock);
+	unlock_vec(vec);
 
 	return 0;
 }
@@ -1,10 +1,23 @@
 #ifndef MYCLIB_VECTOR_H
 #define MYCLIB_VECTOR_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <threads.h>
 
+/**< Ranges of at most this many elements are finished by insertion sort */
+#define MYCLIB_VECTOR_SORT_INSERTION 16
+
+/**< Worker threads of vec_sort_parallel() when called with 0 threads */
+#define MYCLIB_VECTOR_SORT_THREADS 4
+
+/**< Most worker threads a vec_sort_parallel() call uses */
+#define MYCLIB_VECTOR_SORT_MAX_THREADS 64
+
+/**< Minimum number of elements per vec_sort_parallel() worker */
+#define MYCLIB_VECTOR_SORT_MIN 16384
+
 /**
  * @brief Vector structure.
  */
@@ -13,9 +26,36 @@ typedef struct vec {
 	size_t elem_size; /**< Size of each element in bytes */
 	size_t size;	  /**< Number of elements currently stored */
 	size_t capacity;  /**< Allocated capacity (number of elements) */
-	mtx_t lock;		  /**< Mutex for thread safety */
+	bool unsync;	  /**< No internal locking, see vec_new_unsync() */
+	mtx_t lock;		  /**< Mutex for thread safety (unused if unsync) */
 } vec_s;
 
+/**
+ * @brief Numeric type of a key, see vec_sort_radix() and vec_min().
+ */
+typedef enum vec_key {
+	VEC_KEY_U32, /**< uint32_t */
+	VEC_KEY_U64, /**< uint64_t */
+	VEC_KEY_I32, /**< int32_t */
+	VEC_KEY_I64, /**< int64_t */
+	VEC_KEY_F32, /**< float */
+	VEC_KEY_F64, /**< double */
+	VEC_KEY_U8,	 /**< uint8_t */
+	VEC_KEY_I8,	 /**< int8_t */
+	VEC_KEY_U16, /**< uint16_t */
+	VEC_KEY_I16, /**< int16_t */
+} vec_key_e;
+
+/**
+ * @brief Lock-held window on the elements of a vector, see vec_view_begin().
+ */
+typedef struct vec_view {
+	vec_s *vec;		  /**< Locked vector */
+	void *data;		  /**< First element, valid until vec_view_end() */
+	size_t size;	  /**< Number of elements */
+	size_t elem_size; /**< Size of each element in bytes */
+} vec_view_s;
+
 /**
  * @brief Create a new vector.
  *
@@ -25,6 +65,18 @@ typedef struct vec {
  */
 vec_s *vec_new(size_t initial_capacity, size_t element_size);
 
+/**
+ * @brief Create a new vector without internal locking.
+ *
+ * Same API as a vector from vec_new(), with no synchronization cost: for vectors used by one
+ * thread at a time. Concurrent calls need external synchronization, and views do not lock.
+ *
+ * @param initial_capacity Initial number of elements to allocate.
+ * @param element_size Size of each element in bytes.
+ * @return Pointer to the new vector, or NULL on failure.
+ */
+vec_s *vec_new_unsync(size_t initial_capacity, size_t element_size);
+
 /**
  * @brief Get the number of elements stored in the vector.
  *
@@ -58,6 +110,18 @@ int vec_shrink(vec_s *vec);
  */
 int vec_push(vec_s *vec, void *elem);
 
+/**
+ * @brief Push several elements at the end of the vector.
+ *
+ * Grows the buffer at most once and copies the elements in one go.
+ *
+ * @param vec Vector.
+ * @param elems Pointer to count contiguous elements.
+ * @param count Number of elements.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_push_n(vec_s *vec, const void *elems, size_t count);
+
 /**
  * @brief Pop the last element from the vector.
  *
@@ -67,6 +131,15 @@ int vec_push(vec_s *vec, void *elem);
  */
 void *vec_pop(vec_s *vec);
 
+/**
+ * @brief Pop the last element into a caller-provided buffer.
+ *
+ * @param vec Vector.
+ * @param out Buffer of elem_size bytes receiving the element.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_pop_into(vec_s *vec, void *out);
+
 /**
  * @brief Insert an element at a specific position.
  *
@@ -86,6 +159,49 @@ int vec_insert(vec_s *vec, size_t index, void *value);
  */
 int vec_remove(vec_s *vec, size_t index);
 
+/**
+ * @brief Insert several elements at a specific position.
+ *
+ * The tail is shifted once for the whole range.
+ *
+ * @param vec Vector.
+ * @param index Position where to insert (SIZE_MAX appends).
+ * @param elems Pointer to count contiguous elements.
+ * @param count Number of elements.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_insert_range(vec_s *vec, size_t index, const void *elems, size_t count);
+
+/**
+ * @brief Remove count elements starting at a specific position.
+ *
+ * The tail is shifted once for the whole range.
+ *
+ * @param vec Vector.
+ * @param index Index of the first element to remove.
+ * @param count Number of elements to remove.
+ * @return 0 on success, -1 on failure (including a range past the end).
+ */
+int vec_remove_range(vec_s *vec, size_t index, size_t count);
+
+/**
+ * @brief Make sure the vector can hold capacity elements without reallocating.
+ *
+ * @param vec Vector.
+ * @param capacity Minimum capacity (number of elements).
+ * @return 0 on success, -1 on failure.
+ */
+int vec_reserve(vec_s *vec, size_t capacity);
+
+/**
+ * @brief Change the number of elements. New elements are zero-filled.
+ *
+ * @param vec Vector.
+ * @param size New number of elements.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_resize(vec_s *vec, size_t size);
+
 /**
  * @brief Get a copy of an element at the given position.
  *
@@ -96,6 +212,48 @@ int vec_remove(vec_s *vec, size_t index);
  */
 void *vec_get(vec_s *vec, size_t index);
 
+/**
+ * @brief Copy an element into a caller-provided buffer.
+ *
+ * @param vec Vector.
+ * @param index Index of the element.
+ * @param out Buffer of elem_size bytes receiving the element.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_get_into(vec_s *vec, size_t index, void *out);
+
+/**
+ * @brief Get a pointer to an element, without locking or copying.
+ *
+ * The pointer is borrowed: it is only valid while no other call resizes or modifies the
+ * vector, e.g. inside a vec_view_begin()/vec_view_end() scope or on an unshared vector.
+ *
+ * @param vec Vector.
+ * @param index Index of the element.
+ * @return Pointer to the stored element or NULL if out of range.
+ */
+void *vec_at(vec_s *vec, size_t index);
+
+/**
+ * @brief Lock the vector and expose its raw elements.
+ *
+ * view->data points to view->size contiguous elements that can be read and written in place
+ * until vec_view_end(). Other vec_*() calls on the vector block meanwhile, and must not be
+ * made from the same thread (vec_at() is fine).
+ *
+ * @param vec Vector.
+ * @param view View to fill.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_view_begin(vec_s *vec, vec_view_s *view);
+
+/**
+ * @brief Release a view taken with vec_view_begin(). Its data pointer must not be used anymore.
+ *
+ * @param view View.
+ */
+void vec_view_end(vec_view_s *view);
+
 /**
  * @brief Set the value of an element at the given position.
  *
@@ -124,7 +282,13 @@ int vec_clear(vec_s *vec);
 int vec_foreach(vec_s *vec, void (*callback)(size_t index, void *elem));
 
 /**
- * @brief Sort the vector using qsort().
+ * @brief Sort the vector, like qsort() with the same comparison function.
+ *
+ * Introsort: quicksort with a median-of-three pivot, heapsort once a range recurses too deep
+ * and insertion sort on short ranges. Element moves are specialized for 4, 8 and 16 byte
+ * elements, but every comparison is still an indirect call to cmp, which dominates the cost on
+ * small elements. The sort is not stable. Vectors sorted by a built-in numeric key are faster
+ * with vec_sort_radix(), which calls no comparator.
  *
  * @param vec Vector.
  * @param cmp Comparison function.
@@ -132,6 +296,104 @@ int vec_foreach(vec_s *vec, void (*callback)(size_t index, void *elem));
  */
 int vec_sort(vec_s *vec, int (*cmp)(const void *a, const void *b));
 
+/**
+ * @brief Sort the vector by a numeric key stored inside each element, without comparisons.
+ *
+ * LSD radix sort, one pass per key byte (passes where every element has the same byte are
+ * skipped). It is stable and allocates a second buffer of the vector's capacity. Negative zero
+ * sorts before zero, and NaNs sort after infinity (before minus infinity if negative).
+ *
+ * @param vec Vector.
+ * @param key_type Type of the key.
+ * @param key_offset Offset in bytes of the key inside an element.
+ * @return 0 on success, -1 on failure (including a key that does not fit the element).
+ */
+int vec_sort_radix(vec_s *vec, vec_key_e key_type, size_t key_offset);
+
+/**
+ * @brief Sort the vector with several threads.
+ *
+ * The vector is split into one chunk per worker, each chunk is sorted as by vec_sort(), then
+ * runs are merged pairwise, in parallel, into a second buffer of the vector's capacity. Small
+ * vectors, or a failed allocation, fall back to vec_sort() on the calling thread.
+ *
+ * @param vec Vector.
+ * @param cmp Comparison function.
+ * @param num_threads Number of threads, the calling one included (0 for
+ * MYCLIB_VECTOR_SORT_THREADS). At most one per MYCLIB_VECTOR_SORT_MIN elements is used.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_sort_parallel(vec_s *vec, int (*cmp)(const void *a, const void *b), size_t num_threads);
+
+/**
+ * @brief Find the first element equal to elem, byte for byte.
+ *
+ * Vectors of 1, 2, 4 or 8 byte elements are scanned with SSE2 or AVX2 where the CPU supports
+ * it (checked at runtime), other sizes and other CPUs use a portable loop.
+ *
+ * @param vec Vector.
+ * @param elem Pointer to the element to look for.
+ * @param index Receives the index of the element (can be NULL).
+ * @return 0 if found, -1 otherwise.
+ */
+int vec_find(vec_s *vec, const void *elem, size_t *index);
+
+/**
+ * @brief Count the elements equal to elem, byte for byte. Vectorized like vec_find().
+ *
+ * @param vec Vector.
+ * @param elem Pointer to the element to count.
+ * @return Number of equal elements, or 0 on failure.
+ */
+size_t vec_count(vec_s *vec, const void *elem);
+
+/**
+ * @brief Find the first element of a sorted vector that does not compare less than key.
+ *
+ * @param vec Vector sorted by cmp.
+ * @param key Pointer to the key, passed as second argument of cmp.
+ * @param cmp Comparison function, as for vec_sort().
+ * @param index Receives the index, vec_size() if every element is less than key.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_lower_bound(vec_s *vec, const void *key, int (*cmp)(const void *a, const void *b),
+					size_t *index);
+
+/**
+ * @brief Find the first element of a sorted vector that compares greater than key.
+ *
+ * @param vec Vector sorted by cmp.
+ * @param key Pointer to the key, passed as first argument of cmp.
+ * @param cmp Comparison function, as for vec_sort().
+ * @param index Receives the index, vec_size() if no element is greater than key.
+ * @return 0 on success, -1 on failure.
+ */
+int vec_upper_bound(vec_s *vec, const void *key, int (*cmp)(const void *a, const void *b),
+					size_t *index);
+
+/**
+ * @brief Get the smallest element of a vector of numbers.
+ *
+ * Elements must be exactly one key_type each. Numbers are ordered as by vec_sort_radix(), and
+ * scanned with AVX2 where the CPU supports it.
+ *
+ * @param vec Vector.
+ * @param key_type Type of the elements.
+ * @param out Buffer of elem_size bytes receiving the element.
+ * @return 0 on success, -1 on failure (including an empty vector).
+ */
+int vec_min(vec_s *vec, vec_key_e key_type, void *out);
+
+/**
+ * @brief Get the largest element of a vector of numbers, see vec_min().
+ *
+ * @param vec Vector.
+ * @param key_type Type of the elements.
+ * @param out Buffer of elem_size bytes receiving the element.
+ * @return 0 on success, -1 on failure (including an empty vector).
+ */
+int vec_max(vec_s *vec, vec_key_e key_type, void *out);
+
 /**
  * @brief Free the vector and its resources.
  *
@@ -0,0 +1,92 @@
+#ifndef MYCLIB_VECTOR_INTERNAL_H
+#define MYCLIB_VECTOR_INTERNAL_H
+
+/*
+ * Helpers shared by the vector sources. Not installed.
+ */
+
+#include "myvector.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+/* Forced inlining, so that a constant element size folds into every copy and swap */
+#if defined(__GNUC__) || defined(__clang__)
+#define VEC_INLINE inline __attribute__((always_inline))
+#else
+#define VEC_INLINE inline
+#endif
+
+/* Takes the vector lock, a no-op on unsynchronized vectors */
+static inline bool lock_vec(vec_s *vec) {
+	return vec->unsync || mtx_lock(&vec->lock) == thrd_success;
+}
+
+static inline void unlock_vec(vec_s *vec) {
+	if (!vec->unsync) {
+		mtx_unlock(&vec->lock);
+	}
+}
+
+/* Returns the size in bytes of a key type */
+static inline size_t key_width(vec_key_e key_type) {
+	switch (key_type) {
+	case VEC_KEY_U8:
+	case VEC_KEY_I8:
+		return 1;
+	case VEC_KEY_U16:
+	case VEC_KEY_I16:
+		return 2;
+	case VEC_KEY_U32:
+	case VEC_KEY_I32:
+	case VEC_KEY_F32:
+		return 4;
+	default:
+		return 8;
+	}
+}
+
+/*
+ * Maps a key to an unsigned integer with the same order: signed integers get their sign bit
+ * flipped, negative floats all their bits, positive floats only the sign bit.
+ */
+static VEC_INLINE uint64_t order_key(const char *key, vec_key_e key_type) {
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+
+	switch (key_type) {
+	case VEC_KEY_U8:
+		return (unsigned char)*key;
+	case VEC_KEY_I8:
+		return (unsigned char)*key ^ 0x80u;
+	case VEC_KEY_U16:
+		memcpy(&u16, key, sizeof(u16));
+		return u16;
+	case VEC_KEY_I16:
+		memcpy(&u16, key, sizeof(u16));
+		return u16 ^ 0x8000u;
+	case VEC_KEY_U32:
+		memcpy(&u32, key, sizeof(u32));
+		return u32;
+	case VEC_KEY_I32:
+		memcpy(&u32, key, sizeof(u32));
+		return u32 ^ 0x80000000u;
+	case VEC_KEY_F32:
+		memcpy(&u32, key, sizeof(u32));
+		return (u32 & 0x80000000u) != 0 ? (uint32_t)~u32 : u32 | 0x80000000u;
+	case VEC_KEY_U64:
+		memcpy(&u64, key, sizeof(u64));
+		return u64;
+	case VEC_KEY_I64:
+		memcpy(&u64, key, sizeof(u64));
+		return u64 ^ 0x8000000000000000ull;
+	default:
+		memcpy(&u64, key, sizeof(u64));
+		return (u64 & 0x8000000000000000ull) != 0 ? ~u64 : u64 | 0x8000000000000000ull;
+	}
+}
+
+#endif /* MYCLIB_VECTOR_INTERNAL_H */
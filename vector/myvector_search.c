@@ -0,0 +1,552 @@
+#include "myvector.h"
+#include "myvector_internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/* x86 builds with GCC or clang get SSE2/AVX2 kernels, picked at runtime from CPUID */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && \
+	!defined(MYCLIB_VECTOR_NO_SIMD)
+#define VEC_X86
+#include <immintrin.h>
+#endif
+
+typedef int vec_cmp_f(const void *a, const void *b);
+
+/* Loads an element of 1, 2, 4 or 8 bytes as an integer */
+static VEC_INLINE uint64_t load_elem(const unsigned char *p, size_t size) {
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+
+	switch (size) {
+	case 1:
+		return *p;
+	case 2:
+		memcpy(&u16, p, sizeof(u16));
+		return u16;
+	case 4:
+		memcpy(&u32, p, sizeof(u32));
+		return u32;
+	default:
+		memcpy(&u64, p, sizeof(u64));
+		return u64;
+	}
+}
+
+static void store_elem(void *p, uint64_t value, size_t size) {
+	uint8_t u8 = (uint8_t)value;
+	uint16_t u16 = (uint16_t)value;
+	uint32_t u32 = (uint32_t)value;
+
+	switch (size) {
+	case 1:
+		memcpy(p, &u8, sizeof(u8));
+		break;
+	case 2:
+		memcpy(p, &u16, sizeof(u16));
+		break;
+	case 4:
+		memcpy(p, &u32, sizeof(u32));
+		break;
+	default:
+		memcpy(p, &value, sizeof(value));
+		break;
+	}
+}
+
+/* Sign bit of an element of size bytes */
+static inline uint64_t sign_bit(size_t size) {
+	return 1ull << (8 * size - 1);
+}
+
+/*
+ * Portable scan of the elements [first, n): returns the index of the first one equal to needle
+ * (n if none), or with count the number of equal ones.
+ */
+static VEC_INLINE size_t scan_scalar_w(const unsigned char *data, size_t first, size_t n,
+									   size_t size, uint64_t needle, bool count) {
+	size_t found = 0;
+	for (size_t i = first; i < n; ++i) {
+		if (load_elem(data + i * size, size) == needle) {
+			if (!count) {
+				return i;
+			}
+			found++;
+		}
+	}
+
+	return count ? found : n;
+}
+
+static size_t scan_scalar(const unsigned char *data, size_t first, size_t n, size_t size,
+						  uint64_t needle, bool count) {
+	switch (size) {
+	case 1:
+		return scan_scalar_w(data, first, n, 1, needle, count);
+	case 2:
+		return scan_scalar_w(data, first, n, 2, needle, count);
+	case 4:
+		return scan_scalar_w(data, first, n, 4, needle, count);
+	default:
+		return scan_scalar_w(data, first, n, 8, needle, count);
+	}
+}
+
+/*
+ * Order key, as by order_key(), of the smallest (or largest) of the elements [first, n) and
+ * best.
+ */
+static VEC_INLINE uint64_t extreme_scalar_w(const unsigned char *data, size_t first, size_t n,
+											size_t size, vec_key_e key_type, bool max,
+											uint64_t best) {
+	for (size_t i = first; i < n; ++i) {
+		uint64_t key = order_key((const char *)data + i * size, key_type);
+		if (max ? key > best : key < best) {
+			best = key;
+		}
+	}
+
+	return best;
+}
+
+static uint64_t extreme_scalar(const unsigned char *data, size_t first, size_t n,
+							   vec_key_e key_type, bool max, uint64_t best) {
+	switch (key_type) {
+	case VEC_KEY_U8:
+		return extreme_scalar_w(data, first, n, 1, VEC_KEY_U8, max, best);
+	case VEC_KEY_I8:
+		return extreme_scalar_w(data, first, n, 1, VEC_KEY_I8, max, best);
+	case VEC_KEY_U16:
+		return extreme_scalar_w(data, first, n, 2, VEC_KEY_U16, max, best);
+	case VEC_KEY_I16:
+		return extreme_scalar_w(data, first, n, 2, VEC_KEY_I16, max, best);
+	case VEC_KEY_U32:
+		return extreme_scalar_w(data, first, n, 4, VEC_KEY_U32, max, best);
+	case VEC_KEY_I32:
+		return extreme_scalar_w(data, first, n, 4, VEC_KEY_I32, max, best);
+	case VEC_KEY_F32:
+		return extreme_scalar_w(data, first, n, 4, VEC_KEY_F32, max, best);
+	case VEC_KEY_U64:
+		return extreme_scalar_w(data, first, n, 8, VEC_KEY_U64, max, best);
+	case VEC_KEY_I64:
+		return extreme_scalar_w(data, first, n, 8, VEC_KEY_I64, max, best);
+	default:
+		return extreme_scalar_w(data, first, n, 8, VEC_KEY_F64, max, best);
+	}
+}
+
+/* Inverse of order_key(): the bits of the element of size bytes with a given order key */
+static uint64_t unorder_key(uint64_t key, vec_key_e key_type, size_t size) {
+	uint64_t sign = sign_bit(size);
+
+	switch (key_type) {
+	case VEC_KEY_I8:
+	case VEC_KEY_I16:
+	case VEC_KEY_I32:
+	case VEC_KEY_I64:
+		return key ^ sign;
+	case VEC_KEY_F32:
+	case VEC_KEY_F64:
+		return (key & sign) != 0 ? key ^ sign : ~key & (sign | (sign - 1));
+	default:
+		return key;
+	}
+}
+
+#ifdef VEC_X86
+
+/*
+ * The SSE2 and AVX2 scans compare a whole register of elements at once. The byte mask of the
+ * comparison has every byte of a matching element set, so the first match is its lowest bit
+ * and the number of matches its popcount divided by the element size.
+ */
+
+__attribute__((target("sse2"))) static VEC_INLINE size_t
+scan_sse2_w(const unsigned char *data, size_t n, size_t size, uint64_t needle, bool count) {
+	__m128i pattern;
+	switch (size) {
+	case 1:
+		pattern = _mm_set1_epi8((char)needle);
+		break;
+	case 2:
+		pattern = _mm_set1_epi16((short)needle);
+		break;
+	case 4:
+		pattern = _mm_set1_epi32((int)needle);
+		break;
+	default:
+		pattern = _mm_set1_epi64x((long long)needle);
+		break;
+	}
+
+	size_t lanes = sizeof(__m128i) / size;
+	size_t found = 0;
+	size_t i = 0;
+	for (; i + lanes <= n; i += lanes) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(data + i * size));
+		__m128i eq;
+		switch (size) {
+		case 1:
+			eq = _mm_cmpeq_epi8(block, pattern);
+			break;
+		case 2:
+			eq = _mm_cmpeq_epi16(block, pattern);
+			break;
+		case 4:
+			eq = _mm_cmpeq_epi32(block, pattern);
+			break;
+		default:
+			/* No 64-bit compare in SSE2: both halves must match */
+			eq = _mm_cmpeq_epi32(block, pattern);
+			eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+			break;
+		}
+
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+		if (mask != 0) {
+			if (!count) {
+				return i + (size_t)__builtin_ctz(mask) / size;
+			}
+			found += (size_t)__builtin_popcount(mask) / size;
+		}
+	}
+
+	size_t rest = scan_scalar(data, i, n, size, needle, count);
+	return count ? found + rest : rest;
+}
+
+__attribute__((target("sse2"))) static size_t scan_sse2(const unsigned char *data, size_t n,
+														size_t size, uint64_t needle,
+														bool count) {
+	switch (size) {
+	case 1:
+		return scan_sse2_w(data, n, 1, needle, count);
+	case 2:
+		return scan_sse2_w(data, n, 2, needle, count);
+	case 4:
+		return scan_sse2_w(data, n, 4, needle, count);
+	default:
+		return scan_sse2_w(data, n, 8, needle, count);
+	}
+}
+
+__attribute__((target("avx2"))) static VEC_INLINE __m256i splat_avx2(uint64_t value,
+																	 size_t size) {
+	switch (size) {
+	case 1:
+		return _mm256_set1_epi8((char)value);
+	case 2:
+		return _mm256_set1_epi16((short)value);
+	case 4:
+		return _mm256_set1_epi32((int)value);
+	default:
+		return _mm256_set1_epi64x((long long)value);
+	}
+}
+
+__attribute__((target("avx2"))) static VEC_INLINE size_t
+scan_avx2_w(const unsigned char *data, size_t n, size_t size, uint64_t needle, bool count) {
+	__m256i pattern = splat_avx2(needle, size);
+
+	size_t lanes = sizeof(__m256i) / size;
+	size_t found = 0;
+	size_t i = 0;
+	for (; i + lanes <= n; i += lanes) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)(data + i * size));
+		__m256i eq;
+		switch (size) {
+		case 1:
+			eq = _mm256_cmpeq_epi8(block, pattern);
+			break;
+		case 2:
+			eq = _mm256_cmpeq_epi16(block, pattern);
+			break;
+		case 4:
+			eq = _mm256_cmpeq_epi32(block, pattern);
+			break;
+		default:
+			eq = _mm256_cmpeq_epi64(block, pattern);
+			break;
+		}
+
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(eq);
+		if (mask != 0) {
+			if (!count) {
+				return i + (size_t)__builtin_ctz(mask) / size;
+			}
+			found += (size_t)__builtin_popcount(mask) / size;
+		}
+	}
+
+	size_t rest = scan_scalar(data, i, n, size, needle, count);
+	return count ? found + rest : rest;
+}
+
+__attribute__((target("avx2"))) static size_t scan_avx2(const unsigned char *data, size_t n,
+														size_t size, uint64_t needle,
+														bool count) {
+	switch (size) {
+	case 1:
+		return scan_avx2_w(data, n, 1, needle, count);
+	case 2:
+		return scan_avx2_w(data, n, 2, needle, count);
+	case 4:
+		return scan_avx2_w(data, n, 4, needle, count);
+	default:
+		return scan_avx2_w(data, n, 8, needle, count);
+	}
+}
+
+/*
+ * Maps elements to signed integers in the order of order_key(), i.e. order_key() ^ sign_bit(),
+ * so that the signed min/max instructions apply to every key type.
+ */
+__attribute__((target("avx2"))) static VEC_INLINE __m256i to_signed_avx2(__m256i x, size_t size,
+																		 vec_key_e key_type) {
+	switch (key_type) {
+	case VEC_KEY_U8:
+	case VEC_KEY_U16:
+	case VEC_KEY_U32:
+	case VEC_KEY_U64:
+		return _mm256_xor_si256(x, splat_avx2(sign_bit(size), size));
+	case VEC_KEY_F32:
+		/* Negative floats flip every bit but the sign */
+		return _mm256_xor_si256(
+			x, _mm256_and_si256(_mm256_srai_epi32(x, 31), splat_avx2(sign_bit(4) - 1, 4)));
+	case VEC_KEY_F64:
+		return _mm256_xor_si256(x, _mm256_and_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), x),
+													splat_avx2(sign_bit(8) - 1, 8)));
+	default:
+		return x;
+	}
+}
+
+__attribute__((target("avx2"))) static VEC_INLINE __m256i pick_avx2(__m256i a, __m256i b,
+																	size_t size, bool max) {
+	switch (size) {
+	case 1:
+		return max ? _mm256_max_epi8(a, b) : _mm256_min_epi8(a, b);
+	case 2:
+		return max ? _mm256_max_epi16(a, b) : _mm256_min_epi16(a, b);
+	case 4:
+		return max ? _mm256_max_epi32(a, b) : _mm256_min_epi32(a, b);
+	default: {
+		/* No 64-bit min/max in AVX2 */
+		__m256i b_wins = max ? _mm256_cmpgt_epi64(b, a) : _mm256_cmpgt_epi64(a, b);
+		return _mm256_blendv_epi8(a, b, b_wins);
+	}
+	}
+}
+
+/* Needs at least one register of elements */
+__attribute__((target("avx2"))) static VEC_INLINE uint64_t
+extreme_avx2_w(const unsigned char *data, size_t n, size_t size, vec_key_e key_type, bool max) {
+	size_t lanes = sizeof(__m256i) / size;
+	__m256i acc = to_signed_avx2(_mm256_loadu_si256((const __m256i *)data), size, key_type);
+	size_t i = lanes;
+	for (; i + lanes <= n; i += lanes) {
+		__m256i block =
+			to_signed_avx2(_mm256_loadu_si256((const __m256i *)(data + i * size)), size, key_type);
+		acc = pick_avx2(acc, block, size, max);
+	}
+
+	unsigned char lane_bytes[sizeof(__m256i)];
+	_mm256_storeu_si256((__m256i *)lane_bytes, acc);
+	uint64_t best = load_elem(lane_bytes, size) ^ sign_bit(size);
+	for (size_t l = 1; l < lanes; ++l) {
+		uint64_t key = load_elem(lane_bytes + l * size, size) ^ sign_bit(size);
+		if (max ? key > best : key < best) {
+			best = key;
+		}
+	}
+
+	return extreme_scalar(data, i, n, key_type, max, best);
+}
+
+__attribute__((target("avx2"))) static uint64_t extreme_avx2(const unsigned char *data, size_t n,
+															 vec_key_e key_type, bool max) {
+	switch (key_type) {
+	case VEC_KEY_U8:
+		return extreme_avx2_w(data, n, 1, VEC_KEY_U8, max);
+	case VEC_KEY_I8:
+		return extreme_avx2_w(data, n, 1, VEC_KEY_I8, max);
+	case VEC_KEY_U16:
+		return extreme_avx2_w(data, n, 2, VEC_KEY_U16, max);
+	case VEC_KEY_I16:
+		return extreme_avx2_w(data, n, 2, VEC_KEY_I16, max);
+	case VEC_KEY_U32:
+		return extreme_avx2_w(data, n, 4, VEC_KEY_U32, max);
+	case VEC_KEY_I32:
+		return extreme_avx2_w(data, n, 4, VEC_KEY_I32, max);
+	case VEC_KEY_F32:
+		return extreme_avx2_w(data, n, 4, VEC_KEY_F32, max);
+	case VEC_KEY_U64:
+		return extreme_avx2_w(data, n, 8, VEC_KEY_U64, max);
+	case VEC_KEY_I64:
+		return extreme_avx2_w(data, n, 8, VEC_KEY_I64, max);
+	default:
+		return extreme_avx2_w(data, n, 8, VEC_KEY_F64, max);
+	}
+}
+
+#endif /* VEC_X86 */
+
+/* See scan_scalar_w(), for every element size */
+static size_t scan(const unsigned char *data, size_t n, size_t size, const void *elem,
+				   bool count) {
+	if (size != 1 && size != 2 && size != 4 && size != 8) {
+		size_t found = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (memcmp(data + i * size, elem, size) == 0) {
+				if (!count) {
+					return i;
+				}
+				found++;
+			}
+		}
+		return count ? found : n;
+	}
+
+	uint64_t needle = load_elem(elem, size);
+#ifdef VEC_X86
+	if (__builtin_cpu_supports("avx2")) {
+		return scan_avx2(data, n, size, needle, count);
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return scan_sse2(data, n, size, needle, count);
+	}
+#endif
+
+	return scan_scalar(data, 0, n, size, needle, count);
+}
+
+int vec_find(vec_s *vec, const void *elem, size_t *index) {
+	if (vec == NULL || elem == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	size_t i = scan(vec->data, vec->size, vec->elem_size, elem, false);
+	bool found = i < vec->size;
+
+	unlock_vec(vec);
+
+	if (!found) {
+		return -1;
+	}
+	if (index != NULL) {
+		*index = i;
+	}
+
+	return 0;
+}
+
+size_t vec_count(vec_s *vec, const void *elem) {
+	if (vec == NULL || elem == NULL) {
+		return 0;
+	}
+
+	if (!lock_vec(vec)) {
+		return 0;
+	}
+
+	size_t count = scan(vec->data, vec->size, vec->elem_size, elem, true);
+
+	unlock_vec(vec);
+
+	return count;
+}
+
+/* Shared body of vec_lower_bound() and vec_upper_bound() */
+static int bound(vec_s *vec, const void *key, vec_cmp_f *cmp, size_t *index, bool upper) {
+	if (vec == NULL || key == NULL || cmp == NULL || index == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	const char *base = vec->data;
+	size_t first = 0;
+	size_t n = vec->size;
+	/* No early exit on equality: every search takes about log2(n) comparisons */
+	while (n > 0) {
+		size_t half = n / 2;
+		const char *mid = base + (first + half) * vec->elem_size;
+		bool right = upper ? cmp(key, mid) >= 0 : cmp(mid, key) < 0;
+		if (right) {
+			first += half + 1;
+			n -= half + 1;
+		} else {
+			n = half;
+		}
+	}
+	*index = first;
+
+	unlock_vec(vec);
+
+	return 0;
+}
+
+int vec_lower_bound(vec_s *vec, const void *key, int (*cmp)(const void *a, const void *b),
+					size_t *index) {
+	return bound(vec, key, cmp, index, false);
+}
+
+int vec_upper_bound(vec_s *vec, const void *key, int (*cmp)(const void *a, const void *b),
+					size_t *index) {
+	return bound(vec, key, cmp, index, true);
+}
+
+/* Shared body of vec_min() and vec_max() */
+static int extreme(vec_s *vec, vec_key_e key_type, void *out, bool max) {
+	if (vec == NULL || out == NULL || (unsigned int)key_type > VEC_KEY_I16) {
+		return -1;
+	}
+
+	size_t size = key_width(key_type);
+	if (vec->elem_size != size) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	size_t n = vec->size;
+	if (n == 0) {
+		unlock_vec(vec);
+
+		return -1;
+	}
+
+	const unsigned char *data = vec->data;
+	uint64_t key;
+#ifdef VEC_X86
+	if (n >= sizeof(__m256i) / size && __builtin_cpu_supports("avx2")) {
+		key = extreme_avx2(data, n, key_type, max);
+	} else
+#endif
+	{
+		key = extreme_scalar(data, 1, n, key_type, max, order_key((const char *)data, key_type));
+	}
+
+	unlock_vec(vec);
+
+	store_elem(out, unorder_key(key, key_type, size), size);
+
+	return 0;
+}
+
+int vec_min(vec_s *vec, vec_key_e key_type, void *out) {
+	return extreme(vec, key_type, out, false);
+}
+
+int vec_max(vec_s *vec, vec_key_e key_type, void *out) {
+	return extreme(vec, key_type, out, true);
+}
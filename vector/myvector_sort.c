@@ -0,0 +1,499 @@
+#include "myvector.h"
+#include "myvector_internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+typedef int vec_cmp_f(const void *a, const void *b);
+
+static VEC_INLINE void swap_elems(char *a, char *b, size_t size) {
+	for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+		uint64_t tmp;
+		memcpy(&tmp, a, sizeof(tmp));
+		memcpy(a, b, sizeof(tmp));
+		memcpy(b, &tmp, sizeof(tmp));
+		a += sizeof(tmp);
+		b += sizeof(tmp);
+	}
+	if (size >= sizeof(uint32_t)) {
+		uint32_t tmp;
+		memcpy(&tmp, a, sizeof(tmp));
+		memcpy(a, b, sizeof(tmp));
+		memcpy(b, &tmp, sizeof(tmp));
+		a += sizeof(tmp);
+		b += sizeof(tmp);
+		size -= sizeof(tmp);
+	}
+	for (; size > 0; --size) {
+		char tmp = *a;
+		*a++ = *b;
+		*b++ = tmp;
+	}
+}
+
+/* Copies one element, with a constant size for the common ones */
+static VEC_INLINE void copy_elem(char *dst, const char *src, size_t size) {
+	switch (size) {
+	case 4:
+		memcpy(dst, src, 4);
+		break;
+	case 8:
+		memcpy(dst, src, 8);
+		break;
+	case 16:
+		memcpy(dst, src, 16);
+		break;
+	default:
+		memcpy(dst, src, size);
+		break;
+	}
+}
+
+static VEC_INLINE void insertion_sort(char *base, size_t n, size_t size, vec_cmp_f *cmp) {
+	for (size_t i = 1; i < n; ++i) {
+		for (char *p = base + i * size; p > base && cmp(p - size, p) > 0; p -= size) {
+			swap_elems(p - size, p, size);
+		}
+	}
+}
+
+static VEC_INLINE void sift_down(char *base, size_t root, size_t n, size_t size, vec_cmp_f *cmp) {
+	for (;;) {
+		size_t child = 2 * root + 1;
+		if (child >= n) {
+			return;
+		}
+		if (child + 1 < n && cmp(base + child * size, base + (child + 1) * size) < 0) {
+			child++;
+		}
+		if (cmp(base + root * size, base + child * size) >= 0) {
+			return;
+		}
+		swap_elems(base + root * size, base + child * size, size);
+		root = child;
+	}
+}
+
+static VEC_INLINE void heap_sort(char *base, size_t n, size_t size, vec_cmp_f *cmp) {
+	for (size_t i = n / 2; i > 0; --i) {
+		sift_down(base, i - 1, n, size, cmp);
+	}
+	for (size_t end = n - 1; end > 0; --end) {
+		swap_elems(base, base + end * size, size);
+		sift_down(base, 0, end, size, cmp);
+	}
+}
+
+/*
+ * Partitions n > 2 elements around the median of the first, middle and last ones.
+ * Returns the final index of the pivot: everything before it compares <= and everything after
+ * compares >=. Elements equal to the pivot stop both scans, so duplicates split evenly.
+ */
+static VEC_INLINE size_t partition(char *base, size_t n, size_t size, vec_cmp_f *cmp) {
+	char *mid = base + n / 2 * size;
+	char *last = base + (n - 1) * size;
+
+	if (cmp(mid, base) < 0) {
+		swap_elems(mid, base, size);
+	}
+	if (cmp(last, mid) < 0) {
+		swap_elems(last, mid, size);
+		if (cmp(mid, base) < 0) {
+			swap_elems(mid, base, size);
+		}
+	}
+	/* The pivot waits at the front, the last element bounds the forward scan */
+	swap_elems(base, mid, size);
+
+	size_t i = 0;
+	size_t j = n;
+	for (;;) {
+		while (cmp(base + ++i * size, base) < 0) {
+			if (i == n - 1) {
+				break;
+			}
+		}
+		while (cmp(base, base + --j * size) < 0) {
+			if (j == 0) {
+				break;
+			}
+		}
+		if (i >= j) {
+			break;
+		}
+		swap_elems(base + i * size, base + j * size, size);
+	}
+	swap_elems(base, base + j * size, size);
+
+	return j;
+}
+
+struct sort_range {
+	char *base;
+	size_t n;
+	unsigned int depth;
+};
+
+static VEC_INLINE void intro_sort(char *base, size_t n, size_t size, vec_cmp_f *cmp) {
+	/* The smaller side is sorted first, so at most log2(n) ranges are ever pending */
+	struct sort_range stack[sizeof(size_t) * 8];
+	size_t top = 0;
+
+	unsigned int depth = 0;
+	for (size_t m = n; m > 1; m >>= 1) {
+		depth += 2;
+	}
+
+	for (;;) {
+		while (n > MYCLIB_VECTOR_SORT_INSERTION) {
+			if (depth == 0) {
+				/* Too many bad pivots, bound the range to n log n */
+				heap_sort(base, n, size, cmp);
+				n = 0;
+				break;
+			}
+			depth--;
+
+			size_t pivot = partition(base, n, size, cmp);
+			char *right = base + (pivot + 1) * size;
+			size_t right_n = n - pivot - 1;
+			if (pivot < right_n) {
+				stack[top++] = (struct sort_range){.base = right, .n = right_n, .depth = depth};
+				n = pivot;
+			} else {
+				stack[top++] = (struct sort_range){.base = base, .n = pivot, .depth = depth};
+				base = right;
+				n = right_n;
+			}
+		}
+		insertion_sort(base, n, size, cmp);
+
+		if (top == 0) {
+			return;
+		}
+		top--;
+		base = stack[top].base;
+		n = stack[top].n;
+		depth = stack[top].depth;
+	}
+}
+
+/*
+ * Introsort, instantiated with a constant element size for the common ones. Moves are inlined,
+ * comparisons stay indirect calls: only vec_sort_radix() avoids them.
+ */
+static void sort_elems(char *base, size_t n, size_t size, vec_cmp_f *cmp) {
+	switch (size) {
+	case 4:
+		intro_sort(base, n, 4, cmp);
+		break;
+	case 8:
+		intro_sort(base, n, 8, cmp);
+		break;
+	case 16:
+		intro_sort(base, n, 16, cmp);
+		break;
+	default:
+		intro_sort(base, n, size, cmp);
+		break;
+	}
+}
+
+int vec_sort(vec_s *vec, int (*cmp)(const void *a, const void *b)) {
+	if (vec == NULL || cmp == NULL) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	sort_elems(vec->data, vec->size, vec->elem_size, cmp);
+
+	unlock_vec(vec);
+
+	return 0;
+}
+
+/*
+ * LSD radix sort of vec->data by bytes of the key, from the least significant one. The lock
+ * must be held. The sorted elements may end up in the second buffer, which then replaces data.
+ */
+static VEC_INLINE int radix_sort(vec_s *vec, vec_key_e key_type, size_t key_offset,
+								 size_t key_size) {
+	size_t n = vec->size;
+	size_t size = vec->elem_size;
+	if (n < 2) {
+		return 0;
+	}
+
+	size_t(*counts)[256] = calloc(key_size, sizeof(*counts));
+	char *tmp = malloc(vec->capacity * size);
+	if (counts == NULL || tmp == NULL) {
+		free(counts);
+		free(tmp);
+		return -1;
+	}
+
+	/* A single read pass counts the digits of every pass */
+	char *src = vec->data;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t key = order_key(src + i * size + key_offset, key_type);
+		for (size_t b = 0; b < key_size; ++b) {
+			counts[b][(key >> (8 * b)) & 0xff]++;
+		}
+	}
+
+	uint64_t first_key = order_key(src + key_offset, key_type);
+	char *dst = tmp;
+	for (size_t b = 0; b < key_size; ++b) {
+		/* Every element has the same byte there, the pass would not move anything */
+		if (counts[b][(first_key >> (8 * b)) & 0xff] == n) {
+			continue;
+		}
+
+		size_t position = 0;
+		for (size_t d = 0; d < 256; ++d) {
+			size_t count = counts[b][d];
+			counts[b][d] = position;
+			position += count;
+		}
+
+		for (size_t i = 0; i < n; ++i) {
+			const char *elem = src + i * size;
+			size_t digit = (order_key(elem + key_offset, key_type) >> (8 * b)) & 0xff;
+			copy_elem(dst + counts[b][digit]++ * size, elem, size);
+		}
+
+		char *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	/* Both buffers hold capacity elements, keep whichever has the result */
+	vec->data = src;
+	free(dst);
+	free(counts);
+
+	return 0;
+}
+
+int vec_sort_radix(vec_s *vec, vec_key_e key_type, size_t key_offset) {
+	if (vec == NULL || (unsigned int)key_type > VEC_KEY_I16) {
+		return -1;
+	}
+
+	size_t key_size = key_width(key_type);
+	if (key_offset > vec->elem_size || key_size > vec->elem_size - key_offset) {
+		return -1;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	/* One instance per key type, the key decoding folds into the loops */
+	int res;
+	switch (key_type) {
+	case VEC_KEY_U8:
+		res = radix_sort(vec, VEC_KEY_U8, key_offset, 1);
+		break;
+	case VEC_KEY_I8:
+		res = radix_sort(vec, VEC_KEY_I8, key_offset, 1);
+		break;
+	case VEC_KEY_U16:
+		res = radix_sort(vec, VEC_KEY_U16, key_offset, 2);
+		break;
+	case VEC_KEY_I16:
+		res = radix_sort(vec, VEC_KEY_I16, key_offset, 2);
+		break;
+	case VEC_KEY_U32:
+		res = radix_sort(vec, VEC_KEY_U32, key_offset, 4);
+		break;
+	case VEC_KEY_I32:
+		res = radix_sort(vec, VEC_KEY_I32, key_offset, 4);
+		break;
+	case VEC_KEY_F32:
+		res = radix_sort(vec, VEC_KEY_F32, key_offset, 4);
+		break;
+	case VEC_KEY_U64:
+		res = radix_sort(vec, VEC_KEY_U64, key_offset, 8);
+		break;
+	case VEC_KEY_I64:
+		res = radix_sort(vec, VEC_KEY_I64, key_offset, 8);
+		break;
+	case VEC_KEY_F64:
+		res = radix_sort(vec, VEC_KEY_F64, key_offset, 8);
+		break;
+	default:
+		res = -1;
+		break;
+	}
+
+	unlock_vec(vec);
+
+	return res;
+}
+
+/*
+ * @brief One unit of work of vec_sort_parallel(): the elements [first, last) of src.
+ */
+struct sort_worker {
+	char *src;		  /**< Buffer read */
+	char *dst;		  /**< Buffer written by merges */
+	size_t size;	  /**< Size of each element in bytes */
+	vec_cmp_f *cmp;	  /**< Comparison function */
+	size_t first;	  /**< First element */
+	size_t mid;		  /**< Start of the second run of a merge */
+	size_t last;	  /**< One past the last element */
+};
+
+static int sort_chunk(void *arg) {
+	struct sort_worker *w = arg;
+	sort_elems(w->src + w->first * w->size, w->last - w->first, w->size, w->cmp);
+
+	return 0;
+}
+
+/* Merges the runs [first, mid) and [mid, last) of src into the same range of dst */
+static int merge_runs(void *arg) {
+	struct sort_worker *w = arg;
+	size_t size = w->size;
+	const char *a = w->src + w->first * size;
+	const char *a_end = w->src + w->mid * size;
+	const char *b = a_end;
+	const char *b_end = w->src + w->last * size;
+	char *out = w->dst + w->first * size;
+
+	while (a < a_end && b < b_end) {
+		/* Ties take the first run, runs keep their relative order */
+		if (w->cmp(b, a) < 0) {
+			copy_elem(out, b, size);
+			b += size;
+		} else {
+			copy_elem(out, a, size);
+			a += size;
+		}
+		out += size;
+	}
+	memcpy(out, a, (size_t)(a_end - a));
+	out += a_end - a;
+	memcpy(out, b, (size_t)(b_end - b));
+
+	return 0;
+}
+
+/*
+ * @brief Run fn on every worker, the first one on the calling thread.
+ *
+ * A worker whose thread cannot be started runs on the calling thread as well.
+ */
+static void sort_run(struct sort_worker *workers, size_t num_workers, thrd_start_t fn) {
+	thrd_t threads[MYCLIB_VECTOR_SORT_MAX_THREADS];
+	bool started[MYCLIB_VECTOR_SORT_MAX_THREADS];
+
+	for (size_t t = 1; t < num_workers; ++t) {
+		started[t] = thrd_create(&threads[t], fn, &workers[t]) == thrd_success;
+		if (!started[t]) {
+			fn(&workers[t]);
+		}
+	}
+
+	fn(&workers[0]);
+
+	for (size_t t = 1; t < num_workers; ++t) {
+		if (started[t]) {
+			thrd_join(threads[t], NULL);
+		}
+	}
+}
+
+int vec_sort_parallel(vec_s *vec, int (*cmp)(const void *a, const void *b), size_t num_threads) {
+	if (vec == NULL || cmp == NULL) {
+		return -1;
+	}
+
+	if (num_threads == 0) {
+		num_threads = MYCLIB_VECTOR_SORT_THREADS;
+	}
+	if (num_threads > MYCLIB_VECTOR_SORT_MAX_THREADS) {
+		num_threads = MYCLIB_VECTOR_SORT_MAX_THREADS;
+	}
+
+	if (!lock_vec(vec)) {
+		return -1;
+	}
+
+	size_t n = vec->size;
+	size_t size = vec->elem_size;
+	/* Small vectors are not worth a thread */
+	size_t num_runs = num_threads < n / MYCLIB_VECTOR_SORT_MIN ? num_threads
+															   : n / MYCLIB_VECTOR_SORT_MIN;
+	char *tmp = num_runs > 1 ? malloc(vec->capacity * size) : NULL;
+	if (tmp == NULL) {
+		sort_elems(vec->data, n, size, cmp);
+		unlock_vec(vec);
+		return 0;
+	}
+
+	size_t bounds[MYCLIB_VECTOR_SORT_MAX_THREADS + 1];
+	for (size_t t = 0; t <= num_runs; ++t) {
+		bounds[t] = n / num_runs * t;
+	}
+	bounds[num_runs] = n;
+
+	struct sort_worker workers[MYCLIB_VECTOR_SORT_MAX_THREADS];
+	char *src = vec->data;
+	char *dst = tmp;
+	for (size_t t = 0; t < num_runs; ++t) {
+		workers[t] = (struct sort_worker){
+			.src = src,
+			.size = size,
+			.cmp = cmp,
+			.first = bounds[t],
+			.last = bounds[t + 1],
+		};
+	}
+	sort_run(workers, num_runs, sort_chunk);
+
+	/* Each round merges pairs of runs into the other buffer, halving their number */
+	while (num_runs > 1) {
+		size_t num_merges = (num_runs + 1) / 2;
+		for (size_t t = 0; t < num_merges; ++t) {
+			size_t first = 2 * t;
+			/* An odd run out is copied over as is */
+			size_t mid = first + 1 < num_runs ? first + 1 : num_runs;
+			size_t last = first + 2 < num_runs ? first + 2 : num_runs;
+			workers[t] = (struct sort_worker){
+				.src = src,
+				.dst = dst,
+				.size = size,
+				.cmp = cmp,
+				.first = bounds[first],
+				.mid = bounds[mid],
+				.last = bounds[last],
+			};
+		}
+		sort_run(workers, num_merges, merge_runs);
+
+		for (size_t t = 0; t < num_merges; ++t) {
+			bounds[t] = workers[t].first;
+		}
+		bounds[num_merges] = n;
+		num_runs = num_merges;
+
+		char *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	/* Both buffers hold capacity elements, keep whichever has the result */
+	vec->data = src;
+	free(dst);
+
+	unlock_vec(vec);
+
+	return 0;
+}